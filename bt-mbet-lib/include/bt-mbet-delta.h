@@ -0,0 +1,86 @@
+#ifndef __MBET_DELTA_H__
+#define __MBET_DELTA_H__
+
+/** @file
+ *
+ * Estado de los eventos de un feed que se conserva entre una lectura y la
+ * siguiente, indexado por `bt_mbet_event.tree_id`. Cada feed nuevo se
+ * compara con el anterior y sólo se reportan las diferencias, así quien
+ * escribe en la base de datos no repite lo que ya escribió.
+ */
+
+#include <stdlib.h>
+
+typedef struct bt_mbet_feed bt_mbet_feed;
+typedef struct bt_mbet_event bt_mbet_event;
+typedef struct bt_mbet_market bt_mbet_market;
+typedef struct bt_mbet_selection bt_mbet_selection;
+typedef struct bt_mbet_delta bt_mbet_delta;
+
+/**
+ * @brief El tipo de un cambio
+ */
+typedef enum bt_mbet_change_type {
+    MbetEventStarted, /**< El evento no estaba en el feed anterior */
+    MbetScoreChanged, /**< El resultado es distinto */
+    MbetMarketAdded, /**< Ninguna selección del mercado estaba antes */
+    MbetOddsChanged, /**< Cambió el coeficiente de una selección */
+    MbetEventFinished, /**< El evento ya no está en el feed */
+    MbetChangeTypesCount
+} bt_mbet_change_type;
+
+/**
+ * @brief Un cambio, los apuntadores son del feed nuevo y sólo son válidos
+ * durante la llamada a `bt_mbet_change_handler_fn`
+ */
+typedef struct bt_mbet_change {
+    bt_mbet_change_type type;
+    long int tree_id; /**< El evento, siempre presente */
+    const bt_mbet_event *event; /**< `NULL` en `MbetEventFinished` */
+    const bt_mbet_market *market; /**< En `MbetMarketAdded` y `MbetOddsChanged` */
+    const bt_mbet_selection *selection; /**< En `MbetOddsChanged` */
+    float previous; /**< El coeficiente anterior, `0` si la selección es nueva */
+} bt_mbet_change;
+
+typedef void (*bt_mbet_change_handler_fn)(const bt_mbet_change *const, void *);
+
+/**
+ * @brief Crear un estado vacío, el primer feed reporta todos sus eventos
+ * como `MbetEventStarted` y todos sus mercados como `MbetMarketAdded`
+ * @return El objeto recién alojado que debe ser liberado con
+ * `bt_mbet_delta_free()`
+ */
+bt_mbet_delta *bt_mbet_delta_new(void);
+/**
+ * @brief Liberar el estado
+ * @param delta El objeto para liberar
+ */
+void bt_mbet_delta_free(bt_mbet_delta *delta);
+/**
+ * @brief Comparar un feed con el anterior y reportar las diferencias. Los
+ * eventos nuevos no reportan `MbetScoreChanged`, su resultado viene con el
+ * evento. Un evento repetido en el feed se reporta una sola vez. El feed
+ * pasa a ser la referencia para la siguiente llamada
+ * @param delta El estado de interés
+ * @param feed El feed nuevo, completo
+ * @param handler Se llama una vez por cada cambio, en el orden del feed y
+ * al final los eventos terminados
+ * @param data Se pasa a `handler`
+ * @return El número de cambios reportados
+ */
+size_t bt_mbet_delta_update(bt_mbet_delta *const delta, const bt_mbet_feed *const feed, bt_mbet_change_handler_fn handler, void *data);
+/**
+ * @brief Olvidar todos los eventos, el siguiente feed se reporta completo
+ * como el primero. Sirve cuando los cambios reportados no se pudieron
+ * guardar
+ * @param delta El estado de interés
+ */
+void bt_mbet_delta_clear(bt_mbet_delta *const delta);
+/**
+ * @brief Obtener el número de eventos que se conocen
+ * @param delta El estado de interés
+ * @return El número de eventos del último feed
+ */
+size_t bt_mbet_delta_get_count(const bt_mbet_delta *const delta);
+
+#endif // __MBET_DELTA_H__
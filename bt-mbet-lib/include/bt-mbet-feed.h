@@ -23,9 +23,34 @@ typedef void (*bt_mbet_event_handler_fn)(const bt_mbet_event *const ,void *);
 typedef void (*bt_mbet_feed_handler_fn)(const bt_mbet_feed *const);
 
 bt_mbet_feed *bt_mbet_feed_get(enum bt_mbet_feed_type feed_type, bt_mbet_feed_handler_fn handler);
+/**
+ * @brief Como `bt_mbet_feed_get()`, pero si el feed no cambió desde la
+ * última vez devuelve `NULL` sin llamar a `handler`. Sólo para quien
+ * consulta el feed una y otra vez y no necesita el que ya procesó
+ * @param feed_type El feed de interés
+ * @param handler Se llama con el feed nuevo, puede ser `NULL`
+ * @return El feed, o `NULL` si falló o no ha cambiado
+ */
+bt_mbet_feed *bt_mbet_feed_get_cached(enum bt_mbet_feed_type feed_type, bt_mbet_feed_handler_fn handler);
+/**
+ * @brief Hacer que `bt_mbet_feed_get_cached()` entregue el feed la
+ * próxima vez aunque no haya cambiado, por ejemplo si no se pudo guardar
+ * en la base de datos
+ * @param feed_type El feed de interés
+ */
+void bt_mbet_feed_invalidate(enum bt_mbet_feed_type feed_type);
 void bt_mbet_feed_free(bt_mbet_feed *feed);
 void bt_mbet_generic_sport_handler(const bt_mbet_sport *const sport, bt_mbet_event_handler_fn handler, void *data);
 size_t bt_mbet_count_events(const bt_mbet_feed *const live);
+/**
+ * @brief Medir los dos analizadores de XML (ver `MBET_PARSER`) con feeds
+ * grabados, sin consultar la base de datos. Escribe el tiempo promedio y
+ * el número de eventos de cada uno en la salida estándar
+ * @param paths Los archivos con los feeds
+ * @param count El número de archivos
+ * @return `0`
+ */
+int bt_mbet_feed_benchmark(char *const *const paths, size_t count);
 int bt_mbet_eventcmp(const void * const, const void * const);
 
 int bt_get_player_name_from_id(bt_mbet_member *member);
@@ -2,15 +2,25 @@
 #define __MBET_SCORE_H__
 typedef struct bt_mbet_score bt_mbet_score;
 typedef struct _xmlNode xmlNode;
+typedef struct bt_arena bt_arena;
 /** @file
  */
+bt_mbet_score *bt_score_parse_oncourt(const char * const);
 /**
  * @brief Analizar y extraer una cadena con el resultado de un partido
  * a una estructura `bt_mbet_live_result`
  * @param node El node XML que contiene el resultado en forma de texto
- * @return
+ * @param arena Donde se aloja el resultado, se libera con ella
+ * @return El resultado o `NULL`
  */
-bt_mbet_score *bt_score_parse_oncourt(const char * const);
-bt_mbet_score *bt_score_parse_mbet(xmlNode *node);
+bt_mbet_score *bt_score_parse_mbet(xmlNode *node, bt_arena *arena);
+/**
+ * @brief Lo mismo que `bt_score_parse_mbet()` a partir del texto de la
+ * etiqueta `liveresult`
+ * @param content El texto, no se modifica
+ * @param arena Donde se aloja el resultado, se libera con ella
+ * @return El resultado o `NULL`
+ */
+bt_mbet_score *bt_score_parse_mbet_text(const char *const content, bt_arena *arena);
 void bt_mbet_score_free(bt_mbet_score *);
 #endif // __MBET_SCORE_H__
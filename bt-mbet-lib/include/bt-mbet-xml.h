@@ -3,10 +3,19 @@
 
 #include <libxml/parser.h>
 #include <libxml/xpath.h>
+#include <libxml/xmlreader.h>
+
+#include <bt-arena.h>
 
 #include <stdbool.h>
 #include <time.h>
+// Evaluate an expression relative to `node', each thread compiles it once
+// and keeps it until `bt_mbet_xpath_thread_release()'
+xmlXPathObject *bt_mbet_xpath_eval(xmlNode *node, const xmlChar *const expression);
+void bt_mbet_xpath_thread_release(void);
 char *bt_mbet_get_node_conent_string(xmlNode *node, const char *const xpath_expression);
+// The same, but the text is copied to `arena' and `xmlFree()' is not needed
+const char *bt_mbet_get_node_content_arena(xmlNode *node, const char *const xpath_expression, bt_arena *arena);
 int bt_mbet_get_node_content_integer(xmlNode *node, const char *const xpath_expression);
 int bt_mbet_get_integer_property(xmlNode *node, const char *const name);
 long int bt_mbet_get_long_property(xmlNode *node, const char *const name);
@@ -14,6 +23,14 @@ float bt_mbet_get_float_property(xmlNode *node, const char *const name);
 char *bt_mbet_get_string_property(xmlNode *node, const char *const name);
 void bt_mbet_get_date_property(xmlNode *node, const char *const name, struct tm *tm);
 bool bt_mbet_get_boolean_property(xmlNode *node, const char *const name);
+// The value is copied to `arena', it's released with the arena
+const char *bt_mbet_get_arena_property(xmlNode *node, const char *const name, bt_arena *arena);
+// The same, for the element where an `xmlTextReader' is
+int bt_mbet_reader_get_integer(xmlTextReader *reader, const char *const name);
+long int bt_mbet_reader_get_long(xmlTextReader *reader, const char *const name);
+float bt_mbet_reader_get_float(xmlTextReader *reader, const char *const name);
+void bt_mbet_reader_get_date(xmlTextReader *reader, const char *const name, struct tm *tm);
+const char *bt_mbet_reader_get_arena_property(xmlTextReader *reader, const char *const name, bt_arena *arena);
 #if LIBXML_VERSION < 20901
 void xmlXPathSetContextNode(xmlNodePtr node, xmlXPathContextPtr ctx);
 #endif
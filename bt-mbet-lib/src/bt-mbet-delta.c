@@ -0,0 +1,408 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <bt-private.h>
+#include <bt-mbet-delta.h>
+#include <bt-mbet-feed.h>
+#include <bt-memory.h>
+
+typedef struct bt_mbet_delta_odds {
+    long int coeff_id;
+    float coeff;
+} bt_mbet_delta_odds;
+
+typedef struct bt_mbet_delta_entry {
+    long int tree_id;
+    // The last feed that had this event
+    unsigned int generation;
+    // The score as it was in that feed
+    bool has_score;
+    bt_mbet_score_item score;
+    bt_mbet_score_item game;
+    uint8_t service;
+    int8_t nsets;
+    bt_mbet_score_item *sets;
+    // The coefficients of all the selections, sorted by `coeff_id'
+    bt_mbet_delta_odds *odds;
+    size_t nodds;
+} bt_mbet_delta_entry;
+
+struct bt_mbet_delta {
+    // Sorted by `tree_id' between updates
+    bt_mbet_delta_entry *entries;
+    size_t count;
+    size_t size;
+    unsigned int generation;
+};
+
+typedef struct bt_mbet_delta_context {
+    bt_mbet_delta *delta;
+    // Only these are sorted while the new feed is read, the new
+    // events are appended after them
+    size_t sorted;
+    bt_mbet_change_handler_fn handler;
+    void *data;
+    size_t changes;
+} bt_mbet_delta_context;
+
+static int
+bt_mbet_delta_entrycmp(const void *const lhs, const void *const rhs)
+{
+    const bt_mbet_delta_entry *left;
+    const bt_mbet_delta_entry *right;
+    left = lhs;
+    right = rhs;
+    if (left->tree_id < right->tree_id)
+        return -1;
+    return (left->tree_id > right->tree_id) ? 1 : 0;
+}
+
+static int
+bt_mbet_delta_oddscmp(const void *const lhs, const void *const rhs)
+{
+    const bt_mbet_delta_odds *left;
+    const bt_mbet_delta_odds *right;
+    left = lhs;
+    right = rhs;
+    if (left->coeff_id < right->coeff_id)
+        return -1;
+    return (left->coeff_id > right->coeff_id) ? 1 : 0;
+}
+
+bt_mbet_delta *
+bt_mbet_delta_new(void)
+{
+    bt_mbet_delta *delta;
+    delta = bt_malloc(sizeof(*delta));
+    if (delta == NULL)
+        return NULL;
+    memset(delta, 0, sizeof(*delta));
+    return delta;
+}
+
+static void
+bt_mbet_delta_entry_release(bt_mbet_delta_entry *const entry)
+{
+    bt_free(entry->sets);
+    bt_free(entry->odds);
+}
+
+void
+bt_mbet_delta_free(bt_mbet_delta *delta)
+{
+    if (delta == NULL)
+        return;
+    for (size_t idx = 0; idx < delta->count; ++idx)
+        bt_mbet_delta_entry_release(&delta->entries[idx]);
+    bt_free(delta->entries);
+    bt_free(delta);
+}
+
+void
+bt_mbet_delta_clear(bt_mbet_delta *const delta)
+{
+    for (size_t idx = 0; idx < delta->count; ++idx)
+        bt_mbet_delta_entry_release(&delta->entries[idx]);
+    delta->count = 0;
+}
+
+size_t
+bt_mbet_delta_get_count(const bt_mbet_delta *const delta)
+{
+    return delta->count;
+}
+
+static void
+bt_mbet_delta_emit(bt_mbet_delta_context *const context, bt_mbet_change_type type,
+                     long int tree_id, const bt_mbet_event *const event,
+                 const bt_mbet_market *const market,
+                                const bt_mbet_selection *const selection, float previous)
+{
+    bt_mbet_change change;
+    change.type = type;
+    change.tree_id = tree_id;
+    change.event = event;
+    change.market = market;
+    change.selection = selection;
+    change.previous = previous;
+    context->handler(&change, context->data);
+    context->changes += 1;
+}
+
+static bool
+bt_mbet_delta_score_equal(const bt_mbet_delta_entry *const entry,
+                                                const bt_mbet_score *const score)
+{
+    if (score == NULL)
+        return (entry->has_score == false);
+    if (entry->has_score == false)
+        return false;
+    if ((entry->nsets != score->nsets) || (entry->service != score->service))
+        return false;
+    if ((entry->score.home != score->score.home) || (entry->score.away != score->score.away))
+        return false;
+    if ((entry->game.home != score->game.home) || (entry->game.away != score->game.away))
+        return false;
+    if (entry->nsets == 0)
+        return true;
+    return memcmp(entry->sets, score->sets, entry->nsets * sizeof(*entry->sets)) == 0;
+}
+
+static void
+bt_mbet_delta_store_score(bt_mbet_delta_entry *const entry,
+                                                const bt_mbet_score *const score)
+{
+    bt_mbet_score_item *sets;
+    entry->has_score = false;
+    if (score == NULL)
+        return;
+    sets = NULL;
+    if ((score->nsets > 0) && (score->sets != NULL)) {
+        sets = bt_realloc(entry->sets, score->nsets * sizeof(*sets));
+        // Without a copy it will be reported as changed next time
+        if (sets == NULL)
+            return;
+        memcpy(sets, score->sets, score->nsets * sizeof(*sets));
+        entry->sets = sets;
+    }
+    entry->nsets = (sets == NULL) ? 0 : score->nsets;
+    entry->score = score->score;
+    entry->game = score->game;
+    entry->service = score->service;
+    entry->has_score = true;
+}
+
+static size_t
+bt_mbet_delta_count_selections(const bt_mbet_event *const event)
+{
+    const bt_mbet_list *markets;
+    size_t count;
+    markets = event->markets;
+    if (markets == NULL)
+        return 0;
+    count = 0;
+    for (size_t idx = 0; idx < markets->count; ++idx) {
+        const bt_mbet_market *market;
+        market = markets->items[idx]->data;
+        if (market->selections != NULL)
+            count += market->selections->count;
+    }
+    return count;
+}
+
+static void
+bt_mbet_delta_store_odds(bt_mbet_delta_entry *const entry,
+                                                const bt_mbet_event *const event)
+{
+    const bt_mbet_list *markets;
+    bt_mbet_delta_odds *odds;
+    size_t count;
+    entry->nodds = 0;
+    count = bt_mbet_delta_count_selections(event);
+    if (count == 0)
+        return;
+    odds = bt_realloc(entry->odds, count * sizeof(*odds));
+    // Without a copy all the markets will be reported as new next time
+    if (odds == NULL)
+        return;
+    entry->odds = odds;
+    markets = event->markets;
+    for (size_t idx = 0; idx < markets->count; ++idx) {
+        const bt_mbet_market *market;
+        const bt_mbet_list *selections;
+        market = markets->items[idx]->data;
+        selections = market->selections;
+        if (selections == NULL)
+            continue;
+        for (size_t jdx = 0; jdx < selections->count; ++jdx) {
+            const bt_mbet_selection *selection;
+            selection = selections->items[jdx]->data;
+            odds[entry->nodds].coeff_id = selection->coeff_id;
+            odds[entry->nodds].coeff = selection->coeff;
+            entry->nodds += 1;
+        }
+    }
+    qsort(odds, entry->nodds, sizeof(*odds), bt_mbet_delta_oddscmp);
+}
+
+static const bt_mbet_delta_odds *
+bt_mbet_delta_find_odds(const bt_mbet_delta_entry *const entry, long int coeff_id)
+{
+    bt_mbet_delta_odds key;
+    if (entry->nodds == 0)
+        return NULL;
+    key.coeff_id = coeff_id;
+    return bsearch(&key, entry->odds, entry->nodds, sizeof(key), bt_mbet_delta_oddscmp);
+}
+
+static void
+bt_mbet_delta_diff_market(bt_mbet_delta_context *const context,
+              const bt_mbet_delta_entry *const entry, const bt_mbet_event *const event,
+                                                  const bt_mbet_market *const market)
+{
+    const bt_mbet_list *selections;
+    bool known;
+    selections = market->selections;
+    // Without selections there is nothing to tell, nor to identify it
+    if (selections == NULL)
+        return;
+    // The market has no id of its own, it's known if any of it's
+    // selections is
+    known = false;
+    for (size_t idx = 0; ((idx < selections->count) && (known == false)); ++idx) {
+        const bt_mbet_selection *selection;
+        selection = selections->items[idx]->data;
+        known = (bt_mbet_delta_find_odds(entry, selection->coeff_id) != NULL);
+    }
+    if (known == false) {
+        bt_mbet_delta_emit(context, MbetMarketAdded,
+                                       event->tree_id, event, market, NULL, 0.0f);
+        return;
+    }
+    for (size_t idx = 0; idx < selections->count; ++idx) {
+        const bt_mbet_selection *selection;
+        const bt_mbet_delta_odds *odds;
+        float previous;
+        selection = selections->items[idx]->data;
+        odds = bt_mbet_delta_find_odds(entry, selection->coeff_id);
+        previous = (odds == NULL) ? 0.0f : odds->coeff;
+        if ((odds != NULL) && (odds->coeff == selection->coeff))
+            continue;
+        bt_mbet_delta_emit(context, MbetOddsChanged,
+                                  event->tree_id, event, market, selection, previous);
+    }
+}
+
+static void
+bt_mbet_delta_diff_markets(bt_mbet_delta_context *const context,
+              const bt_mbet_delta_entry *const entry, const bt_mbet_event *const event)
+{
+    const bt_mbet_list *markets;
+    markets = event->markets;
+    if (markets == NULL)
+        return;
+    for (size_t idx = 0; idx < markets->count; ++idx)
+        bt_mbet_delta_diff_market(context, entry, event, markets->items[idx]->data);
+}
+
+static bt_mbet_delta_entry *
+bt_mbet_delta_append(bt_mbet_delta *const delta, long int tree_id)
+{
+    bt_mbet_delta_entry *entry;
+    if (delta->count == delta->size) {
+        bt_mbet_delta_entry *entries;
+        size_t size;
+        size = (delta->size == 0) ? 64 : 2 * delta->size;
+        entries = bt_realloc(delta->entries, size * sizeof(*entries));
+        if (entries == NULL)
+            return NULL;
+        delta->entries = entries;
+        delta->size = size;
+    }
+    entry = &delta->entries[delta->count++];
+    memset(entry, 0, sizeof(*entry));
+    entry->tree_id = tree_id;
+    return entry;
+}
+
+static bt_mbet_delta_entry *
+bt_mbet_delta_find(bt_mbet_delta_context *const context, long int tree_id)
+{
+    bt_mbet_delta_entry key;
+    bt_mbet_delta_entry *entry;
+    bt_mbet_delta *delta;
+    delta = context->delta;
+    key.tree_id = tree_id;
+    entry = NULL;
+    if (context->sorted > 0) {
+        entry = bsearch(&key, delta->entries,
+                            context->sorted, sizeof(key), bt_mbet_delta_entrycmp);
+    }
+    if (entry != NULL)
+        return entry;
+    // The event can be twice in the same feed, then it was appended
+    // already in this pass. These are few, except for the first feed
+    for (size_t idx = context->sorted; idx < delta->count; ++idx) {
+        if (delta->entries[idx].tree_id == tree_id)
+            return &delta->entries[idx];
+    }
+    return NULL;
+}
+
+static void
+bt_mbet_delta_handle_event(const bt_mbet_event *const event, void *data)
+{
+    bt_mbet_delta_context *context;
+    bt_mbet_delta_entry *entry;
+    bt_mbet_delta *delta;
+    context = data;
+    delta = context->delta;
+    entry = bt_mbet_delta_find(context, event->tree_id);
+    if (entry == NULL) {
+        entry = bt_mbet_delta_append(delta, event->tree_id);
+        // It will be reported as started again with the next feed
+        if (entry == NULL)
+            return;
+        bt_mbet_delta_emit(context, MbetEventStarted,
+                                          event->tree_id, event, NULL, NULL, 0.0f);
+    } else {
+        if (bt_mbet_delta_score_equal(entry, event->score) == false) {
+            if (event->score != NULL) {
+                bt_mbet_delta_emit(context, MbetScoreChanged,
+                                          event->tree_id, event, NULL, NULL, 0.0f);
+            }
+        }
+    }
+    // For a new event this reports all the markets as added
+    bt_mbet_delta_diff_markets(context, entry, event);
+    // Now this event is the reference for the next feed
+    bt_mbet_delta_store_score(entry, event->score);
+    bt_mbet_delta_store_odds(entry, event);
+    entry->generation = delta->generation;
+}
+
+static void
+bt_mbet_delta_remove_finished(bt_mbet_delta_context *const context)
+{
+    bt_mbet_delta *delta;
+    size_t count;
+    delta = context->delta;
+    count = 0;
+    for (size_t idx = 0; idx < delta->count; ++idx) {
+        bt_mbet_delta_entry *entry;
+        entry = &delta->entries[idx];
+        if (entry->generation != delta->generation) {
+            bt_mbet_delta_emit(context, MbetEventFinished,
+                                           entry->tree_id, NULL, NULL, NULL, 0.0f);
+            bt_mbet_delta_entry_release(entry);
+        } else {
+            delta->entries[count++] = *entry;
+        }
+    }
+    delta->count = count;
+}
+
+size_t
+bt_mbet_delta_update(bt_mbet_delta *const delta, const bt_mbet_feed *const feed,
+                                       bt_mbet_change_handler_fn handler, void *data)
+{
+    bt_mbet_delta_context context;
+    bt_mbet_list *sports;
+    context.delta = delta;
+    context.sorted = delta->count;
+    context.handler = handler;
+    context.data = data;
+    context.changes = 0;
+    delta->generation += 1;
+    sports = feed->sports;
+    for (size_t sdx = 0; ((sports != NULL) && (sdx < sports->count)); ++sdx) {
+        bt_mbet_sport *sport;
+        sport = sports->items[sdx]->data;
+        bt_mbet_generic_sport_handler(sport, bt_mbet_delta_handle_event, &context);
+    }
+    // Put the new events in place, then anything that wasn't seen is over
+    qsort(delta->entries, delta->count, sizeof(*delta->entries), bt_mbet_delta_entrycmp);
+    bt_mbet_delta_remove_finished(&context);
+    return context.changes;
+}
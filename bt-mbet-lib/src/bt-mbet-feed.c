@@ -6,6 +6,7 @@
 #include <pthread.h>
 #include <stdarg.h>
 #include <math.h>
+#include <time.h>
 
 #include <http-connection.h>
 #include <http-protocol.h>
@@ -29,6 +30,12 @@
 
 static __thread bt_oc_map_ru *atp_ru_map;
 static __thread bt_oc_map_ru *wta_ru_map;
+// Skip the database lookups, to measure only the parsers
+static __thread bool offline;
+// Where the feed being parsed is allocated, it's released with the feed
+static __thread bt_arena *storage;
+// An arena from a freed feed, the next one reuses it's memory
+static bt_arena *SpareArena;
 
 #ifdef _DEBUG
 #define FEED_URL "http://www.betenis.com/feed.php?type=%s&lang=ru"
@@ -58,32 +65,12 @@ static int bt_mbet_init_event(bt_mbet_list_item *object, xmlNode *node);
 static int bt_mbet_init_market(bt_mbet_list_item *object, xmlNode *node);
 static int bt_mbet_init_selection(bt_mbet_list_item *object, xmlNode *node);
 
+// Times each parser runs on a feed to measure it
+#define BT_MBET_BENCHMARK_ROUNDS 20
+
 #define HOME_XPATH ((const xmlChar *) "./members/member[@selkey=\"HOME\"]")
 #define AWAY_XPATH ((const xmlChar *) "./members/member[@selkey=\"AWAY\"]")
 
-static void
-bt_mbet_free_generic_list(bt_mbet_list *list)
-{
-    if (list == NULL)
-        return;
-    for (size_t idx = 0; idx < list->count; ++idx) {
-        bt_mbet_list_item *item;
-        void (*free_item)(void *);
-        // Make a pointer
-        item = list->items[idx];
-        // Get the free function
-        free_item = item->freefn;
-        // Free the item data
-        free_item(item->data);
-        // Free the item
-        bt_free(item);
-    }
-    // Free the items container
-    bt_free(list->items);
-    // Free the container
-    bt_free(list);
-}
-
 void *
 bt_mbet_list_get_item_data(const bt_mbet_list *list, size_t idx)
 {
@@ -96,108 +83,36 @@ bt_mbet_list_get_item_data(const bt_mbet_list *list, size_t idx)
     return item->data;
 }
 
-static void
-bt_mbet_member_free(void *object)
-{
-    bt_mbet_member *member;
-    if (object == NULL)
-        return;
-    member = object;
-
-    bt_free(member->name);
-    bt_free(member->flag);
-
-    xmlFree(member->role);
-    xmlFree(member->selkey);
-
-    bt_free(member);
-}
-
-static void
-bt_mbet_selection_free(void *object)
+static void *
+bt_mbet_alloc(size_t size)
 {
-    bt_mbet_selection *selection;
+    void *object;
+    // Nothing in the feed is released on it's own
+    object = bt_arena_alloc(storage, size);
     if (object == NULL)
-        return;
-    selection = object;
-    xmlFree(selection->name);
-    xmlFree(selection->uid);
-    xmlFree(selection->selkey);
-    bt_free(selection);
-}
-
-static void
-bt_mbet_market_free(void *object)
-{
-    bt_mbet_market *market;
-    if (object == NULL)
-        return;
-    market = object;
-
-    xmlFree(market->model);
-    xmlFree(market->type);
-    xmlFree(market->name);
-    bt_mbet_free_generic_list(market->selections);
-    bt_free(market);
-}
-
-static void
-bt_mbet_live_result_free(void *object)
-{
-    bt_mbet_score *result;
-    if (object == NULL)
-        return;
-    result = object;
-    bt_free(result->sets);
-    bt_free(result);
-}
-
-static void
-bt_mbet_event_free(void *object)
-{
-    bt_mbet_event *event;
-    if (object == NULL)
-        return;
-    event = object;
-
-    xmlFree(event->url);
-    xmlFree(event->name);
-
-    bt_mbet_member_free(event->home);
-    bt_mbet_member_free(event->away);
-    bt_mbet_free_generic_list(event->markets);
-    bt_mbet_live_result_free(event->score);
-
-    bt_free(event);
+        return NULL;
+    return memset(object, 0, size);
 }
 
-static void
-bt_mbet_group_free(void *object)
+static bt_arena *
+bt_mbet_arena_get(void)
 {
-    bt_mbet_group *group;
-    if (object == NULL)
-        return;
-    group = object;
-
-    bt_free(group->name);
-    bt_free(group->court);
-    bt_free(group->flag);
-
-    bt_mbet_free_generic_list(group->events);
-    bt_free(group);
+    bt_arena *arena;
+    // The memory of the last feed is reused, usually without
+    // calling `bt_malloc()' at all
+    arena = __atomic_exchange_n(&SpareArena, NULL, __ATOMIC_ACQ_REL);
+    if (arena != NULL)
+        return arena;
+    return bt_arena_new();
 }
 
 static void
-bt_mbet_sport_free(void *object)
+bt_mbet_arena_release(bt_arena *arena)
 {
-    bt_mbet_sport *sport;
-    if (object == NULL)
-        return;
-    sport = object;
-    xmlFree(sport->code);
-    xmlFree(sport->name);
-    bt_mbet_free_generic_list(sport->groups);
-    bt_free(sport);
+    bt_arena_reset(arena);
+    // Keep at most one, for whichever thread parses next
+    arena = __atomic_exchange_n(&SpareArena, arena, __ATOMIC_ACQ_REL);
+    bt_arena_free(arena);
 }
 
 void
@@ -205,8 +120,8 @@ bt_mbet_feed_free(bt_mbet_feed *feed)
 {
     if (feed == NULL)
         return;
-    bt_mbet_free_generic_list(feed->sports);
-    bt_free(feed);
+    // The feed is in it's own arena, everything goes at once
+    bt_mbet_arena_release(feed->arena);
 }
 
 static int
@@ -270,17 +185,15 @@ bt_mbet_list_new(size_t count)
     bt_mbet_list *list;
     if (count == 0)
         return NULL;
-    list = bt_malloc(sizeof(bt_mbet_list));
+    list = bt_mbet_alloc(sizeof(bt_mbet_list));
     if (list == NULL)
         return NULL;
     list->count = count;
-    list->items = bt_malloc(count * sizeof(*list->items));
-    if (list->items == NULL) {
-        // This means we can try later, now it wouldn't make sense
-        // to use `list'
-        bt_free(list);
+    list->items = bt_mbet_alloc(count * sizeof(*list->items));
+    // This means we can try later, now it wouldn't make sense
+    // to use `list'
+    if (list->items == NULL)
         return NULL;
-    }
     return list;
 }
 
@@ -288,10 +201,9 @@ static bt_mbet_list_item *
 bt_mbet_list_item_new(void *parent)
 {
     bt_mbet_list_item *item;
-    item = bt_malloc(sizeof(bt_mbet_list_item));
+    item = bt_mbet_alloc(sizeof(bt_mbet_list_item));
     if (item == NULL)
         return NULL;
-    item->freefn = NULL;
     item->data = NULL;
     item->parent = parent;
     return item;
@@ -312,17 +224,8 @@ bt_mbet_init_list(size_t idx, xmlNode *node,
         // Set item fields, if this item is rejected
         // this function will return -1
         if (setter(list->items[idx], node) != 0) {
-            bt_mbet_list_item *item;
-            void (*free_item)(void *);
-            // Make a pointer to the item
-            item = list->items[idx];
-            // Get the free function
-            free_item = item->freefn;
-            // Free the item
-            free_item(item->data);
-            // Free the item
-            bt_free(item);
-            // Avoid problems
+            // It stays in the arena until the feed is released,
+            // just forget it
             list->items[idx] = NULL;
             // Return this value to allow the caller
             // to know that this failed.
@@ -338,32 +241,20 @@ static xmlNode *
 bt_mbet_get_node_xpath(const xmlChar *const expression, xmlNode *node)
 {
     xmlNodeSet *nodes;
-    xmlXPathContext *context;
     xmlXPathObject *xpath;
-    context = xmlXPathNewContext(node->doc);
-    if (context == NULL)
-        return NULL;
-    // Set the context node (the root node)
-    xmlXPathSetContextNode(node, context);
+    xmlNode *result;
     // Evaluate the xpath expression
-    xpath = xmlXPathEvalExpression((const xmlChar *) expression, context);
+    xpath = bt_mbet_xpath_eval(node, expression);
     if (xpath == NULL)
-        goto error;
-    // Get the set of matching nodes
+        return NULL;
+    // Get the set of matching nodes, the node belongs to the document
+    // so it's valid until it's freed
+    result = NULL;
     nodes = xpath->nodesetval;
-    if ((nodes == NULL) || (nodes->nodeNr != 1))
-        goto error;
-    node = xmlCopyNode(nodes->nodeTab[0], 1);
-
+    if ((nodes != NULL) && (nodes->nodeNr == 1))
+        result = nodes->nodeTab[0];
     xmlXPathFreeObject(xpath);
-    xmlXPathFreeContext(context);
-
-    return node;
-error:
-    if (xpath != NULL)
-        xmlXPathFreeObject(xpath);
-    xmlXPathFreeContext(context);
-    return NULL;
+    return result;
 }
 
 static bt_mbet_list *
@@ -372,7 +263,6 @@ bt_mbet_nodes_foreach(xmlNode *node, const xmlChar *const expression,
 {
     bt_mbet_list *list;
     xmlNodeSet *nodes;
-    xmlXPathContext *context;
     xmlXPathObject *xpath;
     xmlNode **table;
     size_t count;
@@ -387,16 +277,10 @@ bt_mbet_nodes_foreach(xmlNode *node, const xmlChar *const expression,
     // Safety first
     if (node == NULL)
         return NULL;
-    // Make a new context for the xpath query
-    context = xmlXPathNewContext(node->doc);
-    if (context == NULL)
-        return NULL;
-    // Set the context node (the root node)
-    xmlXPathSetContextNode(node, context);
-    // Evaluate the xpath expression
-    xpath = xmlXPathEvalExpression((const xmlChar *) expression, context);
+    // Evaluate the xpath expression, it's compiled only the first time
+    xpath = bt_mbet_xpath_eval(node, expression);
     if (xpath == NULL)
-        goto error;
+        return NULL;
     // Get the set of matching nodes
     nodes = xpath->nodesetval;
     if (nodes == NULL)
@@ -419,9 +303,7 @@ done:
     if (list != NULL)
         list->count = count;
 error:
-    if (xpath != NULL)
-        xmlXPathFreeObject(xpath);
-    xmlXPathFreeContext(context);
+    xmlXPathFreeObject(xpath);
     return list;
 }
 
@@ -439,21 +321,20 @@ bt_mbet_init_selection(bt_mbet_list_item *item, xmlNode *node)
 {
     bt_mbet_selection *selection;
     // Allocate space
-    item->freefn = bt_mbet_selection_free;
-    item->data = bt_malloc(sizeof(*selection));
+    item->data = bt_mbet_alloc(sizeof(*selection));
     if (item->data == NULL)
         return -1;
     // Make a poitner with the appropriate type
     selection = item->data;
     // Fill the structure
-    selection->name = bt_mbet_get_string_property(node, "name");
+    selection->name = bt_mbet_get_arena_property(node, "name", storage);
     selection->value = bt_mbet_get_float_property(node, "value");
     selection->coeff_id = bt_mbet_get_long_property(node, "coeffId");
     selection->coeff = bt_mbet_get_float_property(node, "coeff");
-    selection->selkey = bt_mbet_get_string_property(node, "selkey");
+    selection->selkey = bt_mbet_get_arena_property(node, "selkey", storage);
     selection->score_home = bt_mbet_get_integer_property(node, "scoreHome");
     selection->score_away = bt_mbet_get_integer_property(node, "scoreAway");
-    selection->uid = bt_mbet_get_string_property(node, "uid");
+    selection->uid = bt_mbet_get_arena_property(node, "uid", storage);
 
     return 0;
 }
@@ -463,8 +344,7 @@ bt_mbet_init_market(bt_mbet_list_item *item, xmlNode *node)
 {
     bt_mbet_market *market;
     // Allocate space
-    item->freefn = bt_mbet_market_free;
-    item->data = bt_malloc(sizeof(*market));
+    item->data = bt_mbet_alloc(sizeof(*market));
 
     if (item->data == NULL)
         return -1;
@@ -473,9 +353,9 @@ bt_mbet_init_market(bt_mbet_list_item *item, xmlNode *node)
     // Ensure this is null in case no selections are found
     market->selections = NULL;
     // Fill other members
-    market->model = bt_mbet_get_string_property(node, "model");
-    market->name = bt_mbet_get_string_property(node, "name");
-    market->type = bt_mbet_get_string_property(node, "type");
+    market->model = bt_mbet_get_arena_property(node, "model", storage);
+    market->name = bt_mbet_get_arena_property(node, "name", storage);
+    market->type = bt_mbet_get_arena_property(node, "type", storage);
     market->value = bt_mbet_get_float_property(node, "value");
     // Get all the selections for this market
     market->selections = bt_mbet_nodes_foreach(node,
@@ -517,8 +397,9 @@ bt_get_player_name_from_id(bt_mbet_member *member)
     mysql_stmt_close(stmt);
 
     if (result == 0) {
-        member->name = bt_strdup(name);
-        member->flag = bt_strdup(flag);
+        // The member is in the arena of the feed being parsed
+        member->name = bt_arena_strdup(storage, name);
+        member->flag = bt_arena_strdup(storage, flag);
         member->ranking = ranking;
     }
 
@@ -557,33 +438,41 @@ bt_get_player_from_mbet(bt_tennis_category *category, const char *const name)
 }
 
 static bt_mbet_member *
-bt_mbet_init_member(xmlNode *node)
+bt_mbet_member_new(const char *const name,
+                           const char *const selkey, long int id, const char *const role)
 {
     bt_mbet_member *member;
-    char *name;
+    if (name == NULL)
+        return NULL;
     // Allocate space
-    member = bt_calloc(1, sizeof(bt_mbet_member));
+    member = bt_mbet_alloc(sizeof(bt_mbet_member));
     if (member == NULL)
         return NULL;
-    // Fill the structure members
-    name = bt_mbet_get_string_property(node, "name");
-    if (name == NULL)
-        goto error;
-    member->selkey = bt_mbet_get_string_property(node, "selkey");
-    member->id = bt_mbet_get_long_property(node, "id");
-    member->role = bt_mbet_get_string_property(node, "role");
+    // Fill the structure members, the strings are in the arena
+    member->selkey = selkey;
+    member->id = id;
+    member->role = role;
+    // Only the XML, for the benchmark
+    if (offline == true) {
+        member->ocid = -1;
+        member->name = bt_arena_strdup(storage, name);
+        return member;
+    }
     member->ocid = bt_get_player_from_mbet(&member->category, name);
     if (member->ocid == -1)
-        goto error;
+        return NULL;
     if (bt_get_player_name_from_id(member) == -1)
-        goto error;
-    xmlFree(name);
+        return NULL;
     return member;
-error:
-    if (name != NULL)
-        xmlFree(name);
-    bt_mbet_member_free(member);
-    return NULL;
+}
+
+static bt_mbet_member *
+bt_mbet_init_member(xmlNode *node)
+{
+    return bt_mbet_member_new(bt_mbet_get_arena_property(node, "name", storage),
+                              bt_mbet_get_arena_property(node, "selkey", storage),
+                              bt_mbet_get_long_property(node, "id"),
+                              bt_mbet_get_arena_property(node, "role", storage));
 }
 
 static int
@@ -591,6 +480,9 @@ bt_mbet_update_tournament_id(bt_mbet_group *group, bt_mbet_event *event)
 {
     bt_mbet_member *home;
     bt_mbet_member *away;
+    char *name;
+    char *flag;
+    char *court;
 
     home = event->home;
     away = event->away;
@@ -618,8 +510,15 @@ bt_mbet_update_tournament_id(bt_mbet_group *group, bt_mbet_event *event)
         break;
     }
 
+    // These are allocated with `bt_malloc()', move them to the arena
     bt_database_get_tournament_name(event->category,
-                      event->octour, &group->name, &group->flag, &group->court);
+                                      event->octour, &name, &flag, &court);
+    group->name = bt_arena_strdup(storage, name);
+    group->flag = bt_arena_strdup(storage, flag);
+    group->court = bt_arena_strdup(storage, court);
+    bt_free(name);
+    bt_free(flag);
+    bt_free(court);
     group->category = event->category;
     group->ocround = event->ocround;
     group->ocid = event->octour;
@@ -655,17 +554,43 @@ bt_mbet_get_player_odds(const bt_mbet_member *const home,
     mysql_stmt_close(stmt);
 }
 
+static int
+bt_mbet_event_link(bt_mbet_event *const event, bt_mbet_group *const group)
+{
+    // Update the parent (the group) with data that is only available
+    // in the events.
+    //
+    // We check if the `octour` has been set and it would mean
+    // that we already did this. Avoiding to query the database
+    // quite a large number of times is necessary.
+    // Get the category for this member
+    // TODO: It would be nice to check if the other member belongs
+    //       to the same category. In case it doesn't, some error
+    //       happened and we could inspect what was it.
+    if ((offline == false) && (group->ocid == -1) &&
+                          (bt_mbet_update_tournament_id(group, event) == -1))
+        return -1;
+    event->ocround = group->ocround;
+    event->octour = group->ocid;
+    event->ocrank = group->ocrank;
+    event->group = group;
+    event->category = group->category;
+
+    if (offline == false)
+        bt_mbet_get_player_odds(event->home, event->away, group->ocid, group->ocround);
+    // This means that this item is added to it's parent's list
+    return 0;
+}
+
 static int
 bt_mbet_init_event(bt_mbet_list_item *item, xmlNode *node)
 {
     bt_mbet_event *event;
-    bt_mbet_group *group;
     xmlNode *member;
     if (item->parent == NULL)
         return -1;
     // Allocate space
-    item->freefn = bt_mbet_event_free;
-    item->data = bt_malloc(sizeof(bt_mbet_event));
+    item->data = bt_mbet_alloc(sizeof(bt_mbet_event));
     if (item->data == NULL)
         return -1;
     // Make a poitner with the appropriate type
@@ -675,16 +600,15 @@ bt_mbet_init_event(bt_mbet_list_item *item, xmlNode *node)
     event->home = NULL;
     event->away = NULL;
     // Fill the structure members
-    event->name = bt_mbet_get_string_property(node, "name");
+    event->name = bt_mbet_get_arena_property(node, "name", storage);
     event->tree_id = bt_mbet_get_long_property(node, "treeId");
-    event->url = bt_mbet_get_node_conent_string(node, "./url");
-    event->score = bt_score_parse_mbet(node);
+    event->url = bt_mbet_get_node_content_arena(node, "./url", storage);
+    event->score = bt_score_parse_mbet(node, storage);
     // Get home member
     member = bt_mbet_get_node_xpath(HOME_XPATH, node);
     if (member == NULL)
         return -1;
     event->home = bt_mbet_init_member(member);
-    xmlFreeNode(member);
     if (event->home == NULL)
         return -1;
     // Get away member
@@ -692,7 +616,6 @@ bt_mbet_init_event(bt_mbet_list_item *item, xmlNode *node)
     if (member == NULL)
         return -1;
     event->away = bt_mbet_init_member(member);
-    xmlFreeNode(member);
     if (event->away == NULL)
         return -1;
     // Get the list of all markets for this event
@@ -700,31 +623,8 @@ bt_mbet_init_event(bt_mbet_list_item *item, xmlNode *node)
               (const xmlChar *) "./markets/market", event, bt_mbet_init_market);
     // Extract the date
     bt_mbet_get_date_property(node, "date", &event->date);
-    // Update the parent (the group) with data that is only available
-    // in the events.
-    //
-    // We check if the `octour` has been set and it would mean
-    // that we already did this. Avoiding to query the database
-    // quite a large number of times is necessary.
-    group = item->parent;
-    // Get the category for this member
-    // TODO: It would be nice to check if the other member belongs
-    //       to the same category. In case it doesn't, some error
-    //       happened and we could inspect what was it.
-    if ((group->ocid == -1) && (bt_mbet_update_tournament_id(group, event) == -1))
-        goto error;
-    event->ocround = group->ocround;
-    event->octour = group->ocid;
-    event->ocrank = group->ocrank;
-    event->group = group;
-    event->category = group->category;
-
-    bt_mbet_get_player_odds(event->home, event->away, group->ocid, group->ocround);
-    // This means that this item is added to it's parent's list
-    return 0;
-error:
-    bt_mbet_event_free(event);
-    return -1;
+    // The caller drops the event if it's rejected
+    return bt_mbet_event_link(event, item->parent);
 }
 
 static int
@@ -732,10 +632,8 @@ bt_mbet_init_group(bt_mbet_list_item *item, xmlNode *node)
 {
     const xmlChar *expression;
     bt_mbet_group *group;
-    // Set the free function
-    item->freefn = bt_mbet_group_free;
     // Allocate space
-    item->data = bt_malloc(sizeof(bt_mbet_group));
+    item->data = bt_mbet_alloc(sizeof(bt_mbet_group));
     if (item->data == NULL)
         return -1;
     // Make a poitner with the appropriate type
@@ -774,8 +672,7 @@ bt_mbet_init_sport(bt_mbet_list_item *item, xmlNode *node)
     const xmlChar *expression;
     bt_mbet_sport *sport;
     // Allocate space
-    item->freefn = bt_mbet_sport_free;
-    item->data = bt_malloc(sizeof(bt_mbet_sport));
+    item->data = bt_mbet_alloc(sizeof(bt_mbet_sport));
     if (item->data == NULL)
         return -1;
     // Make a poitner with the appropriate type
@@ -785,8 +682,8 @@ bt_mbet_init_sport(bt_mbet_list_item *item, xmlNode *node)
     // Ensure this is NULL
     sport->groups = NULL;
     // Fill the structure
-    sport->code = bt_mbet_get_string_property(node, "code");
-    sport->name = bt_mbet_get_string_property(node, "name");
+    sport->code = bt_mbet_get_arena_property(node, "code", storage);
+    sport->name = bt_mbet_get_arena_property(node, "name", storage);
     // List all the groups in this ssport
     sport->groups = bt_mbet_nodes_foreach(node,
                                          expression, sport, bt_mbet_init_group);
@@ -808,9 +705,10 @@ bt_mbet_parse_root(xmlNode *root)
     //       there is no interest in fixing this.
     expression = (const xmlChar *) "//sport";
     // Allocate space for the result object
-    result = bt_malloc(sizeof(*result));
+    result = bt_mbet_alloc(sizeof(*result));
     if (result == NULL)
         return NULL;
+    result->arena = storage;
     // List all the sports
     result->sports = bt_mbet_nodes_foreach(root,
                                           expression, NULL, bt_mbet_init_sport);
@@ -818,14 +716,465 @@ bt_mbet_parse_root(xmlNode *root)
     return result;
 }
 
+// The ways to parse a feed, `MBET_PARSER' chooses one
+enum bt_mbet_parser {
+    MbetParserTree, // `xmlReadMemory()' and XPath, the original
+    MbetParserReader, // `xmlTextReader', one pass and no tree
+    MbetParserCount
+};
+
+static const char *const ParserNames[MbetParserCount] = {"tree", "reader"};
+
+// What an element is, given it's name and it's parent
+enum bt_mbet_element {
+    ElementOther,
+    ElementSport,
+    ElementGroups,
+    ElementGroup,
+    ElementEvents,
+    ElementEvent,
+    ElementUrl,
+    ElementLiveResult,
+    ElementMembers,
+    ElementMember,
+    ElementMarkets,
+    ElementMarket,
+    ElementSelection
+};
+
+// Deeper elements are not part of the feed
+#define BT_MBET_READER_DEPTH 16
+
+typedef struct bt_mbet_reader {
+    xmlTextReader *reader;
+    enum bt_mbet_element elements[BT_MBET_READER_DEPTH];
+    bt_mbet_feed *feed;
+    // The open objects, and the capacity of their lists
+    bt_mbet_sport *sport;
+    bt_mbet_group *group;
+    bt_mbet_event *event;
+    bt_mbet_market *market;
+    size_t sports;
+    size_t groups;
+    size_t events;
+    size_t markets;
+    size_t selections;
+    // The event lacks a player or something, drop it when it ends
+    bool rejected;
+    // The tree parser ignores `url' and `liveresult' if they repeat
+    size_t urls;
+    size_t results;
+    // The text of `url' and `liveresult'
+    char *text;
+    size_t length;
+    size_t size;
+} bt_mbet_reader;
+
+static enum bt_mbet_element
+bt_mbet_reader_classify(const xmlChar *const name, enum bt_mbet_element parent)
+{
+    // The same paths the XPath expressions of the tree parser match
+    switch (parent) {
+    case ElementSport:
+        if (xmlStrEqual(name, (const xmlChar *) "groups"))
+            return ElementGroups;
+        break;
+    case ElementGroups:
+        if (xmlStrEqual(name, (const xmlChar *) "group"))
+            return ElementGroup;
+        break;
+    case ElementGroup:
+        if (xmlStrEqual(name, (const xmlChar *) "events"))
+            return ElementEvents;
+        break;
+    case ElementEvents:
+        if (xmlStrEqual(name, (const xmlChar *) "event"))
+            return ElementEvent;
+        break;
+    case ElementEvent:
+        if (xmlStrEqual(name, (const xmlChar *) "url"))
+            return ElementUrl;
+        if (xmlStrEqual(name, (const xmlChar *) "liveresult"))
+            return ElementLiveResult;
+        if (xmlStrEqual(name, (const xmlChar *) "members"))
+            return ElementMembers;
+        if (xmlStrEqual(name, (const xmlChar *) "markets"))
+            return ElementMarkets;
+        break;
+    case ElementMembers:
+        if (xmlStrEqual(name, (const xmlChar *) "member"))
+            return ElementMember;
+        break;
+    case ElementMarkets:
+        if (xmlStrEqual(name, (const xmlChar *) "market"))
+            return ElementMarket;
+        break;
+    case ElementMarket:
+        if (xmlStrEqual(name, (const xmlChar *) "sel"))
+            return ElementSelection;
+        break;
+    default:
+        break;
+    }
+    // Like `//sport', but they don't nest
+    if (xmlStrEqual(name, (const xmlChar *) "sport"))
+        return ElementSport;
+    return ElementOther;
+}
+
+static bt_mbet_list_item *
+bt_mbet_reader_append(bt_mbet_list **list, size_t *size, void *parent, void *data)
+{
+    bt_mbet_list_item *item;
+    // The tree parser makes the list if there is at least one
+    // child, even if they are all rejected
+    if (*list == NULL) {
+        *list = bt_mbet_alloc(sizeof(**list));
+        if (*list == NULL)
+            return NULL;
+        *size = 0;
+    }
+    if ((*list)->count == *size) {
+        bt_mbet_list_item **items;
+        size_t count;
+        // The arena can't grow it in place, the old array is left
+        // there, doubling keeps that below the final size
+        count = (*size == 0) ? 16 : 2 * *size;
+        items = bt_arena_alloc(storage, count * sizeof(*items));
+        if (items == NULL)
+            return NULL;
+        if ((*list)->count > 0)
+            memcpy(items, (*list)->items, (*list)->count * sizeof(*items));
+        (*list)->items = items;
+        *size = count;
+    }
+    item = bt_mbet_list_item_new(parent);
+    if (item == NULL)
+        return NULL;
+    item->data = data;
+    (*list)->items[(*list)->count++] = item;
+    return item;
+}
+
+static void
+bt_mbet_reader_open_sport(bt_mbet_reader *const state)
+{
+    bt_mbet_sport *sport;
+    sport = bt_mbet_alloc(sizeof(*sport));
+    if (sport == NULL)
+        return;
+    sport->code = bt_mbet_reader_get_arena_property(state->reader, "code", storage);
+    sport->name = bt_mbet_reader_get_arena_property(state->reader, "name", storage);
+    if (bt_mbet_reader_append(&state->feed->sports, &state->sports, NULL, sport) != NULL)
+        state->sport = sport;
+}
+
+static void
+bt_mbet_reader_open_group(bt_mbet_reader *const state)
+{
+    bt_mbet_group *group;
+    if (state->sport == NULL)
+        return;
+    group = bt_mbet_alloc(sizeof(*group));
+    if (group == NULL)
+        return;
+    group->ocid = -1;
+    group->ocround = -1;
+    group->ocrank = -1;
+    group->altitude = 0.0;
+    group->category = NoCategory;
+    group->tree_id = bt_mbet_reader_get_long(state->reader, "treeId");
+    group->is_american = bt_mbet_reader_get_integer(state->reader, "isAmerican");
+    if (bt_mbet_reader_append(&state->sport->groups,
+                                       &state->groups, state->sport, group) != NULL)
+        state->group = group;
+}
+
+static void
+bt_mbet_reader_open_event(bt_mbet_reader *const state)
+{
+    bt_mbet_event *event;
+    if (state->group == NULL)
+        return;
+    event = bt_mbet_alloc(sizeof(*event));
+    if (event == NULL)
+        return;
+    event->name = bt_mbet_reader_get_arena_property(state->reader, "name", storage);
+    event->tree_id = bt_mbet_reader_get_long(state->reader, "treeId");
+    bt_mbet_reader_get_date(state->reader, "date", &event->date);
+    // It's removed from the list if it's rejected when it ends
+    if (bt_mbet_reader_append(&state->group->events,
+                                       &state->events, state->group, event) != NULL)
+        state->event = event;
+    state->rejected = false;
+    state->urls = 0;
+    state->results = 0;
+}
+
+static void
+bt_mbet_reader_open_member(bt_mbet_reader *const state)
+{
+    bt_mbet_member **target;
+    const char *selkey;
+    if ((state->event == NULL) || (state->rejected == true))
+        return;
+    selkey = bt_mbet_reader_get_arena_property(state->reader, "selkey", storage);
+    if (selkey == NULL)
+        return;
+    target = NULL;
+    if (strcmp(selkey, "HOME") == 0)
+        target = &state->event->home;
+    else if (strcmp(selkey, "AWAY") == 0)
+        target = &state->event->away;
+    if (target == NULL)
+        return;
+    // The tree parser wants exactly one of each
+    if (*target != NULL) {
+        state->rejected = true;
+        return;
+    }
+    *target = bt_mbet_member_new(bt_mbet_reader_get_arena_property(state->reader, "name", storage),
+                            selkey, bt_mbet_reader_get_long(state->reader, "id"),
+                          bt_mbet_reader_get_arena_property(state->reader, "role", storage));
+    if (*target == NULL)
+        state->rejected = true;
+}
+
+static void
+bt_mbet_reader_open_market(bt_mbet_reader *const state)
+{
+    bt_mbet_market *market;
+    if ((state->event == NULL) || (state->rejected == true))
+        return;
+    market = bt_mbet_alloc(sizeof(*market));
+    if (market == NULL)
+        return;
+    market->model = bt_mbet_reader_get_arena_property(state->reader, "model", storage);
+    market->name = bt_mbet_reader_get_arena_property(state->reader, "name", storage);
+    market->type = bt_mbet_reader_get_arena_property(state->reader, "type", storage);
+    market->value = bt_mbet_reader_get_float(state->reader, "value");
+    if (bt_mbet_reader_append(&state->event->markets,
+                                     &state->markets, state->event, market) != NULL)
+        state->market = market;
+}
+
+static void
+bt_mbet_reader_open_selection(bt_mbet_reader *const state)
+{
+    bt_mbet_selection *selection;
+    if (state->market == NULL)
+        return;
+    selection = bt_mbet_alloc(sizeof(*selection));
+    if (selection == NULL)
+        return;
+    selection->name = bt_mbet_reader_get_arena_property(state->reader, "name", storage);
+    selection->value = bt_mbet_reader_get_float(state->reader, "value");
+    selection->coeff_id = bt_mbet_reader_get_long(state->reader, "coeffId");
+    selection->coeff = bt_mbet_reader_get_float(state->reader, "coeff");
+    selection->selkey = bt_mbet_reader_get_arena_property(state->reader, "selkey", storage);
+    selection->score_home = bt_mbet_reader_get_integer(state->reader, "scoreHome");
+    selection->score_away = bt_mbet_reader_get_integer(state->reader, "scoreAway");
+    selection->uid = bt_mbet_reader_get_arena_property(state->reader, "uid", storage);
+    bt_mbet_reader_append(&state->market->selections,
+                                       &state->selections, state->market, selection);
+}
+
+static void
+bt_mbet_reader_open(bt_mbet_reader *const state, enum bt_mbet_element element)
+{
+    switch (element) {
+    case ElementSport:
+        bt_mbet_reader_open_sport(state);
+        break;
+    case ElementGroup:
+        bt_mbet_reader_open_group(state);
+        break;
+    case ElementEvent:
+        bt_mbet_reader_open_event(state);
+        break;
+    case ElementUrl:
+    case ElementLiveResult:
+        state->length = 0;
+        if (state->text != NULL)
+            state->text[0] = '\0';
+        break;
+    case ElementMember:
+        bt_mbet_reader_open_member(state);
+        break;
+    case ElementMarket:
+        bt_mbet_reader_open_market(state);
+        break;
+    case ElementSelection:
+        bt_mbet_reader_open_selection(state);
+        break;
+    default:
+        break;
+    }
+}
+
+static void
+bt_mbet_reader_close_event(bt_mbet_reader *const state)
+{
+    bt_mbet_event *event;
+    bt_mbet_list *events;
+    event = state->event;
+    state->event = NULL;
+    if (event == NULL)
+        return;
+    if ((state->rejected == false) && (event->home != NULL) && (event->away != NULL) &&
+                                    (bt_mbet_event_link(event, state->group) == 0))
+        return;
+    // It's the last one in the list, events don't nest. The memory
+    // stays in the arena until the feed is released
+    events = state->group->events;
+    events->count -= 1;
+}
+
+static void
+bt_mbet_reader_close(bt_mbet_reader *const state, enum bt_mbet_element element)
+{
+    const char *text;
+    // `xmlNodeGetContent()' gives an empty string for empty elements
+    text = (state->text != NULL) ? state->text : "";
+    switch (element) {
+    case ElementSport:
+        if (state->sport != NULL)
+            bt_mbet_sort_list(state->sport->groups, bt_mbet_compare_groups);
+        state->sport = NULL;
+        break;
+    case ElementGroup:
+        if (state->group != NULL)
+            bt_mbet_sort_list(state->group->events, bt_mbet_eventcmp);
+        state->group = NULL;
+        break;
+    case ElementEvent:
+        bt_mbet_reader_close_event(state);
+        break;
+    case ElementUrl:
+        if (state->event == NULL)
+            break;
+        state->event->url = NULL;
+        if (state->urls++ == 0)
+            state->event->url = bt_arena_strdup(storage, text);
+        break;
+    case ElementLiveResult:
+        if (state->event == NULL)
+            break;
+        state->event->score = NULL;
+        if (state->results++ == 0)
+            state->event->score = bt_score_parse_mbet_text(text, storage);
+        break;
+    case ElementMarket:
+        if (state->market != NULL)
+            bt_mbet_sort_list(state->market->selections, bt_mbet_compare_selections);
+        state->market = NULL;
+        break;
+    default:
+        break;
+    }
+}
+
+static void
+bt_mbet_reader_text(bt_mbet_reader *const state)
+{
+    const xmlChar *value;
+    size_t length;
+    value = xmlTextReaderConstValue(state->reader);
+    if (value == NULL)
+        return;
+    length = xmlStrlen(value);
+    if (state->length + length + 1 > state->size) {
+        char *text;
+        size_t size;
+        size = state->length + length + 1 + 64;
+        text = bt_realloc(state->text, size);
+        if (text == NULL)
+            return;
+        state->text = text;
+        state->size = size;
+    }
+    memcpy(state->text + state->length, value, length + 1);
+    state->length += length;
+}
+
+static int
+bt_mbet_reader_step(bt_mbet_reader *const state)
+{
+    enum bt_mbet_element element;
+    enum bt_mbet_element parent;
+    int depth;
+    depth = xmlTextReaderDepth(state->reader);
+    if (depth < 0)
+        return -1;
+    parent = ElementOther;
+    if ((depth > 0) && (depth <= BT_MBET_READER_DEPTH))
+        parent = state->elements[depth - 1];
+    switch (xmlTextReaderNodeType(state->reader)) {
+    case XML_READER_TYPE_ELEMENT:
+        element = bt_mbet_reader_classify(xmlTextReaderConstLocalName(state->reader), parent);
+        // Tennis is the only sport anyway, they don't nest
+        if ((element == ElementSport) && (state->sport != NULL))
+            element = ElementOther;
+        if (depth >= BT_MBET_READER_DEPTH)
+            element = ElementOther;
+        else
+            state->elements[depth] = element;
+        bt_mbet_reader_open(state, element);
+        // There will be no end element for `<tag/>'
+        if (xmlTextReaderIsEmptyElement(state->reader) == 1)
+            bt_mbet_reader_close(state, element);
+        break;
+    case XML_READER_TYPE_END_ELEMENT:
+        if (depth < BT_MBET_READER_DEPTH)
+            bt_mbet_reader_close(state, state->elements[depth]);
+        break;
+    case XML_READER_TYPE_TEXT:
+    case XML_READER_TYPE_CDATA:
+    case XML_READER_TYPE_SIGNIFICANT_WHITESPACE:
+        if ((parent == ElementUrl) || (parent == ElementLiveResult))
+            bt_mbet_reader_text(state);
+        break;
+    default:
+        break;
+    }
+    return 0;
+}
+
+static bt_mbet_feed *
+bt_mbet_parse_reader(const char *const xml, size_t length)
+{
+    bt_mbet_reader state;
+    int result;
+    memset(&state, 0, sizeof(state));
+    // Read the XML once, building the feed as the elements arrive
+    state.reader = xmlReaderForMemory(xml, length, NULL, NULL, 0);
+    if (state.reader == NULL)
+        return NULL;
+    state.feed = bt_mbet_alloc(sizeof(*state.feed));
+    if (state.feed == NULL)
+        goto error;
+    state.feed->arena = storage;
+    while ((result = xmlTextReaderRead(state.reader)) == 1) {
+        if (bt_mbet_reader_step(&state) == -1)
+            break;
+    }
+    // Malformed, like `xmlParseDoc()' it gives nothing
+    if (result != 0)
+        state.feed = NULL;
+error:
+    bt_free(state.text);
+    xmlFreeTextReader(state.reader);
+    return state.feed;
+}
+
 static bt_mbet_feed *
-bt_mbet_parse_document(xmlChar *data, bt_mbet_feed_handler_fn handler)
+bt_mbet_parse_document(const char *const xml, size_t length)
 {
     bt_mbet_feed *live;
     xmlDoc *document;
     xmlNode *root;
     // Make a document from the raw XML
-    document = xmlParseDoc(data);
+    document = xmlReadMemory(xml, length, NULL, NULL, 0);
     if (document == NULL)
         return NULL;
     // Make a pointer to the root element
@@ -834,23 +1183,53 @@ bt_mbet_parse_document(xmlChar *data, bt_mbet_feed_handler_fn handler)
     if (root != NULL) {
         // Parse the document, from the root element
         live = bt_mbet_parse_root(root);
-        if ((live != NULL) && (handler != NULL)) {
-            // Handle the whole `bt_mbet_live` object
-            handler(live);
-        }
     }
     // Destroy the XML document
     xmlFreeDoc(document);
     return live;
 }
 
-bt_mbet_feed *
-bt_mbet_feed_get(enum bt_mbet_feed_type ft, bt_mbet_feed_handler_fn handler)
+static bt_mbet_feed *
+bt_mbet_parse(const char *const xml, size_t length, enum bt_mbet_parser parser)
+{
+    bt_mbet_feed *feed;
+    // The whole feed goes here, the strings are copied from the XML
+    storage = bt_mbet_arena_get();
+    if (storage == NULL)
+        return NULL;
+    feed = NULL;
+    switch (parser) {
+    case MbetParserTree:
+        feed = bt_mbet_parse_document(xml, length);
+        break;
+    case MbetParserReader:
+        feed = bt_mbet_parse_reader(xml, length);
+        break;
+    default:
+        break;
+    }
+    // The feed owns it now
+    if (feed == NULL)
+        bt_mbet_arena_release(storage);
+    storage = NULL;
+    return feed;
+}
+
+static enum bt_mbet_parser
+bt_mbet_get_parser(void)
+{
+    const char *envvar;
+    // The tree parser is still here to compare them
+    envvar = getenv("MBET_PARSER");
+    if ((envvar != NULL) && (strcmp(envvar, "tree") == 0))
+        return MbetParserTree;
+    return MbetParserReader;
+}
+
+static char *
+bt_mbet_feed_get_url(enum bt_mbet_feed_type ft)
 {
-    bt_mbet_feed *live;
     const char *type[2] = {"pre", "liv"};
-    char *url;
-    char *xml;
     // Connect to the mbet feed.
     // TODO: This should be the mbet url instead, but
     //       since we are still testing this software
@@ -859,28 +1238,75 @@ bt_mbet_feed_get(enum bt_mbet_feed_type ft, bt_mbet_feed_handler_fn handler)
     //
     //       The release version of this software
     //       should use the original url.
+    return bt_strdup_printf(FEED_URL, type[ft]);
+}
+
+static bt_mbet_feed *
+bt_mbet_feed_fetch(enum bt_mbet_feed_type ft,
+                                      bt_mbet_feed_handler_fn handler, bool cached)
+{
+    bt_mbet_feed *live;
+    enum bt_http_result status;
+    char *url;
+    char *xml;
     live = NULL;
     // Build the URL
-    url = bt_strdup_printf(FEED_URL, type[ft]);
+    url = bt_mbet_feed_get_url(ft);
     if (url == NULL)
         return NULL;
-    // Perform the GET request
-    xml = bt_http_get(url, false, NULL, NULL);
+    // Perform the GET request, an unchanged feed has nothing new for
+    // the handlers
+    if (cached == true)
+        xml = bt_http_get_cached(url, false, NULL, NULL, &status);
+    else
+        xml = bt_http_get(url, false, NULL, NULL);
     if (xml == NULL)
         goto error;
-    live = bt_mbet_parse_document((xmlChar *) xml, handler);
+    live = bt_mbet_parse(xml, strlen(xml), bt_mbet_get_parser());
+    // Deliver it again next time, this one was not used
+    if ((live == NULL) && (cached == true))
+        bt_http_cache_invalidate(url);
+    // Handle the whole `bt_mbet_live` object
+    if ((live != NULL) && (handler != NULL))
+        handler(live);
 error:
     bt_free(xml);
     bt_free(url);
     return live;
 }
 
+bt_mbet_feed *
+bt_mbet_feed_get(enum bt_mbet_feed_type ft, bt_mbet_feed_handler_fn handler)
+{
+    return bt_mbet_feed_fetch(ft, handler, false);
+}
+
+bt_mbet_feed *
+bt_mbet_feed_get_cached(enum bt_mbet_feed_type ft, bt_mbet_feed_handler_fn handler)
+{
+    return bt_mbet_feed_fetch(ft, handler, true);
+}
+
+void
+bt_mbet_feed_invalidate(enum bt_mbet_feed_type ft)
+{
+    char *url;
+    url = bt_mbet_feed_get_url(ft);
+    if (url == NULL)
+        return;
+    bt_http_cache_invalidate(url);
+    bt_free(url);
+}
+
 static void
 bt_mbet_generic_group_handler(const bt_mbet_group *const group,
                                    bt_mbet_event_handler_fn handler, void *data)
 {
     bt_mbet_list *events;
     events = group->events;
+    // An empty list is `NULL'
+    if (events == NULL)
+        return;
     for (size_t edx = 0; edx < events->count; ++edx) {
         bt_mbet_list_item *item;
         item = events->items[edx];
@@ -896,6 +1322,8 @@ bt_mbet_generic_sport_handler(const bt_mbet_sport *const sport,
 {
     bt_mbet_list *groups;
     groups = sport->groups;
+    if (groups == NULL)
+        return;
     for (size_t gdx = 0; gdx < groups->count; ++gdx) {
         bt_mbet_list_item *item;
         item = groups->items[gdx];
@@ -922,6 +1350,8 @@ bt_mbet_sport_count_events(bt_mbet_sport *sport)
     size_t count;
     count = 0;
     list = sport->groups;
+    if (list == NULL)
+        return 0;
     for (size_t gdx = 0; gdx < list->count; ++gdx) {
         bt_mbet_list_item *item;
         item = list->items[gdx];
@@ -941,6 +1371,8 @@ bt_mbet_count_events(const bt_mbet_feed *const live)
     count = 0;
     // Make a poitner to the sports object
     sports = live->sports;
+    if (sports == NULL)
+        return 0;
     // Start counting events, for each sport
     for (size_t sdx = 0; sdx < sports->count; ++sdx) {
         bt_mbet_list_item *item;
@@ -951,3 +1383,84 @@ bt_mbet_count_events(const bt_mbet_feed *const live)
     }
     return count;
 }
+
+static char *
+bt_mbet_read_file(const char *const path, size_t *length)
+{
+    char *data;
+    long int size;
+    FILE *file;
+    file = fopen(path, "r");
+    if (file == NULL)
+        return NULL;
+    data = NULL;
+    fseek(file, 0L, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0L, SEEK_SET);
+    if (size < 0)
+        goto error;
+    data = bt_malloc(size + 1);
+    if (data == NULL)
+        goto error;
+    if (fread(data, 1, size, file) != (size_t) size) {
+        bt_free(data);
+        data = NULL;
+        goto error;
+    }
+    // `null' terminate it
+    data[size] = '\0';
+    *length = size;
+error:
+    fclose(file);
+    return data;
+}
+
+static double
+bt_mbet_benchmark_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + 1.0E-9 * now.tv_nsec;
+}
+
+int
+bt_mbet_feed_benchmark(char *const *const paths, size_t count)
+{
+    // The lookups are the same for both parsers and they need the
+    // database, so leave them out
+    offline = true;
+    printf("%-32s %-7s %10s %8s\n", "feed", "parser", "ms", "events");
+    for (size_t idx = 0; idx < count; ++idx) {
+        size_t length;
+        char *xml;
+        xml = bt_mbet_read_file(paths[idx], &length);
+        if (xml == NULL) {
+            log("error: cannot read `%s'\n", paths[idx]);
+            continue;
+        }
+        for (size_t parser = 0; parser < MbetParserCount; ++parser) {
+            bt_mbet_feed *feed;
+            size_t events;
+            double start;
+            // Once to warm up, and to count the events
+            feed = bt_mbet_parse(xml, length, parser);
+            if (feed == NULL) {
+                log("error: `%s' is not a valid feed\n", paths[idx]);
+                break;
+            }
+            events = bt_mbet_count_events(feed);
+            bt_mbet_feed_free(feed);
+            start = bt_mbet_benchmark_now();
+            for (size_t round = 0; round < BT_MBET_BENCHMARK_ROUNDS; ++round)
+                bt_mbet_feed_free(bt_mbet_parse(xml, length, parser));
+            printf("%-32s %-7s %10.3f %8zu\n", paths[idx], ParserNames[parser],
+                 1.0E3 * (bt_mbet_benchmark_now() - start) / BT_MBET_BENCHMARK_ROUNDS,
+                                                                           events);
+        }
+        bt_free(xml);
+    }
+    fflush(stdout);
+    bt_mbet_xpath_thread_release();
+    offline = false;
+    return 0;
+}
@@ -2,6 +2,7 @@
 #include <bt-mbet-xml.h>
 #include <bt-mbet-score.h>
 #include <bt-memory.h>
+#include <bt-arena.h>
 
 #include <string.h>
 
@@ -91,7 +92,7 @@ bt_mbet_extract_score(char *string, bt_mbet_score_item *score, uint8_t *active)
 }
 
 static bt_mbet_score_item *
-bt_mbet_extract_sets(char *const string, int8_t *count)
+bt_mbet_extract_sets(char *const string, int8_t *count, bt_arena *arena)
 {
     bt_mbet_score_item *score;
     char **sets;
@@ -115,14 +116,8 @@ bt_mbet_extract_sets(char *const string, int8_t *count)
     // There is no score, please exit this function
     if (*count == 0)
         goto failed;
-    // Allocate space for the score object
-    // FIXME: Perhaps it would be better to
-    //        have an array of 5 items to
-    //        avoid `malloc`ing. After all
-    //        there is no possibility for a
-    //        tennis match with more than 5
-    //        sets
-    score = bt_malloc(*count * sizeof(*score));
+    // Allocate space for the score object, in the feed's arena
+    score = bt_arena_alloc(arena, *count * sizeof(*score));
     if (score == NULL)
         goto failed;
     // Initialize all the values because some of them
@@ -139,22 +134,17 @@ failed:
 }
 
 bt_mbet_score *
-bt_score_parse_mbet(xmlNode *node)
+bt_score_parse_mbet_text(const char *const content, bt_arena *arena)
 {
     bt_mbet_score *result;
-    char *content;
     char **parts;
-    // Get the contents of the `liveresult' tag
-    content = bt_mbet_get_node_conent_string(node, "liveresult");
     if (content == NULL)
         return NULL;
-    // Allocate space forthe result object
-    // TODO: Since this is a simple structure
-    //       perhaps we can avoid to malloc
-    //       it.
-    result = bt_malloc(sizeof(*result));
+    // Allocate space forthe result object, it's released with
+    // the arena
+    result = bt_arena_alloc(arena, sizeof(*result));
     if (result == NULL)
-        goto failure;
+        return NULL;
     // Initiialize all the values to 0 since there is
     // no guarantee that they will be initialized.
     memset(&result->score, 0, sizeof(result->score));
@@ -170,23 +160,32 @@ bt_score_parse_mbet(xmlNode *node)
         if (parts[2] == NULL) {
             // Get the first set, it's always before any '('
             // character becuase it's not parenthesized
-            result->sets = bt_mbet_extract_sets(parts[0], &result->nsets);
+            result->sets = bt_mbet_extract_sets(parts[0], &result->nsets, arena);
             bt_mbet_extract_score(parts[1], &result->game, &result->service);
         } else {
             // Get the remaining sets, they always go
             // after the openning parenthesis
             bt_mbet_extract_score(parts[0], &result->score, NULL);
-            result->sets = bt_mbet_extract_sets(parts[1], &result->nsets);
+            result->sets = bt_mbet_extract_sets(parts[1], &result->nsets, arena);
             bt_mbet_extract_score(parts[2], &result->game, &result->service);
         }
     }
     // Release used resources
     bt_string_list_free(parts);
-failure:
-    bt_free(content);
     return result;
 }
 
+bt_mbet_score *
+bt_score_parse_mbet(xmlNode *node, bt_arena *arena)
+{
+    const char *content;
+    // Get the contents of the `liveresult' tag
+    content = bt_mbet_get_node_content_arena(node, "liveresult", arena);
+    if (content == NULL)
+        return NULL;
+    return bt_score_parse_mbet_text(content, arena);
+}
+
 bt_mbet_score *
 bt_score_parse_oncourt(const char *const source)
 {
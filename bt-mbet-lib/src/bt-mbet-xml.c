@@ -1,38 +1,163 @@
 #include <string.h>
 #include <libxml/xpath.h>
+#include <libxml/xmlreader.h>
 #include <bt-mbet-xml.h>
+#include <bt-memory.h>
+#include <bt-util.h>
+
+// Expressions compiled per thread, the feed uses less than this
+#define BT_MBET_XPATH_CACHE_SIZE 16
+
+typedef struct bt_mbet_xpath_entry {
+    char *expression;
+    xmlXPathCompExpr *compiled;
+} bt_mbet_xpath_entry;
+
+typedef struct bt_mbet_xpath_cache {
+    // One context for every document, only the node changes
+    xmlXPathContext *context;
+    bt_mbet_xpath_entry entries[BT_MBET_XPATH_CACHE_SIZE];
+    size_t count;
+} bt_mbet_xpath_cache;
+
+static __thread bt_mbet_xpath_cache *XPathCache;
+
+static bt_mbet_xpath_cache *
+bt_mbet_xpath_get_cache(void)
+{
+    if (XPathCache != NULL)
+        return XPathCache;
+    XPathCache = bt_malloc(sizeof(*XPathCache));
+    if (XPathCache == NULL)
+        return NULL;
+    XPathCache->count = 0;
+    XPathCache->context = xmlXPathNewContext(NULL);
+    if (XPathCache->context == NULL) {
+        bt_free(XPathCache);
+        XPathCache = NULL;
+    }
+    return XPathCache;
+}
+
+static xmlXPathCompExpr *
+bt_mbet_xpath_compile(bt_mbet_xpath_cache *const cache,
+                             const xmlChar *const expression, bool *cached)
+{
+    bt_mbet_xpath_entry *entry;
+    xmlXPathCompExpr *compiled;
+    for (size_t idx = 0; idx < cache->count; ++idx) {
+        entry = &cache->entries[idx];
+        if (strcmp(entry->expression, (const char *) expression) != 0)
+            continue;
+        *cached = true;
+        return entry->compiled;
+    }
+    compiled = xmlXPathCompile(expression);
+    *cached = false;
+    if ((compiled == NULL) || (cache->count == BT_MBET_XPATH_CACHE_SIZE))
+        return compiled;
+    // Keep it for the next time
+    entry = &cache->entries[cache->count];
+    entry->expression = bt_strdup((const char *) expression);
+    if (entry->expression == NULL)
+        return compiled;
+    entry->compiled = compiled;
+    cache->count += 1;
+    *cached = true;
+    return compiled;
+}
+
+xmlXPathObject *
+bt_mbet_xpath_eval(xmlNode *node, const xmlChar *const expression)
+{
+    bt_mbet_xpath_cache *cache;
+    xmlXPathCompExpr *compiled;
+    xmlXPathObject *xpath;
+    bool cached;
+    if (node == NULL)
+        return NULL;
+    cache = bt_mbet_xpath_get_cache();
+    if (cache == NULL)
+        return NULL;
+    compiled = bt_mbet_xpath_compile(cache, expression, &cached);
+    if (compiled == NULL)
+        return NULL;
+    // The context belongs to no document until now
+    cache->context->doc = node->doc;
+    xmlXPathSetContextNode(node, cache->context);
+    xpath = xmlXPathCompiledEval(compiled, cache->context);
+    // It didn't fit in the cache
+    if (cached == false)
+        xmlXPathFreeCompExpr(compiled);
+    return xpath;
+}
+
+void
+bt_mbet_xpath_thread_release(void)
+{
+    if (XPathCache == NULL)
+        return;
+    for (size_t idx = 0; idx < XPathCache->count; ++idx) {
+        bt_free(XPathCache->entries[idx].expression);
+        xmlXPathFreeCompExpr(XPathCache->entries[idx].compiled);
+    }
+    xmlXPathFreeContext(XPathCache->context);
+    bt_free(XPathCache);
+    XPathCache = NULL;
+}
 
 char *
 bt_mbet_get_node_conent_string(xmlNode *node, const char *const xpath_expression)
 {
     xmlNodeSet *nodes;
-    xmlXPathContext *context;
     xmlXPathObject *xpath;
     char *result;
     // Just in case
     result = NULL;
-    if (node == NULL)
-        return NULL;
-    // Make a new context for the xpath query
-    context = xmlXPathNewContext(node->doc);
-    if (context == NULL)
-        return NULL;
-    // Set the root node
-    xmlXPathSetContextNode(node, context);
-    // Execute the xpath query
-    xpath = xmlXPathEvalExpression((const xmlChar *) xpath_expression, context);
+    // Execute the xpath query, it's compiled only the first time
+    xpath = bt_mbet_xpath_eval(node, (const xmlChar *) xpath_expression);
     if (xpath == NULL)
-        goto error;
+        return NULL;
     // Make a pointer to the set of matching nodes
     nodes = xpath->nodesetval;
-    if (nodes->nodeNr == 1) {
+    if ((nodes != NULL) && (nodes->nodeNr == 1)) {
         // If exactly one node matched, we got it
         result = (char *) xmlNodeGetContent(nodes->nodeTab[0]);
     }
     // Release resources
     xmlXPathFreeObject(xpath);
-error:
-    xmlXPathFreeContext(context);
+    return result;
+}
+
+const char *
+bt_mbet_get_node_content_arena(xmlNode *node,
+                               const char *const xpath_expression, bt_arena *arena)
+{
+    xmlNodeSet *nodes;
+    xmlXPathObject *xpath;
+    xmlNode *text;
+    xmlChar *content;
+    const char *result;
+    result = NULL;
+    xpath = bt_mbet_xpath_eval(node, (const xmlChar *) xpath_expression);
+    if (xpath == NULL)
+        return NULL;
+    nodes = xpath->nodesetval;
+    if ((nodes == NULL) || (nodes->nodeNr != 1))
+        goto done;
+    // Almost always it's empty or a single text node, copy it from there
+    text = nodes->nodeTab[0]->children;
+    if (text == NULL) {
+        result = bt_arena_strdup(arena, "");
+    } else if ((text->next == NULL) && (text->type == XML_TEXT_NODE)) {
+        result = bt_arena_strdup(arena, (const char *) text->content);
+    } else {
+        content = xmlNodeGetContent(nodes->nodeTab[0]);
+        result = bt_arena_strdup(arena, (const char *) content);
+        xmlFree(content);
+    }
+done:
+    xmlXPathFreeObject(xpath);
     return result;
 }
 
@@ -55,92 +180,183 @@ bt_mbet_get_node_content_integer(xmlNode *node, const char *const xpath_expressi
     return value;
 }
 
-int
-bt_mbet_get_integer_property(xmlNode *node, const char *const name)
+static int
+bt_mbet_integer_from_string(const xmlChar *const property)
 {
     char *endptr;
-    xmlChar *property;
     int value;
-    // Get the property as text
-    property = xmlGetProp(node, (xmlChar *) name);
     if (property == NULL)
         return -1;
     // Convert it to int
     value = (int) strtol((const char *) property, &endptr, 10);
     if (*endptr != '\0')
         value = -1;
-    // Free the temporary property
-    xmlFree(property);
     return value;
 }
 
-long int
-bt_mbet_get_long_property(xmlNode *node, const char *const name)
+static long int
+bt_mbet_long_from_string(const xmlChar *const property)
 {
     char *endptr;
-    xmlChar *property;
     long int value;
-    // Get the property as text
-    property = xmlGetProp(node, (xmlChar *) name);
     if (property == NULL)
         return -1;
     // Convert it to long int
     value = strtol((const char *) property, &endptr, 10);
     if (*endptr != '\0')
         value = -1;
-    // Free the temporary property
-    xmlFree(property);
     return value;
 }
 
-float
-bt_mbet_get_float_property(xmlNode *node, const char *const name)
+static float
+bt_mbet_float_from_string(const xmlChar *const property)
 {
-    xmlChar *property;
     char *endptr;
     float value;
-    // Get the property as text
-    property = xmlGetProp(node, (xmlChar *) name);
     if (property == NULL)
         return strtod("NaN", NULL);
     // Convert it to float
     value = (float) strtod((const char *) property, &endptr);
     if (*endptr != '\0')
         value = strtod("NaN", NULL);
-    // Free the temporary property
-    xmlFree(property);
     return value;
 }
 
-bool
-bt_mbet_get_boolean_property(xmlNode *node, const char *const name)
+static bool
+bt_mbet_boolean_from_string(const xmlChar *const property)
 {
-    xmlChar *property;
-    bool value;
-    // Get the property as text
-    property = xmlGetProp(node, (xmlChar *) name);
     if (property == NULL)
         return false;
     // Check if it's "true" otherwise it's false
-    value = (xmlStrcmp(property, (const xmlChar *) "true") == 0);
-    // Free the temporary property
-    xmlFree(property);
-    return value;
+    return (xmlStrcmp(property, (const xmlChar *) "true") == 0);
 }
 
-void
-bt_mbet_get_date_property(xmlNode *node, const char *const name, struct tm *tm)
+static bool
+bt_mbet_digits_from_string(const xmlChar **text, size_t count, int *value)
 {
-    xmlChar *property;
-    // Get the property as text
-    property = xmlGetProp(node, (xmlChar *) name);
+    const xmlChar *digit;
+    *value = 0;
+    for (digit = *text; count > 0; --count, ++digit) {
+        if ((*digit < '0') || (*digit > '9'))
+            return false;
+        *value = 10 * *value + (*digit - '0');
+    }
+    *text = digit;
+    return true;
+}
+
+static void
+bt_mbet_date_from_string(const xmlChar *const property, struct tm *tm)
+{
+    // `YYYY-MM-DDTHH:MM:SS' and a zone that is ignored, like `strptime()'
+    // with "%FT%T%Z" but it's always this format
+    static const size_t widths[] = {4, 2, 2, 2, 2, 2};
+    static const char separators[] = {'-', '-', 'T', ':', ':', '\0'};
+    // Days before each month, and Sakamoto's table for the week day
+    static const int days[] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+    static const int offsets[] = {0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4};
+    const xmlChar *text;
+    int fields[6];
+    int year;
     if (property == NULL)
         return;
     memset(tm, 0, sizeof(*tm));
-    // Convert it to a tm structure
-    strptime((char *) property, "%FT%T%Z", tm);
-    // Free the temporary property
-    xmlFree(property);
+    text = property;
+    for (size_t idx = 0; idx < countof(fields); ++idx) {
+        if (bt_mbet_digits_from_string(&text, widths[idx], &fields[idx]) == false)
+            return;
+        if ((separators[idx] != '\0') && (*text++ != separators[idx]))
+            return;
+    }
+    if ((fields[1] < 1) || (fields[1] > 12) || (fields[2] < 1) || (fields[2] > 31) ||
+                      (fields[3] > 23) || (fields[4] > 59) || (fields[5] > 61))
+        return;
+    year = fields[0];
+    tm->tm_year = year - 1900;
+    tm->tm_mon = fields[1] - 1;
+    tm->tm_mday = fields[2];
+    tm->tm_hour = fields[3];
+    tm->tm_min = fields[4];
+    tm->tm_sec = fields[5];
+    // These are computed by `strptime()' too
+    tm->tm_yday = days[tm->tm_mon] + tm->tm_mday - 1;
+    if ((tm->tm_mon > 1) && ((year % 4 == 0) && ((year % 100 != 0) || (year % 400 == 0))))
+        tm->tm_yday += 1;
+    if (tm->tm_mon < 2)
+        year -= 1;
+    tm->tm_wday = (year + year / 4 - year / 100 + year / 400 +
+                                      offsets[tm->tm_mon] + tm->tm_mday) % 7;
+}
+
+static const xmlChar *
+bt_mbet_get_property_text(xmlNode *node, const char *const name, xmlChar **copy)
+{
+    xmlAttr *attribute;
+    xmlNode *text;
+    *copy = NULL;
+    attribute = xmlHasProp(node, (const xmlChar *) name);
+    if (attribute == NULL)
+        return NULL;
+    // Almost always it's a single text node, so read it where it is
+    if (attribute->type == XML_ATTRIBUTE_NODE) {
+        text = attribute->children;
+        if (text == NULL)
+            return (const xmlChar *) "";
+        if ((text->next == NULL) && (text->type == XML_TEXT_NODE))
+            return text->content;
+    }
+    // Entities and defaults from the DTD, make the value
+    *copy = xmlGetProp(node, (const xmlChar *) name);
+    return *copy;
+}
+
+int
+bt_mbet_get_integer_property(xmlNode *node, const char *const name)
+{
+    xmlChar *copy;
+    int value;
+    // Get the property as text, usually without copying it
+    value = bt_mbet_integer_from_string(bt_mbet_get_property_text(node, name, &copy));
+    xmlFree(copy);
+    return value;
+}
+
+long int
+bt_mbet_get_long_property(xmlNode *node, const char *const name)
+{
+    xmlChar *copy;
+    long int value;
+    value = bt_mbet_long_from_string(bt_mbet_get_property_text(node, name, &copy));
+    xmlFree(copy);
+    return value;
+}
+
+float
+bt_mbet_get_float_property(xmlNode *node, const char *const name)
+{
+    xmlChar *copy;
+    float value;
+    value = bt_mbet_float_from_string(bt_mbet_get_property_text(node, name, &copy));
+    xmlFree(copy);
+    return value;
+}
+
+bool
+bt_mbet_get_boolean_property(xmlNode *node, const char *const name)
+{
+    xmlChar *copy;
+    bool value;
+    value = bt_mbet_boolean_from_string(bt_mbet_get_property_text(node, name, &copy));
+    xmlFree(copy);
+    return value;
+}
+
+void
+bt_mbet_get_date_property(xmlNode *node, const char *const name, struct tm *tm)
+{
+    xmlChar *copy;
+    bt_mbet_date_from_string(bt_mbet_get_property_text(node, name, &copy), tm);
+    xmlFree(copy);
 }
 
 char *
@@ -149,3 +365,59 @@ bt_mbet_get_string_property(xmlNode *node, const char *const name)
     // Simple wrapper to avoid casting (this could be a macro)
     return (char *) xmlGetProp(node, (xmlChar *) name);
 }
+
+const char *
+bt_mbet_get_arena_property(xmlNode *node, const char *const name, bt_arena *arena)
+{
+    const char *value;
+    xmlChar *copy;
+    value = (const char *) bt_mbet_get_property_text(node, name, &copy);
+    if (value != NULL)
+        value = bt_arena_strdup(arena, value);
+    xmlFree(copy);
+    return value;
+}
+
+static const xmlChar *
+bt_mbet_reader_get_text(xmlTextReader *reader, const char *const name)
+{
+    const xmlChar *value;
+    // The value lives in the reader until it moves, no copy is made
+    if (xmlTextReaderMoveToAttribute(reader, (const xmlChar *) name) != 1)
+        return NULL;
+    value = xmlTextReaderConstValue(reader);
+    xmlTextReaderMoveToElement(reader);
+    return value;
+}
+
+int
+bt_mbet_reader_get_integer(xmlTextReader *reader, const char *const name)
+{
+    // The reader must be on the element
+    return bt_mbet_integer_from_string(bt_mbet_reader_get_text(reader, name));
+}
+
+long int
+bt_mbet_reader_get_long(xmlTextReader *reader, const char *const name)
+{
+    return bt_mbet_long_from_string(bt_mbet_reader_get_text(reader, name));
+}
+
+float
+bt_mbet_reader_get_float(xmlTextReader *reader, const char *const name)
+{
+    return bt_mbet_float_from_string(bt_mbet_reader_get_text(reader, name));
+}
+
+void
+bt_mbet_reader_get_date(xmlTextReader *reader, const char *const name, struct tm *tm)
+{
+    bt_mbet_date_from_string(bt_mbet_reader_get_text(reader, name), tm);
+}
+
+const char *
+bt_mbet_reader_get_arena_property(xmlTextReader *reader,
+                                       const char *const name, bt_arena *arena)
+{
+    return bt_arena_strdup(arena, (const char *) bt_mbet_reader_get_text(reader, name));
+}
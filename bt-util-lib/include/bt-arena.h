@@ -0,0 +1,63 @@
+#ifndef __BT_ARENA_H__
+#define __BT_ARENA_H__
+
+/** @file
+ *
+ * Arena para objetos temporales: alojar sólo avanza un apuntador, y todo
+ * se libera de una vez con `bt_arena_reset()`. Los bloques no se devuelven
+ * al sistema al reiniciar, así que tras unos pocos usos no se vuelve a
+ * llamar a `bt_malloc()`.
+ */
+
+#include <stdlib.h>
+
+typedef struct bt_arena bt_arena;
+
+/**
+ * @brief Crear una arena vacía
+ * @return La arena recién alojada que debe ser pasada a `bt_arena_free()`
+ */
+bt_arena *bt_arena_new(void);
+/**
+ * @brief Liberar una arena y todo lo que se alojó en ella
+ * @param arena La arena para liberar
+ */
+void bt_arena_free(bt_arena *arena);
+/**
+ * @brief Alojar memoria en la arena, alineada para cualquier tipo
+ * @param arena La arena de interés
+ * @param size El número de bytes
+ * @return La memoria, que no debe pasarse a `bt_free()`, o `NULL`
+ */
+void *bt_arena_alloc(bt_arena *const arena, size_t size);
+/**
+ * @brief Copiar una cadena a la arena
+ * @param arena La arena de interés
+ * @param string La cadena, puede ser `NULL`
+ * @return La copia, o `NULL`
+ */
+char *bt_arena_strdup(bt_arena *const arena, const char *const string);
+/**
+ * @brief Construir una cadena con el formato de `printf()` en la arena
+ * @param arena La arena de interés
+ * @param format La cadena de formato
+ * @return La cadena, o `NULL`
+ */
+char *bt_arena_printf(bt_arena *const arena, const char *const format, ...) __attribute__((format(printf, 2, 3)));
+/**
+ * @brief Olvidar todo lo alojado, la memoria se reutiliza
+ * @param arena La arena de interés
+ */
+void bt_arena_reset(bt_arena *const arena);
+/**
+ * @brief La arena del hilo actual, se crea la primera vez. El hilo que la
+ * usa es responsable de reiniciarla, normalmente después de cada frame
+ * @return La arena o `NULL` si no se pudo crear
+ */
+bt_arena *bt_arena_thread(void);
+/**
+ * @brief Liberar la arena del hilo actual, antes de que el hilo termine
+ */
+void bt_arena_thread_release(void);
+
+#endif // __BT_ARENA_H__
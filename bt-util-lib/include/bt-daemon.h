@@ -4,6 +4,8 @@
 typedef struct bt_context bt_context;
 int bt_start_daemon(bt_context *const context);
 void bt_stop_daemon(void);
+void bt_query_daemon_latency(void);
+void bt_query_daemon_schedule(void);
 int bt_is_daemon_running(void);
 
 #endif // __BETENIS_COMMAND_HANDLER_H__
@@ -23,6 +23,11 @@ void bt_database_transaction_run(bt_mysql_transaction *transaction);
  * @brief Crear conexión a la base de datos
  */
 void bt_database_initialize(void);
+/**
+ * @brief No volver a conectarse a la base de datos, todas las consultas
+ * fallan desde las conexiones creadas después de llamar a esta función
+ */
+void bt_database_disable(void);
 /**
  * @brief Liberar memoria usada por la conexión a la base de datos
  */
@@ -6,6 +6,13 @@
 void *bt_malloc(size_t size);
 void *bt_calloc(size_t nmemb, size_t size);
 void *bt_realloc(void *ptr, size_t size);
+void *bt_aligned_malloc(size_t alignment, size_t size);
 void bt_free(void *ptr);
+/**
+ * @brief Obtener cuántas veces ha alojado (o realojado) memoria el hilo
+ * actual a través de estas funciones
+ * @return El número de llamadas desde que empezó el hilo
+ */
+size_t bt_memory_thread_allocations(void);
 
 #endif // __BT_MEMORY_H__
@@ -0,0 +1,49 @@
+#ifndef __BT_SLAB_H__
+#define __BT_SLAB_H__
+
+/** @file
+ *
+ * Reserva de objetos del mismo tamaño. Los objetos se toman de páginas
+ * contiguas y los liberados se guardan en una lista para reutilizarlos, así
+ * alojar y liberar es O(1) y la memoria no se fragmenta. Las páginas sólo
+ * se devuelven al sistema con `bt_slab_free()`. Se puede usar desde varios
+ * hilos a la vez.
+ */
+
+#include <stdlib.h>
+
+typedef struct bt_slab bt_slab;
+
+/**
+ * @brief Crear una reserva de objetos
+ * @param size El tamaño de cada objeto, normalmente `sizeof(tipo)`
+ * @param alignment La alineación de los objetos, una potencia de 2
+ * @return La reserva recién alojada que debe ser pasada a `bt_slab_free()`
+ */
+bt_slab *bt_slab_new(size_t size, size_t alignment);
+/**
+ * @brief Liberar la reserva y todas sus páginas, incluso los objetos que
+ * no se hayan devuelto
+ * @param slab La reserva para liberar
+ */
+void bt_slab_free(bt_slab *slab);
+/**
+ * @brief Tomar un objeto, su contenido no está inicializado
+ * @param slab La reserva de interés
+ * @return El objeto, que se devuelve con `bt_slab_release()`, o `NULL`
+ */
+void *bt_slab_alloc(bt_slab *const slab);
+/**
+ * @brief Devolver un objeto a la reserva de la que salió
+ * @param slab La reserva de interés
+ * @param object El objeto, puede ser `NULL`
+ */
+void bt_slab_release(bt_slab *const slab, void *object);
+/**
+ * @brief Obtener cuántos objetos están en uso
+ * @param slab La reserva de interés
+ * @return El número de objetos tomados y no devueltos
+ */
+size_t bt_slab_get_count(bt_slab *const slab);
+
+#endif // __BT_SLAB_H__
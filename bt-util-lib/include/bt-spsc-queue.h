@@ -0,0 +1,47 @@
+#ifndef __BT_SPSC_QUEUE_H__
+#define __BT_SPSC_QUEUE_H__
+
+/** @file
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+typedef struct bt_spsc_queue bt_spsc_queue;
+/**
+ * @brief Crear una cola acotada, sin bloqueos, para un único productor y un
+ * único consumidor
+ * @param capacity El número máximo de elementos, se redondea a la siguiente
+ * potencia de 2
+ * @return La cola recién alojada que debe ser pasada a `bt_spsc_queue_free()`
+ */
+bt_spsc_queue *bt_spsc_queue_new(size_t capacity);
+/**
+ * @brief Liberar una cola. Los elementos que queden en ella no se liberan
+ * @param queue La cola para liberar
+ */
+void bt_spsc_queue_free(bt_spsc_queue *queue);
+/**
+ * @brief Agregar un elemento al final de la cola, sólo el hilo productor
+ * puede llamar esta función
+ * @param queue La cola objetivo
+ * @param item El elemento, no puede ser `NULL`
+ * @return `false` si la cola está llena
+ */
+bool bt_spsc_queue_push(bt_spsc_queue *const queue, void *item);
+/**
+ * @brief Quitar el primer elemento de la cola, sólo el hilo consumidor
+ * puede llamar esta función
+ * @param queue La cola objetivo
+ * @return El elemento o `NULL` si la cola está vacía
+ */
+void *bt_spsc_queue_pop(bt_spsc_queue *const queue);
+/**
+ * @brief Obtener el número de elementos en la cola. Desde otro hilo el
+ * valor es sólo aproximado
+ * @param queue La cola objetivo
+ * @return El número de elementos
+ */
+size_t bt_spsc_queue_get_count(const bt_spsc_queue *const queue);
+
+#endif // __BT_SPSC_QUEUE_H__
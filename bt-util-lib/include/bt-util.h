@@ -134,8 +134,9 @@ void bt_mysql_parameters_append(MYSQL_BIND *bind, size_t index, int type, void *
  * @brief Ejecutar una transacción previamente almacenada
  * @param transaction El objeto con toda la información necesaria
  * ejecutar la transacción
+ * @return `0` si todas las operaciones se ejecutaron, `-1` si alguna falló
  */
-void bt_mysql_transaction_execute(bt_mysql_transaction *transaction);
+int bt_mysql_transaction_execute(bt_mysql_transaction *transaction);
 /**
  * @brief Crear una nueva transacción con `n` operaciones
  * @param n El número de transacciones
@@ -222,6 +223,34 @@ char *bt_load_query(const char *const name, ...) __attribute__((sentinel));
  * @return
  */
 char *bt_http_get(const char *const url, bool tor, bt_http *http, const bt_http_headers *const headers);
+/**
+ * @brief El resultado de `bt_http_get_cached()`
+ */
+enum bt_http_result {
+    HttpFailed, /**< La solicitud falló */
+    HttpOk, /**< Llegó el documento, y es diferente al anterior */
+    HttpNotModified /**< El documento no ha cambiado desde la última vez */
+};
+/**
+ * @brief Como `bt_http_get()`, pero recuerda el `ETag`, el `Last-Modified`
+ * y un resumen del documento que se obtuvo con el mismo url, y los usa para
+ * no descargar ni entregar otra vez uno que no ha cambiado. Sólo tiene
+ * sentido para urls que se consultan repetidamente.
+ * @param url Url al que realizar la solicitud
+ * @param tor Si usar <a href="https://www.torproject.org/">Tor</a>
+ * @param http Una conexión existente o `NULL`
+ * @param headers Cabeceras adicionales o `NULL`
+ * @param status Donde se almacena el resultado
+ * @return El documento si `status` es `HttpOk`, si no `NULL`
+ */
+char *bt_http_get_cached(const char *const url, bool tor, bt_http *http, const bt_http_headers *const headers, enum bt_http_result *status);
+/**
+ * @brief Olvidar lo que se recuerda de un url, la siguiente llamada a
+ * `bt_http_get_cached()` entrega el documento aunque no haya cambiado. Se
+ * usa cuando no se pudo procesar el último que se entregó
+ * @param url El url de interés
+ */
+void bt_http_cache_invalidate(const char *const url);
 /**
  * @brief Conectarse a un servidor HTTP
  * @param url El url del servidor
@@ -0,0 +1,169 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <bt-arena.h>
+#include <bt-memory.h>
+
+#define BT_ARENA_CHUNK_SIZE 0x00001000
+#define BT_ARENA_ALIGNMENT (sizeof(bt_arena_align))
+
+// The strictest alignment of the basic types, `max_align_t' is not C99
+typedef union bt_arena_align {
+    long long integer;
+    long double real;
+    void *pointer;
+} bt_arena_align;
+
+typedef struct bt_arena_chunk bt_arena_chunk;
+struct bt_arena_chunk {
+    bt_arena_chunk *next;
+    size_t size;
+    size_t used;
+    bt_arena_align data[];
+};
+
+struct bt_arena {
+    // All the chunks ever allocated, they are reused after a reset
+    bt_arena_chunk *head;
+    bt_arena_chunk *current;
+};
+
+static __thread bt_arena *ThreadArena;
+
+bt_arena *
+bt_arena_new(void)
+{
+    bt_arena *arena;
+    arena = bt_malloc(sizeof(*arena));
+    if (arena == NULL)
+        return NULL;
+    arena->head = NULL;
+    arena->current = NULL;
+    return arena;
+}
+
+void
+bt_arena_free(bt_arena *arena)
+{
+    bt_arena_chunk *chunk;
+    if (arena == NULL)
+        return;
+    chunk = arena->head;
+    while (chunk != NULL) {
+        bt_arena_chunk *next;
+        next = chunk->next;
+        bt_free(chunk);
+        chunk = next;
+    }
+    bt_free(arena);
+}
+
+static bt_arena_chunk *
+bt_arena_chunk_new(size_t size)
+{
+    bt_arena_chunk *chunk;
+    if (size < BT_ARENA_CHUNK_SIZE)
+        size = BT_ARENA_CHUNK_SIZE;
+    chunk = bt_malloc(sizeof(*chunk) + size);
+    if (chunk == NULL)
+        return NULL;
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+void *
+bt_arena_alloc(bt_arena *const arena, size_t size)
+{
+    bt_arena_chunk *chunk;
+    bt_arena_chunk *previous;
+    void *pointer;
+    // Keep every allocation aligned
+    size = (size + BT_ARENA_ALIGNMENT - 1) & ~(BT_ARENA_ALIGNMENT - 1);
+    // Find a chunk with enough room, starting with the current one. The
+    // ones before it were filled since the last reset
+    previous = NULL;
+    for (chunk = arena->current; chunk != NULL; chunk = chunk->next) {
+        if (chunk->size - chunk->used >= size)
+            break;
+        previous = chunk;
+    }
+    if (chunk == NULL) {
+        // None, so make a new one at the end of the list
+        chunk = bt_arena_chunk_new(size);
+        if (chunk == NULL)
+            return NULL;
+        if (previous != NULL)
+            previous->next = chunk;
+        else
+            arena->head = chunk;
+    }
+    arena->current = chunk;
+    pointer = (char *) chunk->data + chunk->used;
+    chunk->used += size;
+    return pointer;
+}
+
+char *
+bt_arena_strdup(bt_arena *const arena, const char *const string)
+{
+    char *copy;
+    size_t length;
+    if (string == NULL)
+        return NULL;
+    length = strlen(string);
+    copy = bt_arena_alloc(arena, length + 1);
+    if (copy == NULL)
+        return NULL;
+    return memcpy(copy, string, length + 1);
+}
+
+char *
+bt_arena_printf(bt_arena *const arena, const char *const format, ...)
+{
+    va_list args;
+    char *string;
+    int length;
+    // Find out how long it is first
+    va_start(args, format);
+    length = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (length < 0)
+        return NULL;
+    string = bt_arena_alloc(arena, length + 1);
+    if (string == NULL)
+        return NULL;
+    va_start(args, format);
+    vsnprintf(string, length + 1, format, args);
+    va_end(args);
+    return string;
+}
+
+void
+bt_arena_reset(bt_arena *const arena)
+{
+    // Only the chunks up to the current one were used
+    for (bt_arena_chunk *chunk = arena->head; chunk != NULL; chunk = chunk->next) {
+        chunk->used = 0;
+        if (chunk == arena->current)
+            break;
+    }
+    arena->current = arena->head;
+}
+
+bt_arena *
+bt_arena_thread(void)
+{
+    if (ThreadArena == NULL)
+        ThreadArena = bt_arena_new();
+    return ThreadArena;
+}
+
+void
+bt_arena_thread_release(void)
+{
+    bt_arena_free(ThreadArena);
+    ThreadArena = NULL;
+}
@@ -12,14 +12,60 @@
 
 #include <signal.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <errno.h>
 
 #include <bt-private.h>
+#include <bt-latency.h>
+#include <bt-william-hill-schedule.h>
+#include <bt-memory.h>
 #include <bt-debug.h>
 
 #define SOCKET_PATH "/tmp/betenisd.sock"
 
+static void
+bt_daemon_write_all(int peer, const char *data, size_t length)
+{
+    while (length > 0) {
+        ssize_t count;
+        count = write(peer, data, length);
+        if (count <= 0)
+            return;
+        data += count;
+        length -= count;
+    }
+}
+
+static void
+bt_daemon_send_latency(int peer)
+{
+    char *report;
+    report = bt_latency_report();
+    if (report == NULL)
+        return;
+    bt_daemon_write_all(peer, report, strlen(report));
+    bt_free(report);
+}
+
+static void
+bt_daemon_send_schedule(int peer)
+{
+    char report[100];
+    unsigned int interval;
+    int length;
+    interval = bt_william_hill_schedule_get_interval();
+    if (interval == 0) {
+        length = snprintf(report, sizeof(report),
+                                  "William Hill events not checked yet\n");
+    } else {
+        length = snprintf(report, sizeof(report),
+                       "William Hill events checked every %u s\n", interval);
+    }
+    if ((length > 0) && ((size_t) length < sizeof(report)))
+        bt_daemon_write_all(peer, report, length);
+}
+
 void
 bt_daemon_start(int sock, bt_context *const context)
 {
@@ -31,6 +77,12 @@ bt_daemon_start(int sock, bt_context *const context)
         // Read the message
         if ((count = read(peer, buffer, sizeof(buffer) - 1)) <= 0)
             continue;
+        // Latency report request, answered before closing
+        if ((count == 7) && (memcmp(buffer, "latency", 7) == 0))
+            bt_daemon_send_latency(peer);
+        // Polling interval request, also answered before closing
+        if ((count == 8) && (memcmp(buffer, "schedule", 8) == 0))
+            bt_daemon_send_schedule(peer);
         // Shutdown request
         shutdown(peer, SHUT_RDWR);
         // Close the peer socket
@@ -99,6 +151,44 @@ bt_stop_daemon(void)
     close(daemon);
 }
 
+static void
+bt_query_daemon(const char *const command)
+{
+    int daemon;
+    char buffer[512];
+    ssize_t count;
+    size_t length;
+    daemon = bt_daemon_connect();
+    if (daemon == -1) {
+        log("can't find the daemon, sorry\n");
+        return;
+    }
+    length = strlen(command);
+    if (write(daemon, command, length) != (ssize_t) length) {
+        log("can't ask the daemon for the %s!\n", command);
+        close(daemon);
+        return;
+    }
+    // It closes the connection after the report
+    while ((count = read(daemon, buffer, sizeof(buffer))) > 0)
+        fwrite(buffer, 1, count, stdout);
+    // The caller might `_exit()`
+    fflush(stdout);
+    close(daemon);
+}
+
+void
+bt_query_daemon_latency(void)
+{
+    bt_query_daemon("latency");
+}
+
+void
+bt_query_daemon_schedule(void)
+{
+    bt_query_daemon("schedule");
+}
+
 int
 bt_start_daemon(bt_context *const context)
 {
@@ -22,6 +22,8 @@
 
 __thread MYSQL *mysql_global = NULL;
 pthread_mutex_t mysql_mutex;
+// Set to replay captures without touching the database
+static bool Disabled;
 
 #ifndef SYSCONFDIR
 #define SYSCONFDIR "/etc"
@@ -132,6 +134,9 @@ bt_connect_to_mysql()
     char *host;
 
     mysql = NULL;
+    // Every query fails as if the server was down
+    if (__atomic_load_n(&Disabled, __ATOMIC_ACQUIRE) == true)
+        return NULL;
     // Read the settings file
     if (bt_parse_settings_file(&user, &password, &dbname, &host) == true) {
         pthread_mutex_lock(&mysql_mutex);
@@ -147,6 +152,12 @@ bt_connect_to_mysql()
     return mysql;
 }
 
+void
+bt_database_disable(void)
+{
+    __atomic_store_n(&Disabled, true, __ATOMIC_RELEASE);
+}
+
 void
 bt_database_initialize(void)
 {
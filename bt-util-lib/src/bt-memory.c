@@ -5,18 +5,34 @@
 
 #include <bt-memory.h>
 
+// Each thread counts it's own, so there is no contention
+static __thread size_t ThreadAllocations;
+
 void *
 bt_malloc(size_t size)
 {
+    ThreadAllocations += 1;
     return malloc(size);
 }
 
 void *
 bt_calloc(size_t nmemb, size_t size)
 {
+    ThreadAllocations += 1;
     return calloc(nmemb, size);
 }
 
+void *
+bt_aligned_malloc(size_t alignment, size_t size)
+{
+    void *ptr;
+    ThreadAllocations += 1;
+    // It's released with `bt_free()` like everything else
+    if (posix_memalign(&ptr, alignment, size) != 0)
+        return NULL;
+    return ptr;
+}
+
 void
 bt_free(void *ptr)
 {
@@ -26,5 +42,12 @@ bt_free(void *ptr)
 void *
 bt_realloc(void *ptr, size_t size)
 {
+    ThreadAllocations += 1;
     return realloc(ptr, size);
 }
+
+size_t
+bt_memory_thread_allocations(void)
+{
+    return ThreadAllocations;
+}
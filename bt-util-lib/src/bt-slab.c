@@ -0,0 +1,142 @@
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include <pthread.h>
+
+#include <bt-slab.h>
+#include <bt-memory.h>
+
+// The size of each page, objects larger than this get a page each
+#define BT_SLAB_PAGE_SIZE 0x00004000
+
+// A free object holds the pointer to the next free one
+typedef struct bt_slab_object bt_slab_object;
+struct bt_slab_object {
+    bt_slab_object *next;
+};
+
+struct bt_slab {
+    pthread_mutex_t mutex;
+    size_t size;
+    size_t alignment;
+    size_t count;
+    bt_slab_object *available;
+    // Every page ever allocated, to release them at the end
+    void **pages;
+    size_t npages;
+    size_t pagessize;
+    // Objects taken and not released yet
+    size_t used;
+};
+
+bt_slab *
+bt_slab_new(size_t size, size_t alignment)
+{
+    bt_slab *slab;
+    // Free objects store a pointer, so they need room and alignment for it
+    if (alignment < sizeof(bt_slab_object))
+        alignment = sizeof(bt_slab_object);
+    if (size < sizeof(bt_slab_object))
+        size = sizeof(bt_slab_object);
+    slab = bt_malloc(sizeof(*slab));
+    if (slab == NULL)
+        return NULL;
+    // Consecutive objects must all be aligned
+    slab->size = (size + alignment - 1) & ~(alignment - 1);
+    slab->alignment = alignment;
+    slab->count = BT_SLAB_PAGE_SIZE / slab->size;
+    if (slab->count == 0)
+        slab->count = 1;
+    slab->available = NULL;
+    slab->pages = NULL;
+    slab->npages = 0;
+    slab->pagessize = 0;
+    slab->used = 0;
+    pthread_mutex_init(&slab->mutex, NULL);
+    return slab;
+}
+
+void
+bt_slab_free(bt_slab *slab)
+{
+    if (slab == NULL)
+        return;
+    for (size_t idx = 0; idx < slab->npages; ++idx)
+        bt_free(slab->pages[idx]);
+    bt_free(slab->pages);
+    pthread_mutex_destroy(&slab->mutex);
+    bt_free(slab);
+}
+
+static bool
+bt_slab_grow(bt_slab *const slab)
+{
+    char *page;
+    // Make room to remember the page first
+    if (slab->npages == slab->pagessize) {
+        void **pages;
+        size_t size;
+        size = (slab->pagessize == 0) ? 16 : 2 * slab->pagessize;
+        pages = bt_realloc(slab->pages, size * sizeof(*pages));
+        if (pages == NULL)
+            return false;
+        slab->pages = pages;
+        slab->pagessize = size;
+    }
+    page = bt_aligned_malloc(slab->alignment, slab->count * slab->size);
+    if (page == NULL)
+        return false;
+    slab->pages[slab->npages++] = page;
+    // Link the objects in address order, so they are handed out in
+    // that order too
+    for (size_t idx = slab->count; idx-- > 0; ) {
+        bt_slab_object *object;
+        object = (bt_slab_object *) (page + idx * slab->size);
+        object->next = slab->available;
+        slab->available = object;
+    }
+    return true;
+}
+
+void *
+bt_slab_alloc(bt_slab *const slab)
+{
+    bt_slab_object *object;
+    if (slab == NULL)
+        return NULL;
+    pthread_mutex_lock(&slab->mutex);
+    if ((slab->available == NULL) && (bt_slab_grow(slab) == false)) {
+        pthread_mutex_unlock(&slab->mutex);
+        return NULL;
+    }
+    object = slab->available;
+    slab->available = object->next;
+    slab->used += 1;
+    pthread_mutex_unlock(&slab->mutex);
+    return object;
+}
+
+void
+bt_slab_release(bt_slab *const slab, void *object)
+{
+    bt_slab_object *item;
+    if ((slab == NULL) || (object == NULL))
+        return;
+    item = object;
+    pthread_mutex_lock(&slab->mutex);
+    // The most recently released is reused first, it's probably cached
+    item->next = slab->available;
+    slab->available = item;
+    slab->used -= 1;
+    pthread_mutex_unlock(&slab->mutex);
+}
+
+size_t
+bt_slab_get_count(bt_slab *const slab)
+{
+    size_t count;
+    pthread_mutex_lock(&slab->mutex);
+    count = slab->used;
+    pthread_mutex_unlock(&slab->mutex);
+    return count;
+}
@@ -0,0 +1,96 @@
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include <bt-spsc-queue.h>
+#include <bt-memory.h>
+
+#define BT_CACHE_LINE 64
+
+// `head` is written only by the consumer and `tail` only by the producer,
+// they are kept in different cache lines so the two threads don't keep
+// stealing the line from each other.
+typedef struct bt_spsc_queue {
+    void **items;
+    size_t mask;
+    char padding0[BT_CACHE_LINE - sizeof(void **) - sizeof(size_t)];
+    size_t head;
+    char padding1[BT_CACHE_LINE - sizeof(size_t)];
+    size_t tail;
+    char padding2[BT_CACHE_LINE - sizeof(size_t)];
+} bt_spsc_queue;
+
+bt_spsc_queue *
+bt_spsc_queue_new(size_t capacity)
+{
+    bt_spsc_queue *queue;
+    size_t size;
+    // Round the capacity to a power of 2, so the indexes wrap with a mask
+    for (size = 1; size < capacity; size *= 2)
+        ;
+    queue = bt_malloc(sizeof(*queue));
+    if (queue == NULL)
+        return NULL;
+    queue->items = bt_calloc(size, sizeof(*queue->items));
+    if (queue->items == NULL) {
+        bt_free(queue);
+        return NULL;
+    }
+    queue->mask = size - 1;
+    queue->head = 0;
+    queue->tail = 0;
+    return queue;
+}
+
+void
+bt_spsc_queue_free(bt_spsc_queue *queue)
+{
+    if (queue == NULL)
+        return;
+    bt_free(queue->items);
+    bt_free(queue);
+}
+
+bool
+bt_spsc_queue_push(bt_spsc_queue *const queue, void *item)
+{
+    size_t head;
+    size_t tail;
+    // Only this thread writes `tail`
+    tail = queue->tail;
+    // Acquire, so the slot is not reused before the consumer read it
+    head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    if (tail - head > queue->mask)
+        return false;
+    queue->items[tail & queue->mask] = item;
+    // Release, so the item is visible before the new `tail`
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+void *
+bt_spsc_queue_pop(bt_spsc_queue *const queue)
+{
+    size_t head;
+    size_t tail;
+    void *item;
+    // Only this thread writes `head`
+    head = queue->head;
+    // Acquire, pairs with the release in `bt_spsc_queue_push()`
+    tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    if (head == tail)
+        return NULL;
+    item = queue->items[head & queue->mask];
+    // Release, the producer can reuse the slot after this
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+    return item;
+}
+
+size_t
+bt_spsc_queue_get_count(const bt_spsc_queue *const queue)
+{
+    size_t head;
+    size_t tail;
+    tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    return tail - head;
+}
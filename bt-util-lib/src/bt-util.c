@@ -427,7 +427,7 @@ bt_mysql_operation_replace_values(bt_mysql_operation *operation)
     return length;
 }
 
-static void
+static int
 bt_mysql_transaction_run_operation(bt_mysql_operation *operation)
 {
     int status;
@@ -436,14 +436,18 @@ bt_mysql_transaction_run_operation(bt_mysql_operation *operation)
     // Store the status of the operation, so we can track it
     status = 0;
     // Check for sanity, avoid SIGSEV or Undefined Behavior in general
-    if ((operation == NULL) || (operation->query == NULL) || (operation->bind == NULL))
-        return;
+    if ((operation == NULL) || (operation->query == NULL))
+        return -1;
+    // Nothing was put in this operation, there is nothing to do
+    if (operation->bind == NULL)
+        return 0;
     // Create an statement
     stmt = bt_database_new_stmt();
     if (stmt == NULL)
-        return;
+        return -1;
     // Replace the values with the parameters, and store
     // the resulting query length
+    status = -1;
     length = bt_mysql_operation_replace_values(operation);
     if (length == 0)
         goto error;
@@ -455,22 +459,32 @@ bt_mysql_transaction_run_operation(bt_mysql_operation *operation)
         goto error;
     // Finally execute it
     status = mysql_stmt_execute(stmt);
+    // A duplicate key is expected and it's not an error
+    if ((status != 0) && (mysql_stmt_errno(stmt) == 1062))
+        status = 0;
 error:
     // On error, check the mysql_error and display it
     bt_debug_mysql(__FILE__, __FUNCTION__, __LINE__, status, stmt);
     // Now we can release resources
     mysql_stmt_close(stmt);
+    return (status == 0) ? 0 : -1;
 }
 
-void
+int
 bt_mysql_transaction_execute(bt_mysql_transaction *transaction)
 {
+    int result;
     // Check for INsanity
     if (transaction == NULL)
-        return;
-    // Iterate through all the operations executing 1 by 1
-    for (size_t idx = 0; idx < transaction->count; ++idx)
-        bt_mysql_transaction_run_operation(&transaction->operations[idx]);
+        return -1;
+    result = 0;
+    // Iterate through all the operations executing 1 by 1, a
+    // failure doesn't stop the rest but it's reported
+    for (size_t idx = 0; idx < transaction->count; ++idx) {
+        if (bt_mysql_transaction_run_operation(&transaction->operations[idx]) != 0)
+            result = -1;
+    }
+    return result;
 }
 
 static void
@@ -837,19 +851,149 @@ bt_strdup(const char *const string)
     return result;
 }
 
+// What the server told us about a document the last time, to ask for it
+// again only if it changed
+typedef struct bt_http_cache_entry {
+    struct bt_http_cache_entry *next;
+    char *url;
+    char *etag;
+    char *modified;
+    uint64_t digest;
+    bool valid;
+} bt_http_cache_entry;
+
+// Only a few documents are polled, a list is enough
+static bt_http_cache_entry *bt_http_cache;
+static pthread_mutex_t bt_http_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t
+bt_http_digest(const char *data, size_t length)
+{
+    uint64_t hash;
+    // Eight bytes at a time, with a multiply and shift to mix them
+    hash = 0x9e3779b97f4a7c15ULL ^ length;
+    for (; length >= sizeof(uint64_t); length -= sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 32;
+        data += sizeof(word);
+    }
+    while (length-- > 0)
+        hash = (hash ^ (unsigned char) *data++) * 0x100000001b3ULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static void
+bt_http_cache_replace(char **target, const char *const value)
+{
+    // Servers don't always send the validators, drop the old ones then
+    bt_free(*target);
+    *target = (value != NULL) ? bt_strdup(value) : NULL;
+}
+
+static void
+bt_http_cache_get(const char *const url, bt_http_cache_entry *const copy)
+{
+    bt_http_cache_entry *entry;
+    copy->etag = NULL;
+    copy->modified = NULL;
+    copy->digest = 0;
+    copy->valid = false;
+    pthread_mutex_lock(&bt_http_cache_mutex);
+    for (entry = bt_http_cache; entry != NULL; entry = entry->next) {
+        if (strcmp(entry->url, url) != 0)
+            continue;
+        // Copy it, the lock is not held during the request
+        bt_http_cache_replace(&copy->etag, entry->etag);
+        bt_http_cache_replace(&copy->modified, entry->modified);
+        copy->digest = entry->digest;
+        copy->valid = entry->valid;
+        break;
+    }
+    pthread_mutex_unlock(&bt_http_cache_mutex);
+}
+
+static void
+bt_http_cache_put(const char *const url, const bt_http_cache_entry *const copy)
+{
+    bt_http_cache_entry *entry;
+    pthread_mutex_lock(&bt_http_cache_mutex);
+    for (entry = bt_http_cache; entry != NULL; entry = entry->next) {
+        if (strcmp(entry->url, url) == 0)
+            break;
+    }
+    if (entry == NULL) {
+        entry = bt_malloc(sizeof(*entry));
+        if (entry == NULL)
+            goto finish;
+        entry->url = bt_strdup(url);
+        if (entry->url == NULL) {
+            bt_free(entry);
+            goto finish;
+        }
+        entry->etag = NULL;
+        entry->modified = NULL;
+        entry->next = bt_http_cache;
+        bt_http_cache = entry;
+    }
+    bt_http_cache_replace(&entry->etag, copy->etag);
+    bt_http_cache_replace(&entry->modified, copy->modified);
+    entry->digest = copy->digest;
+    entry->valid = copy->valid;
+finish:
+    pthread_mutex_unlock(&bt_http_cache_mutex);
+}
+
+void
+bt_http_cache_invalidate(const char *const url)
+{
+    bt_http_cache_entry *entry;
+    pthread_mutex_lock(&bt_http_cache_mutex);
+    for (entry = bt_http_cache; entry != NULL; entry = entry->next) {
+        if (strcmp(entry->url, url) != 0)
+            continue;
+        // Without validators nor digest the next response is delivered
+        bt_http_cache_replace(&entry->etag, NULL);
+        bt_http_cache_replace(&entry->modified, NULL);
+        entry->valid = false;
+        break;
+    }
+    pthread_mutex_unlock(&bt_http_cache_mutex);
+}
+
+static void
+bt_http_cache_entry_finalize(bt_http_cache_entry *const entry)
+{
+    bt_free(entry->etag);
+    bt_free(entry->modified);
+}
+
 static char *
-bt_http_get_copy_response_HTTP_IO(struct httpio *link)
+bt_http_get_copy_response_HTTP_IO(struct httpio *link,
+                  bt_http_cache_entry *const cache, enum bt_http_result *status)
 {
     struct httpio_response *resp;
     struct httpio_body *body;
     char *result;
+    int code;
+    *status = HttpFailed;
     // Read the response from the httpio object
     resp = httpio_read_response(link);
     if (resp == NULL)
         return NULL;
+    code = httpio_response_get_code(resp);
+    // We have the same copy the server has
+    if ((code == 304) && (cache != NULL) && (cache->valid == true)) {
+        *status = HttpNotModified;
+        goto error;
+    }
     // Check the response code
     // TODO: We could implement redirection here
-    if (httpio_response_get_code(resp) != 200)
+    if (code != 200)
         goto error;
     // Make the result valid so if the data is never copied
     // it has a sensible value
@@ -865,6 +1009,26 @@ bt_http_get_copy_response_HTTP_IO(struct httpio *link)
         //        is guaranteed by this API.
         result = (char *) httpio_response_body_take_data(body);
     }
+    if ((cache != NULL) && (result != NULL)) {
+        const httpio_header_list *headers;
+        uint64_t digest;
+        // Not every server supports conditional requests, so compare
+        // the body with the previous one too
+        digest = bt_http_digest(result, strlen(result));
+        if ((cache->valid == true) && (cache->digest == digest)) {
+            *status = HttpNotModified;
+            bt_free(result);
+            goto error;
+        }
+        headers = httpio_response_get_headers(resp);
+        bt_http_cache_replace(&cache->etag, httpio_header_list_get(headers, "etag"));
+        bt_http_cache_replace(&cache->modified,
+                                 httpio_header_list_get(headers, "last-modified"));
+        cache->digest = digest;
+        cache->valid = true;
+    }
+    if (result != NULL)
+        *status = HttpOk;
     // Free the response object
     httpio_response_free(resp);
     // Return the result (possibly NULL)
@@ -975,15 +1139,17 @@ bt_http_disconnect(bt_http *http)
     bt_free(http);
 }
 
-char *
-bt_http_get(const char *const uri, bool tor, bt_http *ctx,
-                             const bt_http_headers *const custom_headers)
+static char *
+bt_http_request(const char *const uri, bool tor, bt_http *ctx,
+                         const bt_http_headers *const custom_headers,
+                  bt_http_cache_entry *const cache, enum bt_http_result *status)
 {
     bt_http_url url;
     bt_http_headers *headers;
     char *result;
     // Ensure no garbage is returned
     result = NULL;
+    *status = HttpFailed;
     if (bt_http_parse_url(uri, &url) == -1)
         return NULL;
     headers = bt_http_headers_new();
@@ -1003,6 +1169,15 @@ bt_http_get(const char *const uri, bool tor, bt_http *ctx,
         goto error;
     if (bt_http_headers_append(headers, "User-Agent", BT_USER_AGENT, false) == -1)
         goto error;
+    // Ask for the document only if it changed since we got it
+    if ((cache != NULL) && (cache->valid == true)) {
+        if ((cache->etag != NULL) &&
+             (bt_http_headers_append(headers, "If-None-Match", cache->etag, true) == -1))
+            goto error;
+        if ((cache->modified != NULL) &&
+          (bt_http_headers_append(headers, "If-Modified-Since", cache->modified, true) == -1))
+            goto error;
+    }
     // Check if there is a pre allocated HTTP object
     // and use it. If there isn't one, we allocate
     // one and mark it as own, so we can deallocate
@@ -1026,7 +1201,7 @@ bt_http_get(const char *const uri, bool tor, bt_http *ctx,
     if (httpio_write_newline(ctx->link) == -1)
         goto error;
     // Extract the response from the request
-    result = bt_http_get_copy_response_HTTP_IO(ctx->link);
+    result = bt_http_get_copy_response_HTTP_IO(ctx->link, cache, status);
     // This is not NULL, we allocated it, let's free it
     if (ctx->own == false)
         goto error;
@@ -1040,3 +1215,26 @@ error:
     return result;
 }
 
+char *
+bt_http_get(const char *const uri, bool tor, bt_http *ctx,
+                             const bt_http_headers *const custom_headers)
+{
+    enum bt_http_result status;
+    return bt_http_request(uri, tor, ctx, custom_headers, NULL, &status);
+}
+
+char *
+bt_http_get_cached(const char *const uri, bool tor, bt_http *ctx,
+       const bt_http_headers *const custom_headers, enum bt_http_result *status)
+{
+    bt_http_cache_entry cache;
+    char *result;
+    bt_http_cache_get(uri, &cache);
+    result = bt_http_request(uri, tor, ctx, custom_headers, &cache, status);
+    // Remember the new validators, only a complete response has them
+    if (*status == HttpOk)
+        bt_http_cache_put(uri, &cache);
+    bt_http_cache_entry_finalize(&cache);
+    return result;
+}
+
@@ -4,15 +4,19 @@
 /** @file
  */
 #include <stdbool.h>
+#include <stddef.h>
 #include <pthread.h>
 
 typedef struct bt_context bt_context;
 typedef struct bt_event bt_event;
 typedef struct bt_topic bt_topic;
 typedef struct bt_event_list bt_event_list;
-typedef struct bt_topic_list bt_topic_list;
+typedef struct bt_topic_registry bt_topic_registry;
 struct httpio;
 
+/** Función que recibe los eventos que se retiran de la lista interna */
+typedef void (*bt_context_event_release)(bt_event *event, void *data);
+
 /**
  * @brief Encontrar un evento con id `match`
  * @param context El contexto de ejecución
@@ -33,13 +37,63 @@ bt_context *bt_create_context(void);
 void bt_context_free(bt_context *const context);
 /**
  * @brief Transferir los eventos del proveedor al consumidor de eventos
- * de William Hill
+ * de William Hill. Se comparan con los que ya fueron entregados y sólo los
+ * eventos nuevos y los que desaparecieron pasan por una cola sin bloqueos
+ * hacia el consumidor, que es despertado con `bt_context_get_events_fd()`.
+ * Sólo debe llamarse desde el hilo proveedor.
  * @param context El contexto de ejecución
- * @param events Los eventos para transferir
+ * @param events Los eventos para transferir, el contexto toma posesión de
+ * la lista
  */
 void bt_transfer_new_bt_william_hill_events(bt_context *const context, bt_event_list *const events);
 /**
- * @brief Obtener los eventos en la lista interna del contexto de ejecución
+ * @brief Recoger los eventos que el consumidor retiró por su cuenta, porque
+ * el servidor eliminó sus topics, y olvidar que fueron entregados para que
+ * se entreguen otra vez si siguen en la página. Sólo debe llamarse desde el
+ * hilo proveedor.
+ * @param context El contexto de ejecución
+ * @return El número de eventos que se entregarán otra vez
+ */
+size_t bt_context_collect_dropped_events(bt_context *const context);
+/**
+ * @brief Aplicar los cambios enviados por el proveedor a la lista interna.
+ * Sólo debe llamarse desde el hilo que consume los eventos, que es el único
+ * dueño de la lista interna y de los topics.
+ * @param context El contexto de ejecución
+ * @return El número de cambios aplicados
+ */
+size_t bt_context_adopt_events(bt_context *const context);
+/**
+ * @brief Repartir los cambios enviados por el proveedor entre varios
+ * contextos, cada uno con su propia lista de eventos y sus topics. Un
+ * partido siempre va al mismo contexto (hashing consistente por id). Se usa
+ * en lugar de `bt_context_adopt_events()` y sólo debe llamarse desde un hilo.
+ * @param context El contexto que recibe los cambios del proveedor
+ * @param targets Los contextos de destino
+ * @param count El número de contextos de destino
+ * @return El número de cambios reenviados
+ */
+size_t bt_context_forward_events(bt_context *const context, bt_context *const *const targets, size_t count);
+/**
+ * @brief Establecer quién recibe los eventos que se retiran de la lista
+ * interna, en lugar de liberarlos inmediatamente. Sirve cuando otro hilo
+ * aún puede estar procesando frames de esos eventos.
+ * @param context El contexto de ejecución
+ * @param release La función que toma posesión del evento o `NULL` para
+ * liberarlos directamente
+ * @param data Datos para `release`
+ */
+void bt_context_set_event_release(bt_context *const context, bt_context_event_release release, void *data);
+/**
+ * @brief Obtener el descriptor (un `eventfd`) que se vuelve legible cuando
+ * el proveedor envía cambios o cuando se detiene el contexto
+ * @param context El contexto de ejecución
+ * @return El descriptor o `-1` si no pudo ser creado
+ */
+int bt_context_get_events_fd(const bt_context *const context);
+/**
+ * @brief Obtener los eventos en la lista interna del contexto de ejecución.
+ * Sólo el hilo que consume los eventos puede usar esta lista.
  * @param context El contexto de ejecución
  * @return Una lista de los eventos actualmente alamacenados en el contexto
  */
@@ -47,12 +101,13 @@ bt_event_list *bt_context_get_events(const bt_context *const context);
 /**
  * @brief Encontrar un topic en el contexto de ejecución
  * @param context El contexto de ejecución
- * @param alias El alias del topic
- * @return El topic si es encontrado en la lista
+ * @param alias El alias del topic, no tiene que terminar en `null'
+ * @param length La longitud de `alias`
+ * @return El topic si es encontrado en el registro
  */
-const bt_topic *bt_william_hill_find_topic(const bt_context *const context, const char *const alias);
+const bt_topic *bt_william_hill_find_topic(const bt_context *const context, const char *const alias, size_t length);
 /**
- * @brief Anexar un topic a la lista del contexto
+ * @brief Anexar un topic al registro del contexto
  * @param context El contexto de ejecución
  * @param topic El topic para agregar
  * @return Si se ha logrado anexar el item
@@ -61,11 +116,13 @@ bool bt_context_append_topic(bt_context *const context, bt_topic *topic);
 /**
  * @brief Eliminar un topic del contexto de ejecución
  * @param context El contexto de ejecución
- * @param topic El topic a ser eliminado
+ * @param topic El topic a ser eliminado. El evento se reporta al proveedor
+ * (ver `bt_context_collect_dropped_events()`)
  */
 void bt_context_remove_bt_william_hill_topic(bt_context *const context, const bt_topic *const topic);
 /**
- * @brief Detener el programa, esta función termina el programa inmediatamente
+ * @brief Detener el programa, esta función termina el programa inmediatamente.
+ * También despierta a quien espera en `bt_context_get_events_fd()`
  * @param context El contexto de ejecución
  */
 void bt_context_stop(bt_context *const context);
@@ -79,14 +136,16 @@ void bt_unsubscribe_events(bt_context *const context);
  * @param context El contexto de ejecución
  * @param match El id del evento
  * @param type El tipo de topic
- * @return
+ * @return El topic o `NULL` si el evento no tiene un topic de ese tipo
  */
 bt_topic *bt_find_topic_for_event(const bt_context *const context, int match, int type);
 /**
- * @brief Ordenar los topics por alias alfabéticamente
+ * @brief Cambiar el alias de un topic manteniendo el registro consistente
  * @param context El contexto de ejecución
+ * @param topic El topic cuyo alias se reiniciará
+ * @param alias El nuevo alias, el contexto toma posesión de la memoria
  */
-void bt_context_sort_topics(bt_context *const context);
+void bt_context_reset_topic_alias(bt_context *const context, bt_topic *const topic, char *alias);
 /**
  * @brief Verificar que el programa no ha sido terminado
  * @param context El contexto de ejecución
@@ -94,7 +153,4 @@ void bt_context_sort_topics(bt_context *const context);
  */
 bool bt_isrunning(const bt_context *const context);
 
-void bt_global_lock();
-void bt_global_unlock();
-
 #endif /* __BETENIS_CONTEXT_H__ */
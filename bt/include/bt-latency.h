@@ -0,0 +1,72 @@
+#ifndef __BT_LATENCY_H__
+#define __BT_LATENCY_H__
+
+/** @file
+ *
+ * Latencia de extremo a extremo de las notificaciones, desde que llega el
+ * frame del WebSocket hasta que Telegram acepta el mensaje. Cada etapa
+ * marca el momento en que terminó (`CLOCK_MONOTONIC`) y al final el tiempo
+ * entre marcas se acumula en un histograma log-lineal por etapa: los
+ * grupos crecen en potencias de 2 y cada uno se divide en 8 partes, así el
+ * error relativo es menor al 12.5%. Las trazas más lentas de los últimos
+ * minutos se guardan para consultarlas por el socket de control.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/**
+ * @brief Las marcas de una traza, en el orden en que ocurren
+ */
+enum bt_latency_mark {
+    LatencyReceived, /**< Se recibió el frame */
+    LatencyParsed, /**< Se separó el alias del valor */
+    LatencyResolved, /**< Se encontró el topic */
+    LatencyClassified, /**< Se reconoció el tipo de incidente */
+    LatencyLookedUp, /**< Terminaron las consultas a la base de datos */
+    LatencySent, /**< Se envió la petición HTTP */
+    LatencyAnswered, /**< Llegó la respuesta de Telegram */
+    LatencyMarkCount
+};
+
+/**
+ * @brief Una traza, las marcas que no se han alcanzado valen `0`
+ */
+typedef struct bt_latency_trace {
+    uint64_t marks[LatencyMarkCount]; /**< Nanosegundos, `CLOCK_MONOTONIC` */
+    int event; /**< El id del partido o `-1` */
+} bt_latency_trace;
+
+/**
+ * @brief Empezar una traza
+ * @param trace La traza
+ * @param received El momento en que se recibió el frame
+ */
+void bt_latency_trace_start(bt_latency_trace *const trace, uint64_t received);
+/**
+ * @brief Marcar el final de una etapa con la hora actual
+ * @param trace La traza, si es `NULL` no hace nada
+ * @param mark La etapa que terminó
+ */
+void bt_latency_trace_mark(bt_latency_trace *const trace, enum bt_latency_mark mark);
+/**
+ * @brief Acumular la traza completa en los histogramas, desde cualquier hilo
+ * @param trace La traza, debe tener todas las marcas
+ * @param channel El canal al que se envió el mensaje, sólo para el reporte
+ */
+void bt_latency_trace_finish(const bt_latency_trace *const trace, const char *const channel);
+/**
+ * @brief Acumular una traza que no llega a Telegram, como las de un
+ * registro reproducido. `total` mide hasta `last` y la traza no se guarda
+ * entre las más lentas
+ * @param trace La traza, debe tener las marcas hasta `last`
+ * @param last La última marca de la traza
+ */
+void bt_latency_trace_finish_partial(const bt_latency_trace *const trace, enum bt_latency_mark last);
+/**
+ * @brief Escribir los percentiles de cada etapa y las trazas más lentas
+ * @return El texto, que debe ser liberado con `bt_free()`, o `NULL`
+ */
+char *bt_latency_report(void);
+
+#endif // __BT_LATENCY_H__
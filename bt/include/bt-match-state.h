@@ -0,0 +1,92 @@
+#ifndef __BT_MATCH_STATE_H__
+#define __BT_MATCH_STATE_H__
+
+/** @file
+ *
+ * Estado de un partido en vivo, se modifica en su lugar con cada topic que
+ * llega del WebSocket. Tiene un solo escritor (el hilo que procesa los frames
+ * del evento), los demás hilos leen copias consistentes con
+ * `bt_match_state_snapshot()`: el contador de versión es impar mientras se
+ * escribe, y el lector reintenta si cambió durante la copia.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#define BT_MATCH_STATE_SETS 5
+#define BT_MATCH_STATE_ALIGNMENT 64
+
+/**
+ * @brief El marcador de un partido, los índices de jugador son los equipos
+ * A (`0`) y B (`1`) de William Hill
+ */
+typedef struct bt_match_state {
+    uint32_t version; /**< Cambia con cada actualización, impar al escribir */
+    int8_t current_set; /**< Set actual empezando en 1, `-1` si se desconoce */
+    int8_t serving; /**< El jugador que tiene el servicio, `-1` si se desconoce */
+    int8_t points[2]; /**< Puntos en el juego actual */
+    int8_t games[2][BT_MATCH_STATE_SETS]; /**< Juegos ganados en cada set */
+} __attribute__((aligned(BT_MATCH_STATE_ALIGNMENT))) bt_match_state;
+
+/**
+ * @brief Olvidar todo lo que se sabe del partido
+ * @param state El estado de interés
+ */
+void bt_match_state_reset(bt_match_state *const state);
+/**
+ * @brief Actualizar los juegos ganados por un jugador en un set
+ * @param state El estado de interés
+ * @param idx El jugador
+ * @param set El set, empezando en `0`
+ * @param games Los juegos ganados
+ */
+void bt_match_state_set_games(bt_match_state *const state, size_t idx, int set, int games);
+/**
+ * @brief Actualizar los puntos de un jugador en el juego actual
+ * @param state El estado de interés
+ * @param idx El jugador
+ * @param points Los puntos
+ */
+void bt_match_state_set_points(bt_match_state *const state, size_t idx, int points);
+/**
+ * @brief Actualizar el set actual
+ * @param state El estado de interés
+ * @param set El set, empezando en `1`
+ */
+void bt_match_state_set_current_set(bt_match_state *const state, int set);
+/**
+ * @brief Actualizar el jugador que tiene el servicio
+ * @param state El estado de interés
+ * @param idx El jugador
+ */
+void bt_match_state_set_serving(bt_match_state *const state, int idx);
+/**
+ * @brief Obtener el set actual, sólo para el hilo que escribe
+ * @param state El estado de interés
+ * @return El set actual o `-1`
+ */
+int bt_match_state_get_current_set(const bt_match_state *const state);
+/**
+ * @brief Obtener la versión, dos lecturas con la misma versión par vieron
+ * el mismo estado
+ * @param state El estado de interés
+ * @return La versión
+ */
+uint32_t bt_match_state_get_version(const bt_match_state *const state);
+/**
+ * @brief Copiar el estado de forma consistente, desde cualquier hilo
+ * @param state El estado de interés
+ * @param snapshot Donde se almacena la copia
+ */
+void bt_match_state_snapshot(const bt_match_state *const state, bt_match_state *const snapshot);
+/**
+ * @brief Escribir el marcador por sets, por ejemplo `6-4 3-2`
+ * @param state El estado, normalmente una copia de `bt_match_state_snapshot()`
+ * @param first El jugador cuyos juegos van primero
+ * @param buffer Donde se escribe, siempre termina en `null'
+ * @param size El tamaño de `buffer`
+ * @return La longitud de la cadena escrita
+ */
+size_t bt_match_state_render(const bt_match_state *const state, size_t first, char *const buffer, size_t size);
+
+#endif // __BT_MATCH_STATE_H__
@@ -3,18 +3,9 @@
 
 #include <bt-util.h>
 
-typedef struct bt_score_set {
-    int8_t games;
-} bt_score_set;
-
-typedef struct bt_score {
-    bt_score_set sets[5];
-} bt_score;
-
 typedef struct bt_player {
     int c_mto_count;
     int t_mto_count;
-    bt_score score;
     char *name;
     int id;
     int last;
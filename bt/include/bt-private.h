@@ -2,6 +2,7 @@
 #define __BT_MBET_PRIVATE_HEADER_H__
 
 #include <bt-util.h>
+#include <bt-arena.h>
 #include <stdlib.h>
 #include <time.h>
 
@@ -9,8 +10,6 @@ typedef struct bt_mbet_list bt_mbet_list;
 typedef struct bt_mbet_list_item {
     void *parent;
     void *data;
-    /* Free function */
-    void (*freefn)(void *);
 } bt_mbet_list_item;
 
 typedef struct bt_mbet_list {
@@ -20,12 +19,12 @@ typedef struct bt_mbet_list {
 
 typedef struct bt_mbet_market bt_mbet_market;
 typedef struct bt_mbet_selection {
-    char *name;
+    const char *name;
     float coeff;
     float value;
     long int coeff_id;
-    char *selkey;
-    char *uid;
+    const char *selkey;
+    const char *uid;
     int score_home;
     int score_away;
 } bt_mbet_selection;
@@ -33,9 +32,9 @@ typedef struct bt_mbet_selection {
 typedef struct bt_mbet_event bt_mbet_event;
 typedef struct bt_mbet_market {
     /* porperties */
-    char *model;
-    char *name;
-    char *type;
+    const char *model;
+    const char *name;
+    const char *type;
     /* Value */
     float value;
     /* child nodes */
@@ -45,9 +44,9 @@ typedef struct bt_mbet_market {
 typedef struct bt_mbet_member {
     long int id;
     char *name;
-    char *role;
+    const char *role;
     int ocid;
-    char *selkey;
+    const char *selkey;
     char *flag;
     float odds;
     int ranking;
@@ -71,10 +70,10 @@ typedef struct bt_mbet_group bt_mbet_group;
 typedef struct bt_mbet_event {
     /* properties */
     long int tree_id;
-    char *name;
+    const char *name;
     struct tm date;
     /* child nodes */
-    char *url;
+    const char *url;
     bt_mbet_score *score;
     bt_mbet_member *home;
     bt_mbet_member *away;
@@ -115,12 +114,14 @@ typedef struct bt_mbet_feed bt_mbet_feed;
 typedef struct bt_mbet_sport {
     bt_mbet_list *groups;
 
-    char *code;
-    char *name;
+    const char *code;
+    const char *name;
 } bt_mbet_sport;
 
 typedef struct bt_mbet_feed {
     bt_mbet_list *sports;
+    /* Everything in the feed, including it, is allocated here */
+    bt_arena *arena;
 } bt_mbet_feed;
 
 typedef enum bt_mbet_feed_type {
@@ -150,9 +151,16 @@ typedef struct bt_mbet_market_descriptor {
 extern bt_mbet_market_descriptor s_bt_mbet_markets[];
 
 
+typedef struct bt_william_hill_pipeline bt_william_hill_pipeline;
+typedef struct bt_william_hill_capture bt_william_hill_capture;
+typedef struct bt_william_hill_recovery bt_william_hill_recovery;
 typedef struct bt_websocket_connection {
     struct httpio *ws;
     bt_context *context;
+    bt_william_hill_pipeline *pipeline;
+    bt_william_hill_capture *capture;
+    bt_william_hill_recovery *recovery;
+    size_t index;
 } bt_websocket_connection;
 
 void *bt_mbet_list_get_item_data(const bt_mbet_list *list, size_t idx);
@@ -4,6 +4,8 @@
 /** @file
  */
 
+#include <stdlib.h>
+
 typedef struct bt_string_builder bt_string_builder;
 /**
  * @brief Crear un constructor de cadenas nuevo
@@ -67,4 +69,10 @@ const char *bt_string_builder_string(const bt_string_builder *const builder);
  * @param builder Apuntador al objeto que se reiniciará
  */
 void bt_string_builder_reset(bt_string_builder *builder);
+/**
+ * @brief Obtener la longitud de la cadena construida
+ * @param builder El constructor de cadenas objetivo
+ * @return El número de caracteres, sin contar el `null' final
+ */
+size_t bt_string_builder_length(const bt_string_builder *const builder);
 #endif // __BT_STRING_BUILDER_H__
@@ -4,8 +4,12 @@
 /** @file
  */
 
+#include <stdbool.h>
+
 #include <json.h>
 
+#include <bt-latency.h>
+
 #define MBET_URL "https://www.mbet.com/es/popular/Tennis/?menu=false"
 #define LIVE "\xF0\x9F\x8E\xBE <b>LIVE</b> — "
 #define RETIRED_LIST "<b>Retirados de hoy</b>\n<i>El tenis es muy duro</i>\n\n%s"
@@ -18,7 +22,100 @@
 #define MEDICAL_TIMEOUT_MULTI_NO_PLAYER "\xF0\x9F\xA4\x95 <b>LIVE</b> — Han solicitado tratamiento médico <b>%d minutos</b> %s vs %s en <b>%s</b>"
 #define PLAYS_DOUBLES "\n\n<b>Nota</b>: jugar&#225; dobles"
 
+typedef struct bt_telegram_notification bt_telegram_notification;
+/**
+ * @brief Función que recibe el resultado de enviar una notificación a un
+ * canal. Se llama desde uno de los hilos que envían los mensajes.
+ * @param channel El canal
+ * @param previous El id del mensaje que se intentó editar o `-1`
+ * @param id El id del mensaje enviado o `-1` si hubo un error
+ * @param data Los datos pasados a `bt_telegram_notification_set_callbacks()`
+ */
+typedef void (*bt_telegram_completion)(const char *const channel, int previous, int id, void *data);
+/**
+ * @brief Función que obtiene el id del mensaje a editar justo antes de
+ * enviarlo, o `-1` para enviar un mensaje nuevo. Como los mensajes de un
+ * canal se envían en orden, ve el id guardado por la notificación anterior.
+ * @param channel El canal
+ * @param data Los datos pasados a `bt_telegram_notification_set_callbacks()`
+ * @return El id del mensaje a editar o `-1`
+ */
+typedef int (*bt_telegram_edit_resolver)(const char *const channel, void *data);
+/**
+ * @brief Función que envía un mensaje en lugar de la petición HTTP a
+ * Telegram, se llama desde el hilo que envía el mensaje
+ * @param channel El canal
+ * @param id El id del mensaje a editar o `-1`
+ * @param message El mensaje, ya codificado para el URL
+ * @return El id del mensaje enviado o `-1` si hubo un error
+ */
+typedef int (*bt_telegram_transport)(const char *const channel, int id, const char *const message);
+
 int bt_telegram_send_message(const char *const channel, const char *const format, ...);
 int bt_telegram_edit_message(int id, const char *const channel, const char *const format, ...);
+/**
+ * @brief Iniciar los hilos que envían las notificaciones, el número se toma
+ * de la variable de entorno `TELEGRAM_SENDERS` (2 por omisión). Mientras no
+ * hayan sido iniciados las notificaciones se envían desde el hilo que las
+ * publica.
+ * @return Si se pudo iniciar al menos un hilo
+ */
+bool bt_telegram_dispatcher_start(void);
+/**
+ * @brief Reemplazar las peticiones HTTP a Telegram, por ejemplo al
+ * reproducir un registro de frames
+ * @param transport La función que envía los mensajes, o `NULL` para volver a
+ * usar HTTP
+ */
+void bt_telegram_set_transport(bt_telegram_transport transport);
+/**
+ * @brief Enviar las notificaciones pendientes y detener los hilos
+ */
+void bt_telegram_dispatcher_stop(void);
+/**
+ * @brief Crear una notificación, el texto se forma como con `printf()`
+ * @param format El formato del texto
+ * @return La notificación que debe pasarse a `bt_telegram_notification_post()`
+ * o a `bt_telegram_notification_free()`
+ */
+bt_telegram_notification *bt_telegram_notification_new(const char *const format, ...);
+/**
+ * @brief Agregar un canal de destino
+ * @param notification La notificación de interés
+ * @param channel El canal, se copia
+ * @param id El id del mensaje a editar o `-1` para enviar uno nuevo, se
+ * ignora si hay un `bt_telegram_edit_resolver`
+ * @return Si se pudo agregar el canal
+ */
+bool bt_telegram_notification_add_channel(bt_telegram_notification *const notification, const char *const channel, int id);
+/**
+ * @brief Establecer las funciones que se llaman al enviar el mensaje a cada
+ * canal
+ * @param notification La notificación de interés
+ * @param resolver Obtiene el id del mensaje a editar, puede ser `NULL`
+ * @param completion Recibe el id del mensaje enviado, puede ser `NULL`
+ * @param data Datos para ambas funciones, deben ser válidos hasta que se
+ * haya enviado el mensaje a todos los canales
+ */
+void bt_telegram_notification_set_callbacks(bt_telegram_notification *const notification, bt_telegram_edit_resolver resolver, bt_telegram_completion completion, void *data);
+/**
+ * @brief Medir la latencia de esta notificación, el mensaje a cada canal
+ * agrega las marcas de la petición HTTP a su propia copia de la traza y la
+ * acumula en `bt_latency_trace_finish()` si Telegram lo aceptó
+ * @param notification La notificación de interés
+ * @param trace La traza hasta ahora, se copia
+ */
+void bt_telegram_notification_set_trace(bt_telegram_notification *const notification, const bt_latency_trace *const trace);
+/**
+ * @brief Encolar la notificación para cada uno de sus canales, no bloquea
+ * @param notification La notificación, esta función la libera
+ * @return Si todos los mensajes fueron encolados
+ */
+bool bt_telegram_notification_post(bt_telegram_notification *notification);
+/**
+ * @brief Liberar una notificación que no fue publicada
+ * @param notification La notificación
+ */
+void bt_telegram_notification_free(bt_telegram_notification *notification);
 
 #endif /* __TELEGRAM_CHANNEL_H__ */
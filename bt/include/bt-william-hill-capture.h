@@ -0,0 +1,55 @@
+#ifndef __bt_william_hill_CAPTURE_H__
+#define __bt_william_hill_CAPTURE_H__
+
+/** @file
+ *
+ * Registro binario de los frames recibidos del WebSocket. El archivo empieza
+ * con la firma `BTWH` seguida de la versión (un `uint32_t`), luego cada frame
+ * es un registro
+ *
+ *     uint64_t received; // CLOCK_MONOTONIC en nanosegundos
+ *     uint32_t length;   // longitud de `data`
+ *     uint8_t data[length];
+ *
+ * con los enteros en el orden de bytes de la máquina. Un registro de
+ * longitud `0` marca una nueva conexión al WebSocket, y el registro que le
+ * sigue es el saludo del servidor en esa conexión (desde la versión `2`).
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BT_WILLIAM_HILL_CAPTURE_VERSION 2
+
+typedef struct bt_william_hill_capture bt_william_hill_capture;
+
+/**
+ * @brief Abrir el registro de una conexión. El nombre es el valor de la
+ * variable de entorno `WILLIAM_HILL_CAPTURE`, si existe, seguido de `.` y
+ * el número de conexión. El archivo se trunca.
+ * @param index El número de la conexión
+ * @return El registro o `NULL` si no se pidió o no se pudo crear
+ */
+bt_william_hill_capture *bt_william_hill_capture_open(size_t index);
+/**
+ * @brief Anexar un frame al registro
+ * @param capture El registro, si es `NULL` no hace nada
+ * @param received El momento en que se recibió el frame en nanosegundos
+ * @param data El contenido del frame
+ * @param length La longitud de `data`, `0` para marcar una nueva conexión
+ * @return Si el frame fue escrito
+ */
+bool bt_william_hill_capture_write(bt_william_hill_capture *const capture, uint64_t received, const void *const data, size_t length);
+/**
+ * @brief Escribir en el disco los frames que están en memoria
+ * @param capture El registro, si es `NULL` no hace nada
+ */
+void bt_william_hill_capture_flush(bt_william_hill_capture *const capture);
+/**
+ * @brief Cerrar el registro
+ * @param capture El registro para cerrar
+ */
+void bt_william_hill_capture_close(bt_william_hill_capture *capture);
+
+#endif // __bt_william_hill_CAPTURE_H__
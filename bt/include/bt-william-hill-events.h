@@ -5,14 +5,38 @@
  */
 
 #include <bt-william-hill.h>
+#include <bt-match-state.h>
 
 #include <json.h>
 #include <mysql.h>
 
 struct httpio;
 typedef struct bt_context bt_context;
+typedef struct bt_william_hill_schedule bt_william_hill_schedule;
 
 typedef void (*bt_event_list_applier)(size_t, bt_event *,void *);
+/**
+ * @brief Crear un evento del que sólo se conoce el id, sin jugadores ni
+ * torneo. Sirve para decodificar frames grabados sin consultar la web ni
+ * la base de datos, sus valores no deben procesarse sin antes llamar a
+ * `bt_william_hill_event_set_competitors()`
+ * @param id El id del evento
+ * @return El evento recién alojado que debe ser liberado con
+ * `bt_william_hill_event_free()`
+ */
+bt_event *bt_william_hill_event_new(int id);
+/**
+ * @brief Dar jugadores y torneo a un evento creado con
+ * `bt_william_hill_event_new()`, para que sus valores puedan procesarse. Los
+ * jugadores no tienen id de <a href="www.oncourt.org">oncourt</a> ni
+ * tiempos médicos previos, y la categoría se toma del nombre del torneo.
+ * @param event El evento
+ * @param home El nombre del primer jugador, se copia
+ * @param away El nombre del segundo jugador, se copia
+ * @param tour El nombre del torneo, se copia
+ * @return Si se pudo alojar todo, si no el evento no cambia
+ */
+bool bt_william_hill_event_set_competitors(bt_event *const event, const char *const home, const char *const away, const char *const tour);
 /**
  * @brief Liberar un objeto evento
  * @param event El objeto para liberar
@@ -27,9 +51,19 @@ bt_event_list *bt_william_hill_event_list_new();
 /**
  * @brief Obtener la lista de eventos disponibles desde
  * la web de oncourt
- * @return Una lista de eventos disponibles para ser observados
+ * @param schedule Donde se anotan las horas de inicio de los partidos que
+ * aún no empiezan, puede ser `NULL`. Si la página no cambió conserva las
+ * anteriores
+ * @return Una lista de eventos disponibles para ser observados, o `NULL`
+ * si falló o la página no ha cambiado desde la última vez
+ */
+bt_event_list *bt_william_hill_events_list_fetch(bt_william_hill_schedule *const schedule);
+/**
+ * @brief Hacer que `bt_william_hill_events_list_fetch()` entregue la lista
+ * la próxima vez aunque la página no haya cambiado, para cuando no se pudo
+ * procesar completa la última
  */
-bt_event_list *bt_william_hill_events_list_fetch();
+void bt_william_hill_events_list_invalidate(void);
 /**
  * @brief Encontrar un evento dado el ID interno de William Hill.
  * @param list La lista de eventos en la cual se encuentra el posible
@@ -64,6 +98,14 @@ void bt_william_hill_event_list_clear(bt_event_list *list);
  * @return El evento que ha sido retirado por completo de la lista `list`
  */
 bt_event *bt_william_hill_event_list_take(bt_event_list *list, int index);
+/**
+ * @brief Quitar un evento de una lista sin liberarlo
+ * @param list La lista de la que se quiere, retirar el evento
+ * @param event El evento que queremos retirar
+ * @return El evento retirado, cuya memoria queda bajo la responsabilidad
+ * del que lo recibe, o `NULL` si no estaba en la lista
+ */
+bt_event *bt_william_hill_event_list_detach(bt_event_list *const list, const bt_event *const event);
 /**
  * @brief Quitar un evento de una lista y liberar la memoria que usa
  * @param list La lista de la que se quiere, retirar el evento
@@ -123,17 +165,34 @@ int bt_william_hill_event_get_id(const bt_event *const event);
  * @return El id del torneo según la base de datos de oncourt
  */
 const char *bt_william_hill_event_get_tour(const bt_event *const event);
+/**
+ * @brief Marcar un evento como pendiente de suscribir, el siguiente llamado
+ * a `bt_william_hill_event_list_subscribe_all()` sólo envía las suscripciones
+ * de los eventos marcados
+ * @param list La lista que contiene al evento
+ * @param event El evento de interés
+ */
+void bt_william_hill_event_list_mark_dirty(bt_event_list *const list, const bt_event *const event);
 /**
  * @brief Marcar todos los eventos en la lista como NO suscritos al WebSocket
- * de William Hill
+ * de William Hill, y pendientes de suscribir. No toca el estado del partido,
+ * ver `bt_william_hill_event_reset()`
  * @param list Lista de eventos para marcar
  */
 void bt_william_hill_event_list_unsubscribe_all(bt_event_list *list);
 /**
- * @brief Suscribir todos los eventos en el WebSocket de William Hill
- * para escuchar y monitorear la actividad
+ * @brief Olvidar el estado del partido (set actual, marcador y MTOs
+ * notificados) para volver a recibirlo tras una reconexión
+ * @param event El evento de interés
+ */
+void bt_william_hill_event_reset(bt_event *const event);
+/**
+ * @brief Suscribir los eventos pendientes en el WebSocket de William Hill
+ * para escuchar y monitorear la actividad. Las suscripciones se agrupan en
+ * el menor número posible de frames
  * @param websocket La conexión al WebSocket
  * @param list La lista de eventos para registrar
+ * @return -1 si falló el envío, los eventos siguen pendientes
  */
 int bt_william_hill_event_list_subscribe_all(const bt_websocket_connection *const websocket, bt_event_list *list);
 /**
@@ -155,6 +214,31 @@ void bt_william_hill_event_set_current_set(bt_event *const event, int set);
  * @return El número de set actual
  */
 int bt_william_hill_event_get_current_set(const bt_event *const event);
+/**
+ * @brief Obtener el marcador del partido. Sólo el hilo que procesa los
+ * frames del evento lo modifica, los demás deben leerlo con
+ * `bt_match_state_snapshot()`
+ * @param event El evento de interés
+ * @return El estado del partido
+ */
+bt_match_state *bt_william_hill_event_get_state(const bt_event *const event);
+
+/**
+ * @brief Obtener el topic de tipo `type` del evento, cada evento tiene a lo
+ * sumo un topic de cada tipo
+ * @param event El evento de interés
+ * @param type El tipo de topic
+ * @return El topic o `NULL` si el WebSocket aún no lo ha anunciado
+ */
+bt_topic *bt_william_hill_event_get_topic(const bt_event *const event, enum bt_topic_type type);
+/**
+ * @brief Asignar el topic de tipo `type` del evento. El evento toma posesión
+ * del topic y lo libera en `bt_william_hill_event_free()`
+ * @param event El evento de interés
+ * @param type El tipo de topic
+ * @param topic El topic o `NULL` para vaciar la posición
+ */
+void bt_william_hill_event_set_topic(bt_event *const event, enum bt_topic_type type, bt_topic *const topic);
 
 bool bt_william_hill_event_is_ready_for_incidents(bt_event *const event);
 const char *bt_william_hill_event_get_date(const bt_event *const event);
@@ -18,8 +18,11 @@
  */
 void *bt_william_hill_events_provider(void *data);
 /**
- * @brief Esta función se conecta al WebSocket, recoje los eventos
- * dejados por `bt_william_hill_events_provider()` y envía los
+ * @brief Esta función abre varias conexiones al WebSocket (la variable de
+ * entorno `WILLIAM_HILL_CONNECTIONS`, 2 por omisión), cada una en su propio
+ * hilo, y les reparte los eventos dejados por
+ * `bt_william_hill_events_provider()` según el id del partido. Cada conexión
+ * se suscribe a sus eventos, se reconecta por su cuenta y envía los
  * incidentes relevantes a otras funciones que notifican y almacenan
  * la información.
  * @param data Este parámetro es de tipo `void *` porque esta función
@@ -0,0 +1,115 @@
+#ifndef __bt_william_hill_PIPELINE_H__
+#define __bt_william_hill_PIPELINE_H__
+
+/** @file
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <bt-william-hill-topics.h>
+#include <bt-latency.h>
+
+typedef struct bt_event bt_event;
+typedef struct bt_event_list bt_event_list;
+typedef struct bt_websocket_connection bt_websocket_connection;
+typedef struct bt_william_hill_pipeline bt_william_hill_pipeline;
+
+/**
+ * @brief Latencia acumulada de una etapa, en nanosegundos
+ */
+typedef struct bt_pipeline_stage_stats {
+    uint64_t count; /**< Número de frames medidos */
+    uint64_t total; /**< Suma de las latencias */
+    uint64_t max; /**< La mayor latencia observada */
+    uint64_t allocations; /**< Llamadas a `bt_malloc()` y similares */
+} bt_pipeline_stage_stats;
+
+/**
+ * @brief Estado de las colas y latencia de cada etapa
+ */
+typedef struct bt_william_hill_pipeline_stats {
+    size_t workers; /**< Número de hilos que procesan frames */
+    size_t depth; /**< Frames esperando en todas las colas */
+    size_t max_depth; /**< La cola más larga que se ha observado */
+    bt_pipeline_stage_stats decode; /**< Desde que se recibe el frame hasta que se encola */
+    bt_pipeline_stage_stats wait; /**< Tiempo en la cola */
+    bt_pipeline_stage_stats process; /**< Procesamiento, incluye MySQL y Telegram */
+} bt_william_hill_pipeline_stats;
+
+/**
+ * @brief Crear los hilos que procesan los frames del WebSocket. El hilo que
+ * lee del WebSocket sólo decodifica los frames y los reparte entre los hilos
+ * según el id del partido, así los frames de un partido se procesan en el
+ * mismo orden en que llegaron. El número de hilos se toma de la variable de
+ * entorno `WILLIAM_HILL_WORKERS` (2 por omisión).
+ * @param wsc La conexión al WebSocket, las suscripciones que piden los
+ * hilos se envían a través de ella desde `bt_william_hill_pipeline_flush()`
+ * @return El objeto recién alojado que debe ser liberado con
+ * `bt_william_hill_pipeline_free()`
+ */
+bt_william_hill_pipeline *bt_william_hill_pipeline_new(bt_websocket_connection *const wsc);
+/**
+ * @brief Detener los hilos y liberar los recursos. Los eventos que aún
+ * estaban en las colas para ser liberados se liberan aquí.
+ * @param pipeline El objeto para liberar
+ */
+void bt_william_hill_pipeline_free(bt_william_hill_pipeline *pipeline);
+/**
+ * @brief Encolar el valor de un topic para que sea procesado por el hilo
+ * que corresponde al evento. Si la cola está llena espera a que haya espacio.
+ * Sólo puede llamarla el hilo que lee del WebSocket.
+ * @param pipeline El objeto de interés
+ * @param event El evento al que pertenece el topic
+ * @param type El tipo de topic
+ * @param value El valor, no tiene que terminar en `null', se copia
+ * @param length La longitud de `value`
+ * @param trace La traza del frame, desde que se recibió según
+ * `bt_william_hill_pipeline_now()`, se copia
+ * @return Si el valor fue encolado
+ */
+bool bt_william_hill_pipeline_submit(bt_william_hill_pipeline *const pipeline, bt_event *const event, enum bt_topic_type type, const char *const value, size_t length, const bt_latency_trace *const trace);
+/**
+ * @brief Pedir a los hilos que olviden el estado de los partidos, después
+ * de reconectar el WebSocket
+ * @param pipeline El objeto de interés
+ * @param list Los eventos cuyo estado se reinicia
+ */
+void bt_william_hill_pipeline_reset(bt_william_hill_pipeline *const pipeline, const bt_event_list *const list);
+/**
+ * @brief Liberar un evento cuando su hilo termine de procesar los frames
+ * que ya estaban en cola. Tiene la signatura de `bt_context_event_release`
+ * para usarse con `bt_context_set_event_release()`
+ * @param event El evento, el objeto toma posesión de su memoria
+ * @param data El `bt_william_hill_pipeline`
+ */
+void bt_william_hill_pipeline_release(bt_event *event, void *data);
+/**
+ * @brief Enviar al WebSocket las suscripciones pedidas por los hilos,
+ * agrupadas en el menor número posible de frames
+ * @param pipeline El objeto de interés
+ * @return El número de suscripciones enviadas
+ */
+size_t bt_william_hill_pipeline_flush(bt_william_hill_pipeline *const pipeline);
+/**
+ * @brief Obtener el descriptor (un `eventfd`) que se vuelve legible cuando
+ * los hilos piden suscripciones, hasta el siguiente
+ * `bt_william_hill_pipeline_flush()`
+ * @param pipeline El objeto de interés
+ * @return El descriptor
+ */
+int bt_william_hill_pipeline_get_requests_fd(const bt_william_hill_pipeline *const pipeline);
+/**
+ * @brief Obtener la profundidad de las colas y la latencia de cada etapa
+ * @param pipeline El objeto de interés
+ * @param stats Donde se almacenan los valores
+ */
+void bt_william_hill_pipeline_get_stats(const bt_william_hill_pipeline *const pipeline, bt_william_hill_pipeline_stats *const stats);
+/**
+ * @brief El reloj con el que se miden las etapas
+ * @return Nanosegundos de `CLOCK_MONOTONIC`
+ */
+uint64_t bt_william_hill_pipeline_now(void);
+
+#endif // __bt_william_hill_PIPELINE_H__
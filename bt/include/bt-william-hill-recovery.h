@@ -0,0 +1,68 @@
+#ifndef __bt_william_hill_RECOVERY_H__
+#define __bt_william_hill_RECOVERY_H__
+
+/** @file
+ *
+ * Recuperación rápida de la conexión al WebSocket. Un hilo mantiene lista
+ * una conexión de reserva (ya con el saludo hecho, también a través de Tor
+ * si `bt_william_hill_use_tor()`), de manera que al perder la conexión
+ * activa se reemplaza de inmediato. Si no hay reserva, el hilo reintenta
+ * con espera exponencial y un poco de azar para no reconectar todos al
+ * mismo tiempo.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// El servidor envía la hora cada 15 segundos, si en este tiempo no llega
+// nada la conexión está muerta
+#define BT_WILLIAM_HILL_STALE_TIMEOUT 17000000000ULL
+
+typedef struct bt_context bt_context;
+typedef struct bt_william_hill_recovery bt_william_hill_recovery;
+
+/**
+ * @brief Latencia de las reconexiones, en nanosegundos, desde que se
+ * pide la nueva conexión hasta que está lista
+ */
+typedef struct bt_william_hill_recovery_stats {
+    uint64_t count; /**< Número de reconexiones */
+    uint64_t promoted; /**< Cuántas usaron la conexión de reserva */
+    uint64_t total; /**< Suma de las latencias */
+    uint64_t max; /**< La mayor latencia observada */
+    uint64_t failures; /**< Intentos de conexión fallidos */
+} bt_william_hill_recovery_stats;
+
+/**
+ * @brief Crear el hilo que mantiene la conexión de reserva
+ * @param index El número de la conexión, sólo para los mensajes
+ * @return El objeto recién alojado que debe ser liberado con
+ * `bt_william_hill_recovery_free()`
+ */
+bt_william_hill_recovery *bt_william_hill_recovery_new(size_t index);
+/**
+ * @brief Detener el hilo, cerrar la conexión de reserva y liberar los
+ * recursos
+ * @param recovery El objeto para liberar
+ */
+void bt_william_hill_recovery_free(bt_william_hill_recovery *recovery);
+/**
+ * @brief Obtener una conexión nueva. Si hay una de reserva se entrega de
+ * inmediato, si no espera a que el hilo logre conectarse.
+ * @param recovery El objeto de interés
+ * @param context El contexto de ejecución, deja de esperar si se detiene
+ * @param greeting Donde se almacena el saludo del servidor en esa conexión,
+ * que debe ser liberado con `bt_free()`
+ * @return La conexión, de la cual toma posesión quien llama, o `NULL` si
+ * se detuvo el contexto
+ */
+struct httpio *bt_william_hill_recovery_connect(bt_william_hill_recovery *const recovery, const bt_context *const context, char **greeting);
+/**
+ * @brief Obtener la latencia de las reconexiones
+ * @param recovery El objeto de interés
+ * @param stats Donde se almacenan los valores
+ */
+void bt_william_hill_recovery_get_stats(bt_william_hill_recovery *const recovery, bt_william_hill_recovery_stats *const stats);
+
+#endif // __bt_william_hill_RECOVERY_H__
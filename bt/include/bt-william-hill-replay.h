@@ -0,0 +1,38 @@
+#ifndef __bt_william_hill_REPLAY_H__
+#define __bt_william_hill_REPLAY_H__
+
+/** @file
+ *
+ * Reproducir un registro de frames (ver `bt-william-hill-capture.h`) a
+ * través del mismo código que los recibe del WebSocket: el hilo que lee
+ * decodifica los frames y los hilos de `bt-william-hill-pipeline.h` procesan
+ * los valores. Sólo se reemplazan los efectos externos: las consultas a
+ * MySQL fallan como si el servidor no estuviera, Telegram acepta los
+ * mensajes sin enviarlos y las suscripciones que piden los hilos se
+ * descartan. Cada conexión empieza con el saludo del servidor registrado
+ * (uno fabricado en los registros de la versión `1`).
+ *
+ * Los eventos se crean con los ids de las rutas de los topics en los frames
+ * de control y los jugadores de `competitors/A/teamName` y
+ * `competitors/B/teamName`. El registro no tiene el torneo, se toma de la
+ * variable de entorno `WILLIAM_HILL_REPLAY_TOUR` (`ATP` por omisión) y con
+ * él la categoría que decide a qué canales de `~/.channel-settings.bt` se
+ * notifica.
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+/**
+ * @brief Reproducir un registro y escribir en la salida estándar los frames
+ * por segundo, la latencia de cada etapa de los hilos y los percentiles de
+ * `bt_latency_report()`. Como en el programa, sólo las notificaciones de
+ * tiempos médicos completan todas las marcas de latencia
+ * @param path El archivo del registro
+ * @param realtime Si se respetan los tiempos en que se recibieron los
+ * frames, si no se reproducen lo más rápido posible
+ * @return `0`, o `-1` si el registro no se pudo leer
+ */
+int bt_william_hill_replay(const char *const path, bool realtime);
+
+#endif // __bt_william_hill_REPLAY_H__
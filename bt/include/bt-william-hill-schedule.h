@@ -0,0 +1,59 @@
+#ifndef __bt_william_hill_SCHEDULE_H__
+#define __bt_william_hill_SCHEDULE_H__
+
+/** @file
+ *
+ * Frecuencia con que se revisa la lista de eventos de William Hill. Al
+ * leer la página se anotan las horas de inicio de los partidos que aún no
+ * empiezan; cerca de una de ellas se revisa cada pocos segundos
+ * (`WILLIAM_HILL_POLL_MIN`, 5 por omisión), y si no hay partidos pendientes
+ * la espera se duplica cada vez hasta `WILLIAM_HILL_POLL_MAX` (900 segundos
+ * por omisión).
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+
+typedef struct bt_william_hill_schedule bt_william_hill_schedule;
+
+/**
+ * @brief Crear un calendario vacío
+ * @return El objeto recién alojado que debe ser liberado con
+ * `bt_william_hill_schedule_free()`
+ */
+bt_william_hill_schedule *bt_william_hill_schedule_new(void);
+/**
+ * @brief Liberar el calendario
+ * @param schedule El objeto para liberar
+ */
+void bt_william_hill_schedule_free(bt_william_hill_schedule *schedule);
+/**
+ * @brief Olvidar las horas de inicio, se llama antes de leer una página
+ * nueva
+ * @param schedule El calendario de interés
+ */
+void bt_william_hill_schedule_clear(bt_william_hill_schedule *const schedule);
+/**
+ * @brief Anotar la hora de inicio de un partido que aún no empieza
+ * @param schedule El calendario de interés
+ * @param start La hora de inicio
+ */
+void bt_william_hill_schedule_add(bt_william_hill_schedule *const schedule, time_t start);
+/**
+ * @brief Elegir cuánto esperar antes de revisar de nuevo
+ * @param schedule El calendario de interés
+ * @param now La hora actual
+ * @param changed Si la página cambió en la última revisión, vuelve a la
+ * espera inicial
+ * @return La espera en segundos
+ */
+unsigned int bt_william_hill_schedule_next(bt_william_hill_schedule *const schedule, time_t now, bool changed);
+/**
+ * @brief Obtener la última espera elegida, desde cualquier hilo. Se puede
+ * consultar con `bt schedule`
+ * @return La espera en segundos, `0` si aún no se ha elegido ninguna
+ */
+unsigned int bt_william_hill_schedule_get_interval(void);
+
+#endif // __bt_william_hill_SCHEDULE_H__
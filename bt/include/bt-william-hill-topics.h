@@ -5,11 +5,23 @@
  */
 
 #include <stdlib.h>
+#include <stdbool.h>
 #include <mysql.h>
 
 #include <http-websockets.h>
 
+// Longitud máxima de un frame de suscripción
+#define BT_TOPIC_BATCH_SIZE 4096
+
 typedef struct bt_websocket_connection bt_websocket_connection;
+typedef struct bt_string_builder bt_string_builder;
+/**
+ * @brief Función que envía una petición de suscripción (`path`, la ruta del
+ * topic sin el tipo de mensaje) al WebSocket.
+ * Permite que los hilos que no leen del WebSocket pidan suscripciones a
+ * través del hilo que sí lo hace
+ */
+typedef bool (*bt_topic_subscriber)(const char *const path, void *data);
 enum bt_player_idx {
     Home = 0,
     Away = 1
@@ -58,7 +70,7 @@ enum bt_topic_type
 
 
 typedef struct bt_context bt_context;
-typedef struct bt_topic_list bt_topic_list;
+typedef struct bt_topic_registry bt_topic_registry;
 typedef struct bt_event bt_event;
 typedef struct bt_topic bt_topic;
 typedef struct bt_topic_descriptor bt_topic_descriptor;
@@ -98,6 +110,48 @@ enum bt_topic_type bt_william_hill_topic_get_type(const bt_topic *const topic);
  * @return
  */
 const char *bt_william_hill_topic_get_alias(const bt_topic *const topic);
+/**
+ * @brief Crear un nuevo registro de `bt_topic`s. El registro indexa los
+ * topics por alias con una tabla hash, de manera que insertar, buscar y quitar
+ * son O(1). Los topics pertenecen a su evento, que los guarda en una posición
+ * por cada `enum bt_topic_type`.
+ * @return El nuevo registro que deberá pasar a
+ * `bt_william_hill_topic_registry_free()`
+ */
+bt_topic_registry *bt_william_hill_topic_registry_new(void);
+/**
+ * @brief Obtener el número de items en el registro de `bt_topic`s
+ * @param registry El registro objetivo
+ * @return El número de items del registro
+ */
+size_t bt_william_hill_topic_registry_get_count(const bt_topic_registry *const registry);
+/**
+ * @brief Buscar un objeto `bt_topic` cuyo alias es `alias`
+ * @param registry El registro en el que se desea buscar
+ * @param alias El alias que debe tener el objeto buscado, no tiene que
+ * terminar en `null' (puede apuntar directamente al frame del WebSocket)
+ * @param length La longitud de `alias`
+ * @return El topic o `NULL` si no existe
+ */
+bt_topic *bt_william_hill_topic_registry_find(const bt_topic_registry *const registry, const char *const alias, size_t length);
+/**
+ * @brief Insertar un item en el registro. Falla si ya existe un topic con
+ * el mismo alias o del mismo tipo para el mismo evento.
+ * @param registry El registro objetivo
+ * @param topic El item que se desea insertar, su evento toma posesión
+ * de su memoria si la operación tiene éxito
+ * @return Si se ha logrado insertar el item
+ */
+bool bt_william_hill_topic_registry_insert(bt_topic_registry *const registry, bt_topic *const topic);
+/**
+ * @brief Quitar los items del registro, para el evento `event`. Esta función
+ * libera la memoria asociada a cada `bt_topic` y vacía la posición
+ * correspondiente en `event`, pero no libera el `event`. Recorre sólo las
+ * `TopicCount` posiciones del evento.
+ * @param registry El registro objetivo
+ * @param event El evento cuyos `bt_topic`s deseamos quitar
+ */
+void bt_william_hill_topic_registry_remove(bt_topic_registry *const registry, const bt_event *const event);
 /**
  * @brief Reestablecer el alias del `bt_topic`. Cuando se reinicia la conexión
  * no se liberan inmediatamente los eventos para no tener que
@@ -114,85 +168,83 @@ const char *bt_william_hill_topic_get_alias(const bt_topic *const topic);
  * esa memoria es liberada después del llamado a esta función el comportamiento
  * es indefinido
  *
+ * @param registry El registro que contiene al topic
  * @param topic El topic cuyo alias se reiniciará
  * @param alias El nuevo alias
  */
-void bt_william_hill_topic_reset_alias(bt_topic *topic, char *alias);
-/**
- * @brief Crear una nueva lista de `bt_topic`s
- * @return La nueva lista que deberá pasar a `bt_william_hill_topic_list_free()`
- */
-bt_topic_list *bt_william_hill_topics_list_create(void);
-/**
- * @brief Obtener el número de items en la lista de `bt_topic`s
- * @param list La lista objetivo
- * @return El número de items de la lista
- */
-size_t bt_william_hill_topic_list_get_count(const bt_topic_list *const list);
+void bt_william_hill_topic_registry_reset_alias(bt_topic_registry *const registry, bt_topic *const topic, char *alias);
 /**
- * @brief Buscar on objeto `bt_topic` cuyo alias es `alias`
- * @param list La lista en la que se desea buscar
- * @param alias El alias que debe tener el objeto buscado
- * @return
+ * @brief Liberar los recursos utilizados por un registro de `bt_topic`s. Los
+ * topics no se liberan, eso ocurre al liberar su evento.
+ * @param registry El registro cuyos recursos se desea liberar
  */
-const bt_topic *bt_william_hill_topic_list_find(const bt_topic_list *const list, const char *const alias);
+void bt_william_hill_topic_registry_free(bt_topic_registry *const registry);
 /**
- * @brief Obtener el n-ésimo item de la lista de `bt_topic`s
- * @param list La lista objetivo de la que se desea obtener el `bt_topic`
- * @param n La posición del elemento que se desea obtener
- * @return
+ * @brief Obtener el tipo de topic, a partir del nombre del mismo. Básicamente
+ * permite asociar el topic al evento pero también es útil si se desea saber
+ * qué tipo de topic es el que tiene este nombre en general
+ * @param name El nombre del topic cuyo tipo se desea determinar, no tiene que
+ * terminar en `null'
+ * @param length La longitud de `name`
+ * @return El tipo de topic o `InvalidTopic` si no hay coincidencias
  */
-bt_topic *bt_william_hill_topic_list_get_item(const bt_topic_list *const list, size_t n);
+enum bt_topic_type bt_william_hill_topic_get_type_from_description_name(const char *const name, size_t length);
 /**
- * @brief Anexar en item a la lista
- * @param list La lista objetivo
- * @param topic El item que se desea anexar
- * @return
+ * @brief Comparar la tabla hash perfecta de los nombres de los topics con la
+ * búsqueda binaria, con todos los nombres y con nombres que no existen.
+ * Escribe el tiempo promedio de cada búsqueda en la salida estándar, y el
+ * tiempo que toma construir la tabla, que se construye al empezar a usarla
+ * @return `0`, o `-1` si las dos búsquedas no coinciden
  */
-bool bt_william_hill_topic_list_append(bt_topic_list *list, bt_topic *topic);
+int bt_william_hill_topic_benchmark(void);
 /**
- * @brief Ordenar la lista en orden alfabético por `alias`
- * @param list La lista objetivo
+ * @brief Construir la lista de topics a los que se suscribe un evento en
+ * cuanto aparece, separados por `,' como los acepta el WebSocket en un solo
+ * frame. Se construye una sola vez en el hilo del proveedor.
+ * @param id El id del evento
+ * @return La lista recién alojada, que debe liberarse con `bt_free()`
  */
-void bt_william_hill_topic_list_sort(bt_topic_list *list);
+char *bt_william_hill_topics_event_subscription(int id);
 /**
- * @brief Quitar los items de la lista, para el evento `event`. Esta función
- * libera la memoria asociada al `bt_topic` pero no toca el `event`. La razón
- * es que el `event` está presente en esta estructura para este tipo de cosas
- * pero no está bajo el control de esta estructura.
- * @param list La lista objetivo
- * @param event El evento cuyos `bt_topic`s deseamos quitar
+ * @brief Pedir la suscripción a los incidentes del evento
+ * @param subscriber Quien envía la petición al WebSocket
+ * @param data Datos para `subscriber`
+ * @param event El evento de interés
  */
-void bt_william_hill_topic_list_remove(bt_topic_list *const list, const bt_event *const event);
+void bt_william_hill_topic_subscribe_incidents(bt_topic_subscriber subscriber, void *data, const bt_event *const event);
 /**
- * @brief Liberar los recursos utilizados por una lista de `bt_topic`s
- * @param list La lista cuyos recursos se desea liberar
+ * @brief Pedir la suscripción a los juegos ganados en el set actual
+ * @param subscriber Quien envía la petición al WebSocket
+ * @param data Datos para `subscriber`
+ * @param event El evento de interés
+ * @param idx El jugador
  */
-void bt_william_hill_topic_list_free(bt_topic_list *const list);
+void bt_william_hill_topic_subscribe_current_set_gameswon(bt_topic_subscriber subscriber, void *data, const bt_event *const event, enum bt_player_idx idx);
 /**
- * @brief Obtener el tipo de topic, a partir del nombre del mismo. Básicamente
- * permite asociar el topic al evento pero también es útil si se desea saber
- * qué tipo de topic es el que tiene este nombre en general
- * @param name El nombre del topic cuyo tipo se desea determinar
- * @return El tipo de topic o `InvalidTopic` si no hay coincidencias
+ * @brief Pedir la suscripción a los juegos ganados en un set anterior
+ * @param subscriber Quien envía la petición al WebSocket
+ * @param data Datos para `subscriber`
+ * @param event El evento de interés
+ * @param set El número del set
+ * @param idx El jugador
  */
-enum bt_topic_type bt_william_hill_topic_get_type_from_description_name(const char *const name);
+void bt_william_hill_topic_subscribe_previous_set(bt_topic_subscriber subscriber, void *data, const bt_event *const event, int set, enum bt_player_idx idx);
 /**
- * @brief Suscribir un evento con todos los "topics" habilitados al WebSocket.
- * Después de hacer esto, a través del WebSocket llegará toda la información
- * requerida en esta operación, justo cuando el servidor lo decida.
- * @param event El evento para suscribir
- * @param websocket La conexión de websocket a la cual suscribir el evento
- * al WebSocket qué hacer.
- * @return Si tuvo o no éxito la operación
+ * @brief Agregar topics a un frame de suscripción. Si no caben en el frame
+ * (`BT_TOPIC_BATCH_SIZE`) se envía primero lo acumulado, de manera que muchas
+ * suscripciones salen en pocas escrituras al WebSocket. Sólo puede usarlo el
+ * hilo que lee del WebSocket.
+ * @param batch El frame en construcción
+ * @param ws El WebSocket
+ * @param topics Uno o varios topics separados por `,'
+ * @return Si no falló el envío
  */
-bool bt_william_hill_topics_subscribe_event(const bt_event *event, const bt_websocket_connection *const ws);
+bool bt_william_hill_topic_batch_add(bt_string_builder *const batch, struct httpio *ws, const char *const topics);
 /**
- * @brief bt_william_hill_topic_subscribe_previous_sets
- * @param event
- * @param set
+ * @brief Enviar lo acumulado en el frame de suscripción y vaciarlo
+ * @param batch El frame en construcción
+ * @param ws El WebSocket
+ * @return Si no falló el envío
  */
-void bt_william_hill_topic_subscribe_incidents(struct httpio *const ws, bt_event * const event);
-void bt_william_hill_topic_subscribe_current_set_gameswon(struct httpio *const ws, const bt_event *const event, enum bt_player_idx idx);
-void bt_william_hill_topic_subscribe_previous_set(struct httpio *const ws, const bt_event *const event, int set, enum bt_player_idx idx);
+bool bt_william_hill_topic_batch_send(bt_string_builder *const batch, struct httpio *ws);
 #endif /* __bt_william_hill_TOPICS_H__ */
@@ -8,6 +8,7 @@
 #include <stdbool.h>
 
 #include <bt-william-hill-topics.h>
+#include <bt-latency.h>
 #include <bt-util.h>
 
 typedef struct bt_event_list bt_event_list;
@@ -16,26 +17,82 @@ typedef struct bt_websocket_connection bt_websocket_connection;
 typedef struct bt_player bt_player;
 /**
  * @brief Conectarse al websocket
+ * @param greeting Donde se almacena el saludo del servidor (ver
+ * `bt_william_hill_websocket_handshake()`)
  * @return Un objeto `httpio` que permite leer y escribir en
  * el socket directamente.
  */
-struct httpio *bt_william_hill_websocket_connect(void);
+struct httpio *bt_william_hill_websocket_connect(char **greeting);
 /**
  * @brief Realizar el saludo inicial para establecer la conexión al
  * WebSocket de forma segura <a href="https://tools.ietf.org/html/rfc6455">RFC 6455</a>
  * @param websocket La conexión de websocket para realizar el saludo
+ * @param greeting Donde se almacena una copia del primer frame del
+ * servidor, para el registro de frames. Debe ser liberada con `bt_free()`,
+ * es `NULL` si el saludo falló
  * @return Si el saludo fue un éxito o no
  */
-bool bt_william_hill_websocket_handshake(struct httpio *websocket);
+bool bt_william_hill_websocket_handshake(struct httpio *websocket, char **greeting);
+/**
+ * @brief Comprobar el primer frame que envía el servidor, la versión del
+ * protocolo y el estado de la conexión
+ * @param data El texto del frame, debe terminar en `null'
+ * @return Si la conexión fue aceptada
+ */
+bool bt_william_hill_websocket_check_handshake(const char *const data);
 /**
  * @brief Manejar un mensaje en el formato entendido por los WebSockets
- * según <a href="https://tools.ietf.org/html/rfc6455">RFC 6455</a>
- * @param websocket La conexión de websocket
- * @param context Un objeto con toda la información del contexto de
- * ejecución
+ * según <a href="https://tools.ietf.org/html/rfc6455">RFC 6455</a>. Sólo
+ * decodifica el frame, los valores de los topics se procesan en los hilos
+ * de `wsc->pipeline`
+ * @param wsc La conexión de websocket, con el contexto de ejecución
  * @return `0` cuando ha habido éxito y `-1` en caso de error
  */
-int bt_william_hill_handle_websocket_frame(struct httpio *websocket, bt_context *const context);
+int bt_william_hill_handle_websocket_frame(const bt_websocket_connection *const wsc);
+/**
+ * @brief Decodificar el texto de un frame ya leído, igual que
+ * `bt_william_hill_handle_websocket_frame()`. Si `wsc->pipeline` es `NULL`
+ * los valores se decodifican pero no se procesan, y si `wsc->ws` es `NULL`
+ * los pings no se responden
+ * @param wsc La conexión de websocket, con el contexto de ejecución
+ * @param data El texto del frame, debe terminar en `null'
+ * @param received El momento en que se recibió según
+ * `bt_william_hill_pipeline_now()`
+ * @return `0` cuando ha habido éxito y `-1` en caso de error
+ */
+int bt_william_hill_handle_frame_text(const bt_websocket_connection *const wsc, const char *const data, uint64_t received);
+/**
+ * @brief Obtener el id del partido de la ruta del topic en un frame de
+ * control, el que anuncia el alias de un topic
+ * @param data El texto del frame, debe terminar en `null'
+ * @param type Donde se almacena el tipo del topic, `InvalidTopic` si no se
+ * conoce su nombre
+ * @param value Donde se almacena el valor inicial del topic, apunta dentro
+ * de `data`
+ * @return El id, o `-1` si no es un frame de control válido
+ */
+int bt_william_hill_control_frame_get_match(const char *const data, enum bt_topic_type *type, const char **value);
+/**
+ * @brief Leer un frame de una conexión que no está suscrita a nada, y
+ * sólo responder los pings para que el servidor no la cierre
+ * @param websocket La conexión de interés
+ * @return `0` cuando ha habido éxito y `-1` en caso de error
+ */
+int bt_william_hill_websocket_keepalive(struct httpio *websocket);
+/**
+ * @brief Procesar el valor de un topic: actualizar el marcador, pedir las
+ * suscripciones que faltan y notificar los MTO. Puede hacer consultas a
+ * MySQL y peticiones a Telegram así que no debe llamarse desde el hilo
+ * que lee del WebSocket.
+ * @param event El evento al que pertenece el topic
+ * @param type El tipo de topic
+ * @param value El valor, debe terminar en `null'
+ * @param length La longitud de `value`
+ * @param trace La traza del frame, se completa si genera una notificación
+ * @param subscriber Quien envía las suscripciones al WebSocket
+ * @param data Datos para `subscriber`
+ */
+void bt_william_hill_handle_topic_value(bt_event *const event, enum bt_topic_type type, const char *const value, size_t length, bt_latency_trace *const trace, bt_topic_subscriber subscriber, void *data);
 /**
  * @brief Envolvente de la función para suscribir los eventos al WebSocket de
  * forma segura en cuanto a multi hilos.
@@ -44,14 +101,14 @@ int bt_william_hill_handle_websocket_frame(struct httpio *websocket, bt_context
  * ejecución
  */
 int bt_william_hill_subscribe_events(const bt_websocket_connection *const websocket, bt_context *const context);
+bool bt_william_hill_use_tor(void);
 /**
- * @brief bt_william_hill_score_to_str Generar una cadena con el resultado del partido
- * @param event El evento en cuestión
- * @param home El jugador de casa
- * @param away El jugador visitante
- * @return Una cadena alojada con `bt_malloc` que debe ser desalojada con `bt_free`.
+ * @brief Pasar frames de control y de datos de ejemplo por el decodificador
+ * y escribir en la salida estándar cuántas veces se llamó `bt_malloc()` y
+ * similares (`bt_memory_thread_allocations()`) por frame: al decodificarlo
+ * como antes de separarlo en el mismo buffer, al decodificarlo ahora, y en
+ * todo el manejador. No usa la red ni la base de datos
+ * @return `0`, o `-1` si no se pudo crear el contexto
  */
-char *bt_william_hill_score_to_str(const bt_event *const event, bt_player *const victim, bt_player *const oponent);
-
-bool bt_william_hill_use_tor(void);
+int bt_william_hill_tokenizer_benchmark(void);
 #endif /* __bt_william_hill_H__ */
@@ -1,5 +1,7 @@
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
 #include <signal.h>
@@ -16,16 +18,85 @@
 #include <bt-channel-settings.h>
 #include <bt-private.h>
 
+#include <bt-spsc-queue.h>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
 #include <execinfo.h>
 
-pthread_mutex_t GLOBAL_MUTEX = PTHREAD_MUTEX_INITIALIZER;
+// The maximum number of changes in flight between the provider and
+// the listener, if it fills up the provider retries on the next scrape
+#define BT_EVENT_CHANGES_CAPACITY 256
+
+enum bt_event_change_type {
+    EventAdded,
+    EventRemoved
+};
+
+typedef struct bt_event_change {
+    enum bt_event_change_type type;
+    // Only for `EventAdded`, it belongs to the change until adopted
+    bt_event *event;
+    int id;
+} bt_event_change;
 
 typedef struct bt_context {
+    // Owned by the listener thread
     bt_event_list *events;
-    bt_topic_list *topics;
+    bt_topic_registry *topics;
+    // Who takes the events removed from the list, they are freed
+    // right away if nobody does
+    bt_context_event_release release;
+    void *release_data;
+    // Shared, the queue is single producer (the provider) and single
+    // consumer (the listener), `notify` is an eventfd signaled when
+    // new changes are pushed
+    bt_spsc_queue *changes;
+    int notify;
+    // A change that could not be forwarded because it's target
+    // queue was full, owned by the consumer
+    bt_event_change *pending;
+    // Shared, the other way around: the listener (or the thread that
+    // forwards for the listeners) tells the provider which events it
+    // dropped on it's own, when the server removed their topics
+    bt_spsc_queue *dropped;
+    // A dropped event that could not be forwarded to the provider
+    // because it's queue was full, owned by the forwarding thread
+    bt_event_change *undelivered;
     bool running;
+    // Owned by the provider thread, sorted ids of the events that
+    // were handed to the listener
+    int *published;
+    size_t npublished;
 } bt_context;
 
+static void
+bt_event_change_free(bt_event_change *change)
+{
+    if (change == NULL)
+        return;
+    bt_william_hill_event_free(change->event);
+    bt_free(change);
+}
+
+static bool
+bt_context_push_event_change(bt_spsc_queue *const queue,
+                   enum bt_event_change_type type, bt_event *event, int id)
+{
+    bt_event_change *change;
+    change = bt_malloc(sizeof(*change));
+    if (change == NULL)
+        return false;
+    change->type = type;
+    change->event = event;
+    change->id = id;
+    if (bt_spsc_queue_push(queue, change) == true)
+        return true;
+    // The queue is full, the caller keeps ownership of `event`
+    bt_free(change);
+    return false;
+}
 
 bt_context *
 bt_create_context(void)
@@ -38,7 +109,16 @@ bt_create_context(void)
     // Fill the structure
     context->events = bt_william_hill_event_list_new();
     context->running = true;
-    context->topics = bt_william_hill_topics_list_create();
+    context->topics = bt_william_hill_topic_registry_new();
+    context->release = NULL;
+    context->release_data = NULL;
+    context->changes = bt_spsc_queue_new(BT_EVENT_CHANGES_CAPACITY);
+    context->notify = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    context->pending = NULL;
+    context->dropped = bt_spsc_queue_new(BT_EVENT_CHANGES_CAPACITY);
+    context->undelivered = NULL;
+    context->published = NULL;
+    context->npublished = 0;
     // Return the newly allocated context
     return context;
 }
@@ -49,10 +129,29 @@ bt_context_free(bt_context *context)
     // Behave correctly
     if (context == NULL)
         return;
-    // Release events resources
+    // Release the topics registry, topics belong to the events
+    bt_william_hill_topic_registry_free(context->topics);
+    // Release events (and their topics) resources
     bt_william_hill_event_list_free(context->events);
-    // Release topics resources
-    bt_william_hill_topic_list_free(context->topics);
+    // Release the changes that were never adopted, if any
+    if (context->changes != NULL) {
+        bt_event_change *change;
+        while ((change = bt_spsc_queue_pop(context->changes)) != NULL)
+            bt_event_change_free(change);
+        bt_spsc_queue_free(context->changes);
+    }
+    bt_event_change_free(context->pending);
+    // And the events dropped by the listener that were never reported
+    if (context->dropped != NULL) {
+        bt_event_change *change;
+        while ((change = bt_spsc_queue_pop(context->dropped)) != NULL)
+            bt_event_change_free(change);
+        bt_spsc_queue_free(context->dropped);
+    }
+    bt_event_change_free(context->undelivered);
+    if (context->notify != -1)
+        close(context->notify);
+    bt_free(context->published);
     // Free the context object
     bt_free(context);
 }
@@ -75,19 +174,276 @@ void
 bt_transfer_new_bt_william_hill_events(bt_context *const context,
                                              bt_event_list *const events)
 {
-    // Sanity check
-    if (context->events == NULL)
+    size_t npublished;
+    int *published;
+    size_t pushed;
+    size_t index;
+    size_t jndex;
+    bool dropped;
+    // Both `events` and the published ids must be sorted to walk
+    // them side by side
+    bt_william_hill_event_list_sort(events);
+    // The new set of published ids can't be larger than this
+    published = bt_malloc((bt_william_hill_event_list_get_count(events) +
+                                      context->npublished) * sizeof(*published));
+    if (published == NULL) {
+        bt_william_hill_event_list_free(events);
+        return;
+    }
+    npublished = 0;
+    pushed = 0;
+    dropped = false;
+    index = 0;
+    jndex = 0;
+    while ((index < bt_william_hill_event_list_get_count(events)) ||
+                                               (jndex < context->npublished)) {
+        bt_event *event;
+        int id;
+        event = NULL;
+        if (index < bt_william_hill_event_list_get_count(events))
+            event = bt_william_hill_event_list_get_item(events, index);
+        id = bt_william_hill_event_get_id(event);
+        if ((jndex == context->npublished) ||
+                          ((event != NULL) && (id < context->published[jndex]))) {
+            // It's a new event, hand it over to the listener
+            event = bt_william_hill_event_list_take(events, index);
+            if (bt_context_push_event_change(context->changes, EventAdded, event, id) == true) {
+                published[npublished++] = id;
+                pushed += 1;
+            } else {
+                // Retry on the next scrape
+                bt_william_hill_event_free(event);
+                dropped = true;
+            }
+        } else if ((event == NULL) || (context->published[jndex] < id)) {
+            id = context->published[jndex++];
+            // It's gone from the site. An empty page is more likely
+            // a scraping problem than no matches at all, so don't
+            // remove anything in that case
+            if (bt_william_hill_event_list_get_count(events) == 0) {
+                published[npublished++] = id;
+            } else if (bt_context_push_event_change(context->changes, EventRemoved, NULL, id) == true) {
+                pushed += 1;
+            } else {
+                // Retry on the next scrape
+                published[npublished++] = id;
+                dropped = true;
+            }
+        } else {
+            // Already known to the listener
+            published[npublished++] = id;
+            index += 1;
+            jndex += 1;
+        }
+    }
+    // Replace the published ids
+    bt_free(context->published);
+    context->published = published;
+    context->npublished = npublished;
+    // Release the events that were already known
+    bt_william_hill_event_list_free(events);
+    // The next scrape must bring the page even if it didn't change, or
+    // what was dropped here is never retried
+    if (dropped == true)
+        bt_william_hill_events_list_invalidate();
+    // Wake up the listener
+    if ((pushed != 0) && (context->notify != -1))
+        eventfd_write(context->notify, 1);
+}
+
+static int
+bt_context_compare_ids(const void *const lhs, const void *const rhs)
+{
+    int left;
+    int right;
+    left = *(const int *) lhs;
+    right = *(const int *) rhs;
+    return (left > right) - (left < right);
+}
+
+size_t
+bt_context_collect_dropped_events(bt_context *const context)
+{
+    bt_event_change *change;
+    size_t count;
+    count = 0;
+    while ((change = bt_spsc_queue_pop(context->dropped)) != NULL) {
+        int *found;
+        found = NULL;
+        if (context->npublished != 0) {
+            found = bsearch(&change->id, context->published, context->npublished,
+                                 sizeof(*context->published), bt_context_compare_ids);
+        }
+        // It might have left the page in the meantime, then the
+        // provider has already forgotten it
+        if (found != NULL) {
+            memmove(found, found + 1, (context->published +
+                            context->npublished - found - 1) * sizeof(*found));
+            context->npublished -= 1;
+            count += 1;
+        }
+        bt_event_change_free(change);
+    }
+    // The page probably didn't change, but it must be parsed again for
+    // the dropped events to be published again
+    if (count != 0)
+        bt_william_hill_events_list_invalidate();
+    return count;
+}
+
+static void
+bt_context_remove_event(bt_context *const context, bt_event *event)
+{
+    // Remove the topics for this event
+    bt_william_hill_topic_registry_remove(context->topics, event);
+    // Remove the event from the list too
+    event = bt_william_hill_event_list_detach(context->events, event);
+    if (event == NULL)
         return;
-    // Attempt to merge the events
-    bt_william_hill_event_list_merge(context->events, events);
+    // Frames for this event might still be in flight somewhere else,
+    // let the owner of those decide when to free it
+    if (context->release != NULL) {
+        context->release(event, context->release_data);
+    } else {
+        bt_william_hill_event_free(event);
+    }
+}
+
+void
+bt_context_set_event_release(bt_context *const context,
+                              bt_context_event_release release, void *data)
+{
+    context->release = release;
+    context->release_data = data;
+}
+
+size_t
+bt_context_adopt_events(bt_context *const context)
+{
+    bt_event_change *change;
+    eventfd_t value;
+    size_t count;
+    bool sorted;
+    // Reset the notification, the queue is drained completely below
+    if (context->notify != -1)
+        eventfd_read(context->notify, &value);
+    count = 0;
+    sorted = true;
+    while ((change = bt_spsc_queue_pop(context->changes)) != NULL) {
+        bt_event *event;
+        switch (change->type) {
+        case EventAdded:
+            // The provider only publishes an event again after this
+            // thread reported it dropped, so it's not in the list. But
+            // never keep two events with the same id
+            if (bt_william_hill_event_list_find(context->events, change->id) != NULL)
+                break;
+            // The list takes the event, it's subscribed in the next pass
+            bt_william_hill_event_list_append(context->events, change->event);
+            bt_william_hill_event_list_mark_dirty(context->events, change->event);
+            change->event = NULL;
+            sorted = false;
+            break;
+        case EventRemoved:
+            // Binary search needs the list sorted
+            if (sorted == false)
+                bt_william_hill_event_list_sort(context->events);
+            sorted = true;
+            event = bt_william_hill_event_list_find(context->events, change->id);
+            if (event != NULL)
+                bt_context_remove_event(context, event);
+            break;
+        }
+        bt_event_change_free(change);
+        count += 1;
+    }
+    // Sort it in order for binary search to work on subsequent calls
+    if (sorted == false)
+        bt_william_hill_event_list_sort(context->events);
+    return count;
+}
+
+static size_t
+bt_context_jump_hash(uint64_t key, size_t buckets)
+{
+    int64_t bucket;
+    int64_t next;
+    // Lamping and Veach's jump consistent hash, only 1/N of the keys
+    // move when a bucket is added
+    bucket = -1;
+    next = 0;
+    while (next < (int64_t) buckets) {
+        bucket = next;
+        key = key * 2862933555777941757ULL + 1;
+        next = (bucket + 1) * ((double) (1LL << 31) / (double) ((key >> 33) + 1));
+    }
+    return bucket;
+}
+
+size_t
+bt_context_forward_events(bt_context *const context,
+                             bt_context *const *const targets, size_t count)
+{
+    bt_event_change *change;
+    eventfd_t value;
+    size_t forwarded;
+    // Reset the notification, the queue is drained below unless a
+    // target is full, in that case the rest waits for the next call
+    if (context->notify != -1)
+        eventfd_read(context->notify, &value);
+    forwarded = 0;
+    for (;;) {
+        bt_context *target;
+        change = context->pending;
+        if (change == NULL)
+            change = bt_spsc_queue_pop(context->changes);
+        if (change == NULL)
+            break;
+        context->pending = NULL;
+        // Every change for a match goes to the same target
+        target = targets[bt_context_jump_hash(change->id, count)];
+        if (bt_spsc_queue_push(target->changes, change) == false) {
+            context->pending = change;
+            break;
+        }
+        if (target->notify != -1)
+            eventfd_write(target->notify, 1);
+        forwarded += 1;
+    }
+    // And the other way around, the events dropped by the targets go
+    // back to the provider
+    for (size_t idx = 0; idx < count; ++idx) {
+        for (;;) {
+            change = context->undelivered;
+            if (change == NULL)
+                change = bt_spsc_queue_pop(targets[idx]->dropped);
+            if (change == NULL)
+                break;
+            context->undelivered = NULL;
+            if (bt_spsc_queue_push(context->dropped, change) == false) {
+                // Try again on the next call
+                context->undelivered = change;
+                return forwarded;
+            }
+        }
+    }
+    return forwarded;
+}
+
+int
+bt_context_get_events_fd(const bt_context *const context)
+{
+    return context->notify;
 }
 
 void
 bt_context_stop(bt_context *const context)
 {
-    bt_global_lock();
-    context->running = false;
-    bt_global_unlock();
+    __atomic_store_n(&context->running, false, __ATOMIC_RELEASE);
+    // Wake up the thread waiting on the events descriptor, so it
+    // notices right away. It's safe from a signal handler too
+    if (context->notify != -1)
+        eventfd_write(context->notify, 1);
 }
 
 bt_event_list *
@@ -101,52 +457,33 @@ bt_context_remove_bt_william_hill_topic(bt_context *const context,
                                              const bt_topic *const topic)
 {
     bt_event *event;
-    // Get the event associated to this topic
+    int id;
     event = bt_william_hill_topic_get_event(topic);
-    // Remove the topics for this event
-    bt_william_hill_topic_list_remove(context->topics, event);
-    // Remove the event from the list too
-    bt_william_hill_event_list_remove(context->events, event);
+    id = bt_william_hill_event_get_id(event);
+    // Remove the event associated to this topic, and all it's topics
+    bt_context_remove_event(context, event);
+    // The provider still counts it as published, tell it so the event is
+    // handed over again if it's still on the page
+    if (bt_context_push_event_change(context->dropped, EventRemoved, NULL, id) == false)
+        log("warning: the provider won't publish match \033[34m%d\033[0m again\n", id);
 }
 
 bt_topic *
 bt_find_topic_for_event(const bt_context *const ctx, int match, int type)
 {
-    bt_topic_list *topics;
-    size_t count;
-    // Make a pointer to the topics list
-    topics = ctx->topics;
-    if (topics == NULL)
+    bt_event *event;
+    // Find the event, it holds a slot for each type of topic
+    event = bt_william_hill_event_list_find(ctx->events, match);
+    if (event == NULL)
         return NULL;
-    // Get the count of topics in the list
-    count = bt_william_hill_topic_list_get_count(topics);
-    // Iterate through all the topics
-    for (size_t idx = 0; idx < count; ++idx) {
-        bt_topic *topic;
-        bt_event *event;
-        // Make a pointer to the current item
-        topic = bt_william_hill_topic_list_get_item(topics, idx);
-        if (topic == NULL)
-            return NULL;
-        // Check if it's the appropriate type
-        if (bt_william_hill_topic_get_type(topic) != type)
-            continue;
-        // Make a pointer to the corresponding event
-        event = bt_william_hill_topic_get_event(topic);
-        // Check if it's the event we are searching for
-        if (bt_william_hill_event_get_id(event) != match)
-            continue;
-        // It was, so return this object
-        return topic;
-    }
-    // Not found so return `NULL`
-    return NULL;
+    return bt_william_hill_event_get_topic(event, type);
 }
 
 void
-bt_context_sort_topics(bt_context *const context)
+bt_context_reset_topic_alias(bt_context *const context,
+                                               bt_topic *const topic, char *alias)
 {
-    bt_william_hill_topic_list_sort(context->topics);
+    bt_william_hill_topic_registry_reset_alias(context->topics, topic, alias);
 }
 
 bool
@@ -155,16 +492,16 @@ bt_context_append_topic(bt_context *const context,
 {
     if (topic == NULL)
         return false;
-    if (bt_william_hill_topic_list_append(context->topics, topic) == false)
+    if (bt_william_hill_topic_registry_insert(context->topics, topic) == false)
         return false;
     return true;
 }
 
 const bt_topic *
 bt_william_hill_find_topic(const bt_context *const context,
-                                                           const char *const id)
+                                          const char *const id, size_t length)
 {
-    return bt_william_hill_topic_list_find(context->topics, id);
+    return bt_william_hill_topic_registry_find(context->topics, id, length);
 }
 
 void
@@ -176,15 +513,8 @@ bt_unsubscribe_events(bt_context *const context)
 bool
 bt_isrunning(const bt_context *const context)
 {
-    bool running;
-    // Lock the mutex to make this thread safe
-    bt_global_lock();
-    // Store the value to unlock the mutex before return
-    running = context->running;
-    // Unlock the mutex
-    bt_global_unlock();
-    // Return the new value
-    return running;
+    // Every thread polls this, so it must not contend for a lock
+    return __atomic_load_n(&context->running, __ATOMIC_ACQUIRE);
 }
 
 #ifdef _DEBUG
@@ -205,14 +535,3 @@ bt_print_backtrace(void)
 }
 #endif
 
-void
-bt_global_lock()
-{
-    pthread_mutex_lock(&GLOBAL_MUTEX);
-}
-
-void
-bt_global_unlock()
-{
-    pthread_mutex_unlock(&GLOBAL_MUTEX);
-}
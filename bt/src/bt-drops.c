@@ -5,6 +5,7 @@
 #include <bt-memory.h>
 
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 
 typedef struct bt_drop {
@@ -61,14 +62,17 @@ bt_new_drop_message_link(const char *const iid)
 }
 
 static int
-bt_drops_get_message_id(const char *const channel, int link)
+bt_drops_get_message_id(const char *const channel, void *data)
 {
     int id;
+    int link;
     const char *query;
     MYSQL_STMT *stmt;
     query = "SELECT id FROM mercado_ganador_partido_telegram_ids "
             "WHERE link = ? AND channel = ?";
     id = -1;
+    // The link travels in the pointer
+    link = (int) (intptr_t) data;
     stmt = bt_mysql_easy_query(query, "%d%s|%d", &link, channel, &id);
     if (stmt == NULL)
         return -1;
@@ -80,10 +84,15 @@ bt_drops_get_message_id(const char *const channel, int link)
 }
 
 static void
-bt_drops_set_message_id(const char *const channel, int link, int id)
+bt_drops_set_message_id(const char *const channel,
+                                            int previous, int id, void *data)
 {
     const char *query;
     MYSQL_STMT *stmt;
+    int link;
+    if (id == previous)
+        return;
+    link = (int) (intptr_t) data;
     query = "INSERT INTO mercado_ganador_partido_telegram_ids "
             "(link, channel, id) VALUES (?, ?, ?)";
     stmt = bt_mysql_easy_query(query, "%d%s%d", &link, channel, &id);
@@ -97,10 +106,19 @@ static void
 bt_drops_send_any(const char *const format, bt_drop *up, bt_drop *down, int link,
          const char *const tour, bt_tennis_category category, double value)
 {
+    bt_telegram_notification *notification;
     size_t chcount;
+    // The text is the same for every channel
+    notification = bt_telegram_notification_new(format, value, tour,
+          up->name, up->previous, up->current, down->name, down->previous, down->current);
+    if (notification == NULL)
+        return;
+    // Each channel has it's own message id for this drop, the sender
+    // looks it up and saves the new one
+    bt_telegram_notification_set_callbacks(notification,
+        bt_drops_get_message_id, bt_drops_set_message_id, (void *) (intptr_t) link);
     chcount = bt_channel_settings_count();
     for (size_t idx = 0; idx < chcount; ++idx) {
-        int telegram;
         char channel[100];
         int result;
         if (bt_channel_settings_get_super_drops(category, idx) == false)
@@ -108,13 +126,9 @@ bt_drops_send_any(const char *const format, bt_drop *up, bt_drop *down, int link
         result = bt_channel_settings_get_id(channel, sizeof(channel), idx);
         if ((result < 0) || (result >= sizeof(channel)))
             continue;
-        telegram = bt_drops_get_message_id(channel, link);
-        result = bt_telegram_edit_message(telegram, channel, format, value, tour,
-                    up->name, up->previous, up->current, down->name, down->previous, down->current);
-        if (result == telegram)
-            continue;
-        bt_drops_set_message_id(channel, link, result);
+        bt_telegram_notification_add_channel(notification, channel, -1);
     }
+    bt_telegram_notification_post(notification);
 }
 
 static void
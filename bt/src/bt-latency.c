@@ -0,0 +1,265 @@
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <pthread.h>
+
+#include <bt-latency.h>
+#include <bt-string-builder.h>
+#include <bt-memory.h>
+
+// Each power of 2 is split in 2^3 buckets
+#define BT_LATENCY_SUB_BITS 3
+#define BT_LATENCY_SUB_COUNT (1 << BT_LATENCY_SUB_BITS)
+#define BT_LATENCY_BUCKETS ((64 - BT_LATENCY_SUB_BITS + 1) * BT_LATENCY_SUB_COUNT)
+// The slowest traces kept, and for how long
+#define BT_LATENCY_SLOWEST 16
+#define BT_LATENCY_SLOWEST_WINDOW 900000000000ULL
+
+// One for the time between each pair of marks, and one for all of them
+#define BT_LATENCY_STAGES LatencyMarkCount
+
+typedef struct bt_latency_histogram {
+    uint64_t buckets[BT_LATENCY_BUCKETS];
+    uint64_t count;
+    uint64_t max;
+} bt_latency_histogram;
+
+typedef struct bt_latency_slow {
+    bt_latency_trace trace;
+    char channel[32];
+} bt_latency_slow;
+
+static const char *const StageNames[BT_LATENCY_STAGES] = {
+    "total", "parse", "resolve", "classify", "lookup", "send", "telegram"
+};
+
+// Updated with atomics, traces finish in the sender threads
+static bt_latency_histogram Histograms[BT_LATENCY_STAGES];
+// Traces are rare (one per notification), a lock is fine here
+static pthread_mutex_t SlowestMutex = PTHREAD_MUTEX_INITIALIZER;
+static bt_latency_slow Slowest[BT_LATENCY_SLOWEST];
+static size_t SlowestCount;
+
+static uint64_t
+bt_latency_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static size_t
+bt_latency_bucket(uint64_t value)
+{
+    int exponent;
+    // Small values have a bucket each
+    if (value < BT_LATENCY_SUB_COUNT)
+        return value;
+    exponent = 63 - __builtin_clzll(value);
+    return (exponent - BT_LATENCY_SUB_BITS + 1) * BT_LATENCY_SUB_COUNT +
+          ((value >> (exponent - BT_LATENCY_SUB_BITS)) & (BT_LATENCY_SUB_COUNT - 1));
+}
+
+static uint64_t
+bt_latency_bucket_limit(size_t bucket)
+{
+    size_t shift;
+    uint64_t lower;
+    if (bucket < BT_LATENCY_SUB_COUNT)
+        return bucket;
+    // The inverse of `bt_latency_bucket()`, the largest value in it
+    shift = bucket / BT_LATENCY_SUB_COUNT - 1;
+    lower = (uint64_t) (BT_LATENCY_SUB_COUNT + bucket % BT_LATENCY_SUB_COUNT) << shift;
+    return lower + ((uint64_t) 1 << shift) - 1;
+}
+
+static void
+bt_latency_histogram_add(bt_latency_histogram *const histogram, uint64_t value)
+{
+    uint64_t max;
+    __atomic_fetch_add(&histogram->buckets[bt_latency_bucket(value)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram->count, 1, __ATOMIC_RELAXED);
+    max = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+    while ((value > max) && (__atomic_compare_exchange_n(&histogram->max,
+                   &max, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED) == false))
+        ;
+}
+
+static uint64_t
+bt_latency_histogram_percentile(const bt_latency_histogram *const histogram,
+                                                  uint64_t count, double fraction)
+{
+    uint64_t rank;
+    uint64_t seen;
+    uint64_t max;
+    // The first bucket that reaches the rank, it's limit is the value
+    // unless it's above what was really observed
+    max = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+    rank = (uint64_t) (fraction * count + 0.5);
+    if (rank == 0)
+        rank = 1;
+    seen = 0;
+    for (size_t idx = 0; idx < BT_LATENCY_BUCKETS; ++idx) {
+        seen += __atomic_load_n(&histogram->buckets[idx], __ATOMIC_RELAXED);
+        if (seen >= rank)
+            return (bt_latency_bucket_limit(idx) < max) ? bt_latency_bucket_limit(idx) : max;
+    }
+    return max;
+}
+
+void
+bt_latency_trace_start(bt_latency_trace *const trace, uint64_t received)
+{
+    memset(trace, 0, sizeof(*trace));
+    trace->marks[LatencyReceived] = received;
+    trace->event = -1;
+}
+
+void
+bt_latency_trace_mark(bt_latency_trace *const trace, enum bt_latency_mark mark)
+{
+    if (trace == NULL)
+        return;
+    trace->marks[mark] = bt_latency_now();
+}
+
+static uint64_t
+bt_latency_trace_total(const bt_latency_trace *const trace)
+{
+    return trace->marks[LatencyAnswered] - trace->marks[LatencyReceived];
+}
+
+static void
+bt_latency_slowest_add(const bt_latency_trace *const trace,
+                                                     const char *const channel)
+{
+    bt_latency_slow *slot;
+    uint64_t now;
+    uint64_t total;
+    size_t idx;
+    now = trace->marks[LatencyAnswered];
+    total = bt_latency_trace_total(trace);
+    pthread_mutex_lock(&SlowestMutex);
+    // Forget the ones that are not recent anymore
+    for (idx = 0; idx < SlowestCount; ) {
+        if (now - Slowest[idx].trace.marks[LatencyAnswered] < BT_LATENCY_SLOWEST_WINDOW) {
+            idx += 1;
+        } else {
+            Slowest[idx] = Slowest[--SlowestCount];
+        }
+    }
+    slot = NULL;
+    if (SlowestCount < BT_LATENCY_SLOWEST) {
+        slot = &Slowest[SlowestCount++];
+    } else {
+        // Replace the fastest, if this one is slower
+        slot = &Slowest[0];
+        for (idx = 1; idx < SlowestCount; ++idx) {
+            if (bt_latency_trace_total(&Slowest[idx].trace) < bt_latency_trace_total(&slot->trace))
+                slot = &Slowest[idx];
+        }
+        if (bt_latency_trace_total(&slot->trace) >= total)
+            slot = NULL;
+    }
+    if (slot != NULL) {
+        slot->trace = *trace;
+        snprintf(slot->channel, sizeof(slot->channel), "%s", channel);
+    }
+    pthread_mutex_unlock(&SlowestMutex);
+}
+
+static bool
+bt_latency_trace_add(const bt_latency_trace *const trace, enum bt_latency_mark last)
+{
+    // A stage that was skipped would count as a huge delay
+    for (size_t idx = 0; idx <= last; ++idx) {
+        if (trace->marks[idx] == 0)
+            return false;
+    }
+    bt_latency_histogram_add(&Histograms[0],
+                       trace->marks[last] - trace->marks[LatencyReceived]);
+    for (size_t idx = 1; idx <= last; ++idx)
+        bt_latency_histogram_add(&Histograms[idx], trace->marks[idx] - trace->marks[idx - 1]);
+    return true;
+}
+
+void
+bt_latency_trace_finish(const bt_latency_trace *const trace,
+                                                     const char *const channel)
+{
+    if (bt_latency_trace_add(trace, LatencyAnswered) == false)
+        return;
+    bt_latency_slowest_add(trace, channel);
+}
+
+void
+bt_latency_trace_finish_partial(const bt_latency_trace *const trace,
+                                                    enum bt_latency_mark last)
+{
+    bt_latency_trace_add(trace, last);
+}
+
+static int
+bt_latency_compare_slow(const void *const lhs, const void *const rhs)
+{
+    uint64_t left;
+    uint64_t right;
+    left = bt_latency_trace_total(&((const bt_latency_slow *) lhs)->trace);
+    right = bt_latency_trace_total(&((const bt_latency_slow *) rhs)->trace);
+    // Slowest first
+    return (left < right) - (left > right);
+}
+
+char *
+bt_latency_report(void)
+{
+    bt_latency_slow slowest[BT_LATENCY_SLOWEST];
+    bt_string_builder *builder;
+    size_t count;
+    char *report;
+    builder = bt_string_builder_new();
+    if (builder == NULL)
+        return NULL;
+    bt_string_builder_printf(builder, "%-9s %8s %10s %10s %10s %10s (ms)\n",
+                                   "stage", "count", "p50", "p90", "p99", "max");
+    for (size_t idx = 0; idx < BT_LATENCY_STAGES; ++idx) {
+        const bt_latency_histogram *histogram;
+        uint64_t total;
+        histogram = &Histograms[idx];
+        total = __atomic_load_n(&histogram->count, __ATOMIC_RELAXED);
+        if (total == 0)
+            continue;
+        bt_string_builder_printf(builder, "%-9s %8llu %10.3f %10.3f %10.3f %10.3f\n",
+                  StageNames[idx], (unsigned long long) total,
+                       1.0E-6 * bt_latency_histogram_percentile(histogram, total, 0.50),
+                       1.0E-6 * bt_latency_histogram_percentile(histogram, total, 0.90),
+                       1.0E-6 * bt_latency_histogram_percentile(histogram, total, 0.99),
+                            1.0E-6 * __atomic_load_n(&histogram->max, __ATOMIC_RELAXED));
+    }
+    // Copy them, so the senders don't wait while we format
+    pthread_mutex_lock(&SlowestMutex);
+    count = SlowestCount;
+    memcpy(slowest, Slowest, count * sizeof(*slowest));
+    pthread_mutex_unlock(&SlowestMutex);
+    qsort(slowest, count, sizeof(*slowest), bt_latency_compare_slow);
+    if (count > 0)
+        bt_string_builder_printf(builder, "\nslowest, last %llu minutes (ms)\n",
+                                 BT_LATENCY_SLOWEST_WINDOW / 60000000000ULL);
+    for (size_t idx = 0; idx < count; ++idx) {
+        const bt_latency_trace *trace;
+        trace = &slowest[idx].trace;
+        bt_string_builder_printf(builder, "%10.3f  event %d, channel %s:",
+                      1.0E-6 * bt_latency_trace_total(trace), trace->event, slowest[idx].channel);
+        for (size_t mark = 1; mark < LatencyMarkCount; ++mark) {
+            bt_string_builder_printf(builder, " %s %.3f", StageNames[mark],
+                                1.0E-6 * (trace->marks[mark] - trace->marks[mark - 1]));
+        }
+        bt_string_builder_printf(builder, "\n");
+    }
+    report = bt_string_builder_take_string(builder);
+    bt_string_builder_free(builder);
+    return report;
+}
@@ -19,7 +19,10 @@
 #include <http-protocol.h>
 
 #include <bt-william-hill-main.h>
+#include <bt-william-hill.h>
+#include <bt-william-hill-replay.h>
 #include <bt-mbet.h>
+#include <bt-mbet-feed.h>
 #include <bt-pinnacle.h>
 
 #include <bt-daemon.h>
@@ -104,9 +107,22 @@ static bt_thread threads[] = {
     /*{-1, bt_pinnacle_main               , "Pinnacle Odds Feed"}*/
 };
 
+static void
+bt_stop_threads(size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        bt_thread *T;
+        T = &threads[i];
+        pthread_kill(T->thread, SIGTERM);
+        pthread_join(T->thread, NULL);
+    }
+}
+
 static int
 bt_main(void)
 {
+    size_t started;
+    started = 0;
     if (bt_channel_settings_count() == 0) {
         fprintf(stderr, "error: no hay canales configurados, abortando\n");
     } else {
@@ -116,23 +132,25 @@ bt_main(void)
         if (context == NULL)
             return -1;
         srand(time(NULL));
-        for (size_t i = 0; i < countof(threads); ++i) {
+        // Notifications are sent from their own threads, so the feeds
+        // never wait for api.telegram.org
+        if (bt_telegram_dispatcher_start() == false)
+            log("warning: sending telegram notifications synchronously\n");
+        for (started = 0; started < countof(threads); ++started) {
             bt_thread *T;
-            T = &threads[i];
-            if (pthread_create(&T->thread, NULL, T->start, context) == 0)
-                continue;
-            goto failure;
+            T = &threads[started];
+            if (pthread_create(&T->thread, NULL, T->start, context) != 0)
+                goto failure;
         }
         if (bt_start_daemon(context) == -1)
             goto failure;
-        for (ssize_t i = 0; i < countof(threads); ++i) {
-            bt_thread *T;
-            T = &threads[i];
-            pthread_kill(T->thread, SIGTERM);
-            pthread_join(T->thread, NULL);
-        }
     }
 failure:
+    // The threads post notifications, they must be gone before
+    // the senders are
+    bt_stop_threads(started);
+    // Deliver the pending notifications
+    bt_telegram_dispatcher_stop();
     bt_context_free(context);
     return 0;
 }
@@ -140,7 +158,7 @@ failure:
 int
 usage(const char *const program)
 {
-    fprintf(stderr, "Uso: %s {start|stop}\n", program);
+    fprintf(stderr, "Uso: %s {start|stop|latency|schedule|mbet-bench FEED...|wh-tokenizer-bench|wh-topics-bench|wh-replay FILE [--realtime]}\n", program);
     return -1;
 }
 
@@ -281,6 +299,23 @@ start(int argc, char **argv)
         }
     } else if (strcmp(argv[1], "stop") == 0) {
         bt_stop_daemon();
+    } else if (strcmp(argv[1], "latency") == 0) {
+        bt_query_daemon_latency();
+    } else if (strcmp(argv[1], "schedule") == 0) {
+        bt_query_daemon_schedule();
+    } else if (strcmp(argv[1], "mbet-bench") == 0) {
+        if (argc < 3)
+            return usage(argv[0]);
+        bt_mbet_feed_benchmark(argv + 2, argc - 2);
+    } else if (strcmp(argv[1], "wh-tokenizer-bench") == 0) {
+        bt_william_hill_tokenizer_benchmark();
+    } else if (strcmp(argv[1], "wh-topics-bench") == 0) {
+        bt_william_hill_topic_benchmark();
+    } else if (strcmp(argv[1], "wh-replay") == 0) {
+        if (argc < 3)
+            return usage(argv[0]);
+        bt_william_hill_replay(argv[2],
+                       (argc > 3) && (strcmp(argv[3], "--realtime") == 0));
     } else {
         return usage(argv[0]);
     }
@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <bt-match-state.h>
+
+static void
+bt_match_state_begin(bt_match_state *const state)
+{
+    // Odd while writing, readers retry if they see it
+    __atomic_store_n(&state->version, state->version + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void
+bt_match_state_end(bt_match_state *const state)
+{
+    __atomic_store_n(&state->version, state->version + 1, __ATOMIC_RELEASE);
+}
+
+static void
+bt_match_state_store(int8_t *const target, int value)
+{
+    // Values that don't fit are not valid scores
+    if ((value < INT8_MIN) || (value > INT8_MAX))
+        value = -1;
+    __atomic_store_n(target, (int8_t) value, __ATOMIC_RELAXED);
+}
+
+void
+bt_match_state_reset(bt_match_state *const state)
+{
+    bt_match_state_begin(state);
+    bt_match_state_store(&state->current_set, -1);
+    bt_match_state_store(&state->serving, -1);
+    for (size_t idx = 0; idx < 2; ++idx) {
+        bt_match_state_store(&state->points[idx], 0);
+        for (size_t set = 0; set < BT_MATCH_STATE_SETS; ++set)
+            bt_match_state_store(&state->games[idx][set], 0);
+    }
+    bt_match_state_end(state);
+}
+
+void
+bt_match_state_set_games(bt_match_state *const state,
+                                               size_t idx, int set, int games)
+{
+    if ((idx > 1) || (set < 0) || (set >= BT_MATCH_STATE_SETS))
+        return;
+    bt_match_state_begin(state);
+    bt_match_state_store(&state->games[idx][set], games);
+    bt_match_state_end(state);
+}
+
+void
+bt_match_state_set_points(bt_match_state *const state, size_t idx, int points)
+{
+    if (idx > 1)
+        return;
+    bt_match_state_begin(state);
+    bt_match_state_store(&state->points[idx], points);
+    bt_match_state_end(state);
+}
+
+void
+bt_match_state_set_current_set(bt_match_state *const state, int set)
+{
+    bt_match_state_begin(state);
+    bt_match_state_store(&state->current_set, set);
+    bt_match_state_end(state);
+}
+
+void
+bt_match_state_set_serving(bt_match_state *const state, int idx)
+{
+    bt_match_state_begin(state);
+    bt_match_state_store(&state->serving, ((idx == 0) || (idx == 1)) ? idx : -1);
+    bt_match_state_end(state);
+}
+
+int
+bt_match_state_get_current_set(const bt_match_state *const state)
+{
+    return state->current_set;
+}
+
+uint32_t
+bt_match_state_get_version(const bt_match_state *const state)
+{
+    return __atomic_load_n(&state->version, __ATOMIC_ACQUIRE);
+}
+
+static void
+bt_match_state_copy(const bt_match_state *const state,
+                                               bt_match_state *const snapshot)
+{
+    snapshot->current_set = __atomic_load_n(&state->current_set, __ATOMIC_RELAXED);
+    snapshot->serving = __atomic_load_n(&state->serving, __ATOMIC_RELAXED);
+    for (size_t idx = 0; idx < 2; ++idx) {
+        snapshot->points[idx] = __atomic_load_n(&state->points[idx], __ATOMIC_RELAXED);
+        for (size_t set = 0; set < BT_MATCH_STATE_SETS; ++set) {
+            snapshot->games[idx][set] =
+                         __atomic_load_n(&state->games[idx][set], __ATOMIC_RELAXED);
+        }
+    }
+}
+
+void
+bt_match_state_snapshot(const bt_match_state *const state,
+                                               bt_match_state *const snapshot)
+{
+    uint32_t before;
+    uint32_t after;
+    do {
+        // Wait for the writer to finish
+        while (((before = bt_match_state_get_version(state)) & 1) != 0)
+            ;
+        bt_match_state_copy(state, snapshot);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&state->version, __ATOMIC_RELAXED);
+        // If it changed in the middle, the copy might be mixed
+    } while (before != after);
+    snapshot->version = before;
+}
+
+size_t
+bt_match_state_render(const bt_match_state *const state, size_t first,
+                                                  char *const buffer, size_t size)
+{
+    size_t length;
+    size_t other;
+    int count;
+    if (size == 0)
+        return 0;
+    buffer[0] = '\0';
+    if (first > 1)
+        first = 1;
+    // The sets played so far, including the current one
+    count = state->current_set;
+    if (count > BT_MATCH_STATE_SETS)
+        count = BT_MATCH_STATE_SETS;
+    other = (first == 0) ? 1 : 0;
+    length = 0;
+    for (int set = 0; set < count; ++set) {
+        int result;
+        result = snprintf(buffer + length, size - length, "%s%d-%d",
+                                     (set > 0) ? " " : "",
+                                       state->games[first][set], state->games[other][set]);
+        // Stop if it doesn't fit, it's truncated but still terminated
+        if ((result < 0) || ((size_t) result >= size - length))
+            return strlen(buffer);
+        length += result;
+    }
+    return length;
+}
@@ -4,6 +4,8 @@
 #include <bt-util.h>
 #include <bt-telegram-channel.h>
 #include <bt-mbet-feed.h>
+#include <bt-mbet-xml.h>
+#include <bt-mbet-delta.h>
 #include <bt-mbet.h>
 #include <bt-memory.h>
 #include <bt-channel-settings.h>
@@ -106,7 +108,7 @@ bt_mbet_save_score(const bt_mbet_event *const event, const bt_mbet_score *const
     const bt_mbet_score_item *set;
     int gameno;
     // Sanity check
-    if ((score->nsets == 0) || (score->sets == NULL))
+    if ((score == NULL) || (score->nsets == 0) || (score->sets == NULL))
         return;
     // Get the second operation (the sets score) from the `bt_mysql_transaction`
     operation = bt_transaction_get_operation(transaction, 1);
@@ -157,6 +159,15 @@ bt_mbet_handle_sport(const bt_mbet_sport *const sport,
     handler(sport, data);
 }
 
+static bool
+bt_mbet_is_known_match(const bt_mbet_event *const event)
+{
+    // Only matches we can link to the oncourt database are stored
+    if ((event->home->ocid == -1) || (event->away->ocid == -1))
+        return false;
+    return (event->octour != -1);
+}
+
 static void
 bt_mbet_save_match(const bt_mbet_event *const event, void *data)
 {
@@ -175,7 +186,7 @@ bt_mbet_save_match(const bt_mbet_event *const event, void *data)
     awya = event->away;
     // Store the match time
     strftime(date, sizeof(date), "%Y-%m-%d", &event->date);
-    if ((home->ocid == -1) || (awya->ocid == -1) || (event->octour == -1))
+    if (bt_mbet_is_known_match(event) == false)
         return;
     // Check if the match is running
     status = 1;
@@ -200,12 +211,6 @@ bt_mbet_pre_sport_handler(const bt_mbet_sport *const sport, void *data)
     bt_mbet_generic_sport_handler(sport, bt_mbet_check_market_changes, data);
 }
 
-static void
-bt_mbet_live_sport_handler(const bt_mbet_sport *const sport, void *data)
-{
-    bt_mbet_generic_sport_handler(sport, bt_mbet_save_match, data);
-}
-
 static void
 bt_mbet_live_result_check_handicap(int match)
 {
@@ -297,13 +302,44 @@ error:
 }
 
 static void
-bt_mbet_live_handler(const bt_mbet_feed *const live)
+bt_mbet_live_change_handler(const bt_mbet_change *const change, void *data)
 {
-    bt_mbet_list *sports;
     bt_mysql_transaction *transaction;
     bt_mysql_operation *operation;
-    sports = live->sports;
-    if (sports == NULL)
+    transaction = data;
+    switch (change->type) {
+    case MbetEventStarted:
+        // Insert the match, with it's current score
+        bt_mbet_save_match(change->event, transaction);
+        break;
+    case MbetScoreChanged:
+        if (bt_mbet_is_known_match(change->event) == false)
+            break;
+        bt_mbet_save_score(change->event, change->event->score, transaction);
+        break;
+    case MbetEventFinished:
+        // This operation is just for the finished matches
+        operation = bt_transaction_get_operation(transaction, 5);
+        if (operation == NULL)
+            break;
+        bt_mysql_operation_put(operation, "%ld", change->tree_id);
+        // Notify if the handicap for the match wasn't met
+        bt_mbet_live_result_check_handicap(change->tree_id);
+        break;
+    default:
+        // The odds from the live feed are not stored
+        break;
+    }
+}
+
+static void
+bt_mbet_live_handler(bt_mbet_delta *const delta, const bt_mbet_feed *const live)
+{
+    bt_mysql_transaction *transaction;
+    bt_mysql_operation *operation;
+    size_t changes;
+    bool first;
+    if (live->sports == NULL)
         return;
     // Make a transaction object to execute all these
     // queries and set parameters easily and efficiently.
@@ -318,28 +354,24 @@ bt_mbet_live_handler(const bt_mbet_feed *const live)
     );
     if (transaction == NULL)
         return;
-    // Handle each sport in the lsit
-    for (size_t idx = 0; idx < sports->count; ++idx) {
-        bt_mbet_sport *sport;
-        // Make a pointer
-        sport = bt_mbet_list_get_item_data(live->sports, idx);
-        // Note, there is no need to execute any query
-        // for the PreMatchFeed, so the transaction can
-        // be anything since it will not be accessed.
-        //
-        // But just because I am extremely paranoid, id
-        // set it to `NULL` anyway to account for future
-        // changes or all the things that may be missed
-        bt_mbet_handle_sport(sport, bt_mbet_live_sport_handler, transaction);
-    }
-    // This operation is just for the finished matches
+    // Without a previous feed we don't know which of the matches
+    // in the database finished while we were not looking
+    first = (bt_mbet_delta_get_count(delta) == 0);
+    // Only what changed since the previous feed goes to the database
+    changes = bt_mbet_delta_update(delta, live, bt_mbet_live_change_handler, transaction);
     operation = bt_transaction_get_operation(transaction, 5);
-    if (operation != NULL) {
+    if ((first == true) && (operation != NULL)) {
         // Insert all finished matches id's into the operation obejct
         bt_mbet_update_finished_matches(live, operation);
+        changes += 1;
+    }
+    // Execute the transation, if it fails the changes are lost so
+    // forget the state and write the whole next feed
+    if ((changes > 0) && (bt_mysql_transaction_execute(transaction) != 0)) {
+        log("imposible almacenar los cambios del feed en vivo, se reenvía completo\n");
+        bt_mbet_delta_clear(delta);
+        bt_mbet_feed_invalidate(LiveFeed);
     }
-    // Execute the transation
-    bt_mysql_transaction_execute(transaction);
     // Release resources
     bt_mysql_transaction_free(transaction);
 }
@@ -370,19 +402,28 @@ bt_mbet_pre_handler(const bt_mbet_feed *const live)
 void *
 bt_mbet_feed_live(void *context)
 {
+    bt_mbet_delta *delta;
+    // The events of the previous feed, to compare with each new one
+    delta = bt_mbet_delta_new();
+    if (delta == NULL)
+        return NULL;
     // Initialize MySQL database resources
     bt_database_initialize();
     // Start the main loop
     while (bt_isrunning(context) == true) {
         bt_mbet_feed *feed;
         // Make an update from the feed data
-        feed = bt_mbet_feed_get(LiveFeed, bt_mbet_live_handler);
+        feed = bt_mbet_feed_get_cached(LiveFeed, NULL);
         if (feed != NULL) {
+            bt_mbet_live_handler(delta, feed);
             bt_mbet_feed_free(feed);
         }
         // Wait 5 seconds for the next request
         bt_sleep(5);
     }
+    // Release the compiled XPath expressions of this thread
+    bt_mbet_xpath_thread_release();
+    bt_mbet_delta_free(delta);
     // Release MySQL connection resources
     bt_database_finalize();
     bt_notify_thread_end();
@@ -398,12 +439,14 @@ bt_mbet_feed_prematch(void *context)
     while (bt_isrunning(context) == true) {
         bt_mbet_feed *feed;
         // Make an update from the feed data
-        feed = bt_mbet_feed_get(PreMatchFeed, bt_mbet_pre_handler);
+        feed = bt_mbet_feed_get_cached(PreMatchFeed, bt_mbet_pre_handler);
         if (feed != NULL)
             bt_mbet_feed_free(feed);
         // Wait five minutes for the next request
         bt_sleep(300);
     }
+    // Release the compiled XPath expressions of this thread
+    bt_mbet_xpath_thread_release();
     // Release MySQL connection resources
     bt_database_finalize();
     bt_notify_thread_end();
@@ -132,9 +132,15 @@ oncourt_send_new_dogs(const char *const category,
     message = bt_string_builder_string(sb);
     // Check that it's not `NULL` or empty
     if ((message != NULL) && (message[0] != '\0')) {
-        // Send the message using the appropriate `send' function
-        // as determined by the caller
-        bt_telegram_edit_message(-1, id, DOGS_TITLE, message);
+        bt_telegram_notification *notification;
+        // Queue the message, a sender delivers it
+        notification = bt_telegram_notification_new(DOGS_TITLE, message);
+        if ((notification != NULL) &&
+                 (bt_telegram_notification_add_channel(notification, id, -1) == true)) {
+            bt_telegram_notification_post(notification);
+        } else {
+            bt_telegram_notification_free(notification);
+        }
     }
     // Release string builder resources
     bt_string_builder_free(sb);
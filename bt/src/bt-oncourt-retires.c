@@ -36,8 +36,8 @@ oncourt_send_new_retires()
     sb = bt_string_builder_new();
     // Do this for each category
     for (size_t idx = 0; idx < sizeof(categories) / sizeof(*categories); ++idx) {
+        bt_telegram_notification *notification;
         const char *category;
-        int status;
         category = bt_get_category_name(categories[idx]);
         // Get current category's name
         // Reset the string builder
@@ -69,6 +69,10 @@ oncourt_send_new_retires()
         msg = bt_string_builder_string(sb);
         if ((msg == NULL) || (msg[0] == '\0'))
             continue;
+        // The same text for every channel, the senders deliver it
+        notification = bt_telegram_notification_new(RETIRED_LIST, msg);
+        if (notification == NULL)
+            goto error;
         for (size_t jdx = 0; jdx < bt_channel_settings_count(); ++jdx) {
             char channel[32];
             ssize_t result;
@@ -77,12 +81,11 @@ oncourt_send_new_retires()
                 continue;
             if (bt_channel_settings_get_retired(categories[idx], jdx) == false)
                 continue;
-            // Send the message it and check for success
-            status = bt_telegram_send_message(channel, RETIRED_LIST, msg);
-            if (status != -1)
-                continue;
-            goto error;
+            bt_telegram_notification_add_channel(notification, channel, -1);
         }
+        // Queue it and check for success
+        if (bt_telegram_notification_post(notification) == false)
+            goto error;
     }
 
 error:
@@ -127,6 +127,8 @@ typedef struct bt_pinnacle_ctx {
     bt_http_headers *headers;
     long int fixtures_last;
     long int odds_last;
+    // The leagues rarely change, so they are kept between updates
+    bt_pinnacle_league_list *leagues;
 } bt_pinnacle_ctx;
 
 
@@ -690,16 +692,20 @@ bt_pinnacle_get_odds(bt_pinnacle_object *object, bt_pinnacle_ctx *const api)
 }
 
 static bt_pinnacle_league_list *
-bt_pinnacle_get_leagues(const bt_pinnacle_ctx *const api)
+bt_pinnacle_get_leagues(bt_pinnacle_ctx *const api)
 {
     json_object *object;
     bt_pinnacle_league_list *list;
     json_object *leagues;
+    enum bt_http_result status;
     char *json;
     // Build the URL
     list = NULL;
     object = NULL;
-    json = bt_http_get(LEAGUES, false, api->http, api->headers);
+    json = bt_http_get_cached(LEAGUES, false, api->http, api->headers, &status);
+    // Nothing changed, the ones we have are still good
+    if (status == HttpNotModified)
+        return api->leagues;
     if (json == NULL)
         return NULL;
     object = json_tokener_parse(json);
@@ -713,7 +719,13 @@ bt_pinnacle_get_leagues(const bt_pinnacle_ctx *const api)
     list->leagues = bt_pinnacle_get_array(league, list, leagues);
     qsort(list->leagues, list->league_count,
                                 sizeof(*list->leagues), bt_pinnacle_league_cmp);
+    // Replace the old ones
+    bt_pinnacle_leagues_free(api->leagues);
+    api->leagues = list;
 error:
+    // Parse it again next time, even if it didn't change
+    if (list == NULL)
+        bt_http_cache_invalidate(LEAGUES);
     if (object != NULL)
         json_object_put(object);
     bt_free(json);
@@ -766,9 +778,11 @@ bt_pinnacle_get_fixtures(bt_pinnacle_ctx *const api)
         if (league == NULL) // Very unlikely, but just in case
             continue;
         eugael = bt_pinnacle_leagues_find(leagues, league->id);
-        if (eugael != NULL) {
-            league->name = eugael->name;
-            eugael->name = NULL;
+        if ((eugael != NULL) && (eugael->name != NULL)) {
+            // The leagues are kept for the next update, so copy it
+            league->name = bt_strdup(eugael->name);
+            if (league->name == NULL)
+                continue;
             if (strstr(league->name, "WTA") != NULL) {
                 league->category = CategoryWTA;
             } else if (strstr(league->name, "ATP") != NULL) {
@@ -779,11 +793,9 @@ bt_pinnacle_get_fixtures(bt_pinnacle_ctx *const api)
         }
     }
     bt_pinnacle_set_fixtures_last(api->fixtures_last);
-    bt_pinnacle_leagues_free(leagues);
     bt_free(json);
     return root;
 error:
-    bt_pinnacle_leagues_free(leagues);
     bt_free(json);
     return NULL;
 }
@@ -876,6 +888,7 @@ bt_pinnacle_main(void *context)
     if (ctx.headers == NULL)
         return NULL;
     ctx.http = NULL;
+    ctx.leagues = NULL;
     ctx.fixtures_last = bt_pinnacle_get_fixtures_last();
     ctx.odds_last = bt_pinnacle_get_odds_last();
     // base64(AFF4280:pinn@cle87);
@@ -892,6 +905,7 @@ bt_pinnacle_main(void *context)
         bt_mysql_execute_query(UPDATE_QUERY);
         bt_sleep(30);
     }
+    bt_pinnacle_leagues_free(ctx.leagues);
     bt_http_headers_free(ctx.headers);
     bt_notify_thread_end();
     return NULL;
@@ -41,6 +41,15 @@ void
 bt_string_builder_reset(bt_string_builder *builder)
 {
     builder->length = 0;
+    // Keep it a valid (empty) string
+    if (builder->string != NULL)
+        builder->string[0] = '\0';
+}
+
+size_t
+bt_string_builder_length(const bt_string_builder *const builder)
+{
+    return builder->length;
 }
 
 void
@@ -16,6 +16,7 @@
 #include <bt-telegram-channel.h>
 #include <bt-database.h>
 #include <bt-memory.h>
+#include <bt-latency.h>
 
 #ifdef WITH_CURL
 #include <curl/curl.h>
@@ -24,6 +25,9 @@
 #define SEND_MSG_URL "https://api.telegram.org/bot187211327:AAEidqiYii2rq_53EJLrhyRWTfxuNKZiDLE/sendMessage?chat_id=%s&parse_mode=HTML&disable_web_page_preview=true&text=%s"
 #define EDIT_MSG_URL "https://api.telegram.org/bot187211327:AAEidqiYii2rq_53EJLrhyRWTfxuNKZiDLE/editMessageText?chat_id=%s&message_id=%d&parse_mode=HTML&disable_web_page_preview=true&text=%s"
 
+// Replaces the HTTP requests, see `bt_telegram_set_transport()'
+static bt_telegram_transport Transport;
+
 static bool
 bt_telegram_check_status_ok(json_object *object)
 {
@@ -155,16 +159,15 @@ bt_telegram_check_status(const char *const json)
 }
 
 static int
-bt_telegram_vsend_message(int id, const char *const channel,
-                                         const char *const format, va_list args)
+bt_telegram_send_encoded(int id, const char *const channel,
+                                                    const char *const message)
 {
+    bt_telegram_transport transport;
     char *url;
-    char *message;
     int result;
-    // Create the message from the parameters
-    message = bt_telegram_create_message(format, args);
-    if (message == NULL)
-        return -1;
+    transport = __atomic_load_n(&Transport, __ATOMIC_ACQUIRE);
+    if (transport != NULL)
+        return transport(channel, id, message);
     // Ensure this is initialized
     result = -1;
     if (id == -1) // Make the url to send or edit
@@ -183,6 +186,27 @@ bt_telegram_vsend_message(int id, const char *const channel,
         bt_free(json);
         bt_free(url);
     }
+    // Return the message id or -1 on error
+    return result;
+}
+
+void
+bt_telegram_set_transport(bt_telegram_transport transport)
+{
+    __atomic_store_n(&Transport, transport, __ATOMIC_RELEASE);
+}
+
+static int
+bt_telegram_vsend_message(int id, const char *const channel,
+                                         const char *const format, va_list args)
+{
+    char *message;
+    int result;
+    // Create the message from the parameters
+    message = bt_telegram_create_message(format, args);
+    if (message == NULL)
+        return -1;
+    result = bt_telegram_send_encoded(id, channel, message);
     // Free temporary memory used by the message
     bt_free(message);
     // Return the message id or -1 on error
@@ -211,3 +235,391 @@ bt_telegram_edit_message(int id, const char *const channel, const char *const fo
     va_end(args);
     return id;
 }
+
+// The text of a notification is url encoded once and shared by the
+// messages for all it's channels
+typedef struct bt_telegram_text {
+    char *encoded;
+    int references;
+} bt_telegram_text;
+
+typedef struct bt_telegram_target {
+    char *channel;
+    int id;
+} bt_telegram_target;
+
+struct bt_telegram_notification {
+    bt_telegram_text *text;
+    bt_telegram_target *targets;
+    size_t count;
+    bt_telegram_edit_resolver resolver;
+    bt_telegram_completion completion;
+    void *data;
+    bt_latency_trace trace;
+    bool traced;
+};
+
+// A message for a single channel, waiting for a sender
+typedef struct bt_telegram_job {
+    struct bt_telegram_job *next;
+    bt_telegram_text *text;
+    bt_telegram_target target;
+    bt_telegram_edit_resolver resolver;
+    bt_telegram_completion completion;
+    void *data;
+    bt_latency_trace trace;
+    bool traced;
+} bt_telegram_job;
+
+typedef struct bt_telegram_sender {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+    bt_telegram_job *head;
+    bt_telegram_job *tail;
+    bool running;
+} bt_telegram_sender;
+
+#define BT_TELEGRAM_MAX_SENDERS 8
+
+// The senders and their count change together, producers read them
+// with `bt_telegram_pool_lock' held for reading so the pool can't be
+// released while a job is being pushed
+typedef struct bt_telegram_pool {
+    bt_telegram_sender *senders;
+    size_t count;
+} bt_telegram_pool;
+
+static bt_telegram_pool *pool;
+static pthread_rwlock_t bt_telegram_pool_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static void
+bt_telegram_text_release(bt_telegram_text *text)
+{
+    if (text == NULL)
+        return;
+    if (__atomic_sub_fetch(&text->references, 1, __ATOMIC_ACQ_REL) != 0)
+        return;
+    bt_free(text->encoded);
+    bt_free(text);
+}
+
+static void
+bt_telegram_deliver(const bt_telegram_text *const text,
+           const bt_telegram_target *const target,
+             bt_telegram_edit_resolver resolver,
+     bt_telegram_completion completion, void *data, bt_latency_trace *trace)
+{
+    int previous;
+    int id;
+    // The id to edit is resolved right before sending, so it sees the
+    // id saved for the previous message to this channel
+    previous = target->id;
+    if (resolver != NULL)
+        previous = resolver(target->channel, data);
+    bt_latency_trace_mark(trace, LatencySent);
+    id = bt_telegram_send_encoded(previous, target->channel, text->encoded);
+    // Only deliveries that Telegram accepted are measured
+    if ((trace != NULL) && (id != -1)) {
+        bt_latency_trace_mark(trace, LatencyAnswered);
+        bt_latency_trace_finish(trace, target->channel);
+    }
+    if (completion != NULL)
+        completion(target->channel, previous, id, data);
+}
+
+static void *
+bt_telegram_sender_main(void *data)
+{
+    bt_telegram_sender *sender;
+    sender = data;
+    // Completion callbacks usually store the message id
+    bt_database_initialize();
+    for (;;) {
+        bt_telegram_job *job;
+        pthread_mutex_lock(&sender->mutex);
+        while ((sender->head == NULL) && (sender->running == true))
+            pthread_cond_wait(&sender->condition, &sender->mutex);
+        // Only stop when the queue is empty, so nothing is lost
+        job = sender->head;
+        if (job != NULL) {
+            sender->head = job->next;
+            if (sender->head == NULL)
+                sender->tail = NULL;
+        }
+        pthread_mutex_unlock(&sender->mutex);
+        if (job == NULL)
+            break;
+        bt_telegram_deliver(job->text, &job->target, job->resolver,
+         job->completion, job->data, (job->traced == true) ? &job->trace : NULL);
+        bt_telegram_text_release(job->text);
+        bt_free(job->target.channel);
+        bt_free(job);
+    }
+    bt_database_finalize();
+    return NULL;
+}
+
+static size_t
+bt_telegram_get_sender_count(void)
+{
+    const char *envvar;
+    long int count;
+    char *endptr;
+    envvar = getenv("TELEGRAM_SENDERS");
+    if (envvar == NULL)
+        return 2;
+    count = strtol(envvar, &endptr, 10);
+    if ((*endptr != '\0') || (count < 1))
+        return 1;
+    if (count > BT_TELEGRAM_MAX_SENDERS)
+        return BT_TELEGRAM_MAX_SENDERS;
+    return count;
+}
+
+static void
+bt_telegram_pool_free(bt_telegram_pool *list)
+{
+    bt_telegram_sender *senders;
+    if (list == NULL)
+        return;
+    senders = list->senders;
+    for (size_t idx = 0; idx < list->count; ++idx) {
+        pthread_mutex_lock(&senders[idx].mutex);
+        senders[idx].running = false;
+        pthread_cond_signal(&senders[idx].condition);
+        pthread_mutex_unlock(&senders[idx].mutex);
+    }
+    // The senders drain their queues before returning
+    for (size_t idx = 0; idx < list->count; ++idx) {
+        pthread_join(senders[idx].thread, NULL);
+        pthread_cond_destroy(&senders[idx].condition);
+        pthread_mutex_destroy(&senders[idx].mutex);
+    }
+    bt_free(senders);
+    bt_free(list);
+}
+
+static bt_telegram_pool *
+bt_telegram_pool_new(void)
+{
+    bt_telegram_pool *list;
+    size_t count;
+    list = bt_malloc(sizeof(*list));
+    if (list == NULL)
+        return NULL;
+    count = bt_telegram_get_sender_count();
+    list->senders = bt_calloc(count, sizeof(*list->senders));
+    if (list->senders == NULL)
+        goto error;
+    for (list->count = 0; list->count < count; ++list->count) {
+        bt_telegram_sender *sender;
+        sender = &list->senders[list->count];
+        sender->running = true;
+        pthread_mutex_init(&sender->mutex, NULL);
+        pthread_cond_init(&sender->condition, NULL);
+        if (pthread_create(&sender->thread, NULL, bt_telegram_sender_main, sender) == 0)
+            continue;
+        pthread_cond_destroy(&sender->condition);
+        pthread_mutex_destroy(&sender->mutex);
+        break;
+    }
+    if (list->count == 0)
+        goto error;
+    return list;
+error:
+    bt_free(list->senders);
+    bt_free(list);
+    return NULL;
+}
+
+bool
+bt_telegram_dispatcher_start(void)
+{
+    bool result;
+    pthread_rwlock_wrlock(&bt_telegram_pool_lock);
+    if (pool == NULL)
+        pool = bt_telegram_pool_new();
+    result = (pool != NULL);
+    pthread_rwlock_unlock(&bt_telegram_pool_lock);
+    return result;
+}
+
+void
+bt_telegram_dispatcher_stop(void)
+{
+    bt_telegram_pool *list;
+    // From now on messages are sent by the caller, once this returns
+    // nobody is pushing to the old senders
+    pthread_rwlock_wrlock(&bt_telegram_pool_lock);
+    list = pool;
+    pool = NULL;
+    pthread_rwlock_unlock(&bt_telegram_pool_lock);
+    bt_telegram_pool_free(list);
+}
+
+bt_telegram_notification *
+bt_telegram_notification_new(const char *const format, ...)
+{
+    bt_telegram_notification *notification;
+    va_list args;
+    notification = bt_malloc(sizeof(*notification));
+    if (notification == NULL)
+        return NULL;
+    notification->targets = NULL;
+    notification->count = 0;
+    notification->resolver = NULL;
+    notification->completion = NULL;
+    notification->data = NULL;
+    notification->traced = false;
+    notification->text = bt_malloc(sizeof(*notification->text));
+    if (notification->text == NULL)
+        goto error;
+    notification->text->references = 1;
+    va_start(args, format);
+    notification->text->encoded = bt_telegram_create_message(format, args);
+    va_end(args);
+    if (notification->text->encoded != NULL)
+        return notification;
+error:
+    bt_telegram_notification_free(notification);
+    return NULL;
+}
+
+bool
+bt_telegram_notification_add_channel(bt_telegram_notification *const notification,
+                                             const char *const channel, int id)
+{
+    bt_telegram_target *targets;
+    char *copy;
+    copy = bt_strdup(channel);
+    if (copy == NULL)
+        return false;
+    targets = bt_realloc(notification->targets,
+                        (notification->count + 1) * sizeof(*targets));
+    if (targets == NULL) {
+        bt_free(copy);
+        return false;
+    }
+    targets[notification->count].channel = copy;
+    targets[notification->count].id = id;
+    notification->targets = targets;
+    notification->count += 1;
+    return true;
+}
+
+void
+bt_telegram_notification_set_callbacks(
+                           bt_telegram_notification *const notification,
+               bt_telegram_edit_resolver resolver,
+                               bt_telegram_completion completion, void *data)
+{
+    notification->resolver = resolver;
+    notification->completion = completion;
+    notification->data = data;
+}
+
+void
+bt_telegram_notification_set_trace(bt_telegram_notification *const notification,
+                                          const bt_latency_trace *const trace)
+{
+    notification->trace = *trace;
+    notification->traced = true;
+}
+
+void
+bt_telegram_notification_free(bt_telegram_notification *notification)
+{
+    if (notification == NULL)
+        return;
+    for (size_t idx = 0; idx < notification->count; ++idx)
+        bt_free(notification->targets[idx].channel);
+    bt_free(notification->targets);
+    if (notification->text != NULL) {
+        bt_free(notification->text->encoded);
+        bt_free(notification->text);
+    }
+    bt_free(notification);
+}
+
+static size_t
+bt_telegram_channel_hash(const char *channel)
+{
+    size_t hash;
+    // FNV-1a, every message to a channel goes through the same sender
+    // so they arrive in the order they were posted
+    hash = 14695981039346656037ULL;
+    while (*channel != '\0')
+        hash = (hash ^ (unsigned char) *channel++) * 1099511628211ULL;
+    return hash;
+}
+
+static void
+bt_telegram_sender_push(bt_telegram_sender *const sender, bt_telegram_job *job)
+{
+    job->next = NULL;
+    pthread_mutex_lock(&sender->mutex);
+    if (sender->tail == NULL) {
+        sender->head = job;
+    } else {
+        sender->tail->next = job;
+    }
+    sender->tail = job;
+    pthread_cond_signal(&sender->condition);
+    pthread_mutex_unlock(&sender->mutex);
+}
+
+bool
+bt_telegram_notification_post(bt_telegram_notification *notification)
+{
+    bt_telegram_text *text;
+    bool result;
+    if (notification == NULL)
+        return false;
+    text = notification->text;
+    result = true;
+    pthread_rwlock_rdlock(&bt_telegram_pool_lock);
+    // Without senders, deliver it from this thread
+    if (pool == NULL) {
+        pthread_rwlock_unlock(&bt_telegram_pool_lock);
+        for (size_t idx = 0; idx < notification->count; ++idx) {
+            bt_latency_trace trace;
+            // Each channel completes it's own copy
+            trace = notification->trace;
+            bt_telegram_deliver(text, &notification->targets[idx],
+                   notification->resolver, notification->completion,
+               notification->data, (notification->traced == true) ? &trace : NULL);
+        }
+        goto finish;
+    }
+    for (size_t idx = 0; idx < notification->count; ++idx) {
+        bt_telegram_target *target;
+        bt_telegram_job *job;
+        target = &notification->targets[idx];
+        job = bt_malloc(sizeof(*job));
+        if (job == NULL) {
+            result = false;
+            continue;
+        }
+        // The job takes the channel and a reference to the text
+        job->text = text;
+        job->target = *target;
+        job->resolver = notification->resolver;
+        job->completion = notification->completion;
+        job->data = notification->data;
+        job->trace = notification->trace;
+        job->traced = notification->traced;
+        target->channel = NULL;
+
+        __atomic_add_fetch(&text->references, 1, __ATOMIC_RELAXED);
+        bt_telegram_sender_push(
+          &pool->senders[bt_telegram_channel_hash(job->target.channel) % pool->count], job);
+    }
+    pthread_rwlock_unlock(&bt_telegram_pool_lock);
+finish:
+    // Drop our reference, the senders free the text when they are done
+    notification->text = NULL;
+    bt_telegram_text_release(text);
+    bt_telegram_notification_free(notification);
+    return result;
+}
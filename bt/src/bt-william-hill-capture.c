@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+
+#include <bt-william-hill-capture.h>
+#include <bt-memory.h>
+#include <bt-debug.h>
+
+struct bt_william_hill_capture {
+    FILE *file;
+    uint64_t frames;
+};
+
+bt_william_hill_capture *
+bt_william_hill_capture_open(size_t index)
+{
+    bt_william_hill_capture *capture;
+    const char *envvar;
+    char path[PATH_MAX];
+    uint32_t version;
+    int length;
+    envvar = getenv("WILLIAM_HILL_CAPTURE");
+    if ((envvar == NULL) || (envvar[0] == '\0'))
+        return NULL;
+    // One file per connection
+    length = snprintf(path, sizeof(path), "%s.%zu", envvar, index);
+    if ((length < 0) || (length >= sizeof(path)))
+        return NULL;
+    capture = bt_malloc(sizeof(*capture));
+    if (capture == NULL)
+        return NULL;
+    capture->frames = 0;
+    capture->file = fopen(path, "wb");
+    if (capture->file == NULL) {
+        log("error: cannot capture frames to `%s': %s\n", path, strerror(errno));
+        bt_free(capture);
+        return NULL;
+    }
+    // The header, the signature and the format version
+    version = BT_WILLIAM_HILL_CAPTURE_VERSION;
+    if ((fwrite("BTWH", 1, 4, capture->file) != 4) ||
+                   (fwrite(&version, sizeof(version), 1, capture->file) != 1)) {
+        bt_william_hill_capture_close(capture);
+        return NULL;
+    }
+    log("capturing websocket frames to `\033[34m%s\033[0m'\n", path);
+    return capture;
+}
+
+bool
+bt_william_hill_capture_write(bt_william_hill_capture *const capture,
+                uint64_t received, const void *const data, size_t length)
+{
+    uint32_t size;
+    if ((capture == NULL) || (length > UINT32_MAX))
+        return false;
+    size = length;
+    // The file is buffered, so this is just a copy most of the time
+    if (fwrite(&received, sizeof(received), 1, capture->file) != 1)
+        return false;
+    if (fwrite(&size, sizeof(size), 1, capture->file) != 1)
+        return false;
+    if ((length != 0) && (fwrite(data, 1, length, capture->file) != length))
+        return false;
+    capture->frames += 1;
+    return true;
+}
+
+void
+bt_william_hill_capture_flush(bt_william_hill_capture *const capture)
+{
+    if (capture == NULL)
+        return;
+    fflush(capture->file);
+}
+
+void
+bt_william_hill_capture_close(bt_william_hill_capture *capture)
+{
+    if (capture == NULL)
+        return;
+    log("captured \033[34m%llu\033[0m websocket frames\n",
+                                        (unsigned long long) capture->frames);
+    fclose(capture->file);
+    bt_free(capture);
+}
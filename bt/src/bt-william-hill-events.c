@@ -12,32 +12,60 @@
 #include <http-protocol.h>
 
 #include <bt-william-hill-events.h>
+#include <bt-william-hill-schedule.h>
 #include <bt-database.h>
 #include <bt-players.h>
+#include <bt-match-state.h>
 #include <bt-util.h>
 #include <bt-memory.h>
+#include <bt-slab.h>
 #include <bt-debug.h>
 #include <bt-william-hill.h>
 #include <bt-string-builder.h>
 #include <bt-context.h>
+#include <bt-private.h>
+
+#define EVENTS_URL "http://sports.williamhill.com/bet/es-es/betlive/24"
 
 typedef struct bt_event {
+    // First, so it starts the cache line
+    bt_match_state state;
     int id;
     bt_tennis_category category;
     char *tour;
     bt_player *players[2];
-    int current_set;
     int ready4incidents;
     bool subscribed;
     char *date;
+    char *subscription;
+    bt_topic *topics[TopicCount];
 } bt_event;
 
+// Events waiting to be subscribed are kept by id, so removing an event
+// does not leave a dangling pointer here
 typedef struct bt_event_list {
     bt_event **items;
     int size;
     int count;
+    int *dirty;
+    size_t ndirty;
+    size_t dirtysize;
 } bt_event_list;
 
+// Events and their players are created by the provider and released by
+// the connections and workers, the pools are shared by all of them
+static bt_slab *EventSlab;
+static bt_slab *PlayerSlab;
+static pthread_once_t SlabsOnce = PTHREAD_ONCE_INIT;
+
+static void
+bt_william_hill_slabs_create(void)
+{
+    // The match state must start a cache line
+    EventSlab = bt_slab_new(sizeof(bt_event), BT_MATCH_STATE_ALIGNMENT);
+    PlayerSlab = bt_slab_new(sizeof(bt_player), __alignof__(bt_player));
+}
+
 static int
 bt_william_hill_compare_events(const void *const _a, const void *const _b)
 {
@@ -76,36 +104,30 @@ bt_william_hill_event_list_find(bt_event_list *list, int value)
     return *found;
 }
 
-void
-bt_william_hill_event_list_remove(bt_event_list *const list,
+bt_event *
+bt_william_hill_event_list_detach(bt_event_list *const list,
                                              const bt_event *const event)
 {
-    int count;
     // FIXME: write an alternative version of this function, using binary search
 
-    // Save current elements count
-    count = list->count;
     // Iterate through all the elements until we find the one we want
-    for (int index = 0; index < count; ++index) {
-        bt_event *current;
-        size_t size;
-        // Make a pointer to the "current" element
-        current = list->items[index];
+    for (int index = 0; index < list->count; ++index) {
         // Check it's id, if it's not the element we want, continue
-        if (event->id != current->id)
+        if (event->id != list->items[index]->id)
             continue;
         log("removing event: \033[34m%d\033[0m\n", event->id);
-        // Calculate the size we must move the list of items
-        size = (count - index - 1) * sizeof(*list->items);
-        if (size != 0)
-            memmove(&list->items[index], &list->items[index + 1], size);
-        // Free the event's memory
-        bt_william_hill_event_free(current);
-        // Update the count
-        list->count = count - 1;
-        // It's over, nothing else to do here
-        return;
+        // Take it out of the list, the caller owns it now
+        return bt_william_hill_event_list_take(list, index);
     }
+    return NULL;
+}
+
+void
+bt_william_hill_event_list_remove(bt_event_list *const list,
+                                             const bt_event *const event)
+{
+    // Free the event's memory, if it was in the list
+    bt_william_hill_event_free(bt_william_hill_event_list_detach(list, event));
 }
 
 static void
@@ -114,7 +136,7 @@ bt_player_free(bt_player *player)
     if (player == NULL)
         return;
     bt_free(player->name);
-    bt_free(player);
+    bt_slab_release(PlayerSlab, player);
 }
 
 void
@@ -123,12 +145,16 @@ bt_william_hill_event_free(bt_event *event)
     if (event == NULL)
         return;
     bt_free(event->tour);
+    // Free the topics that were not removed by the registry
+    for (int type = 0; type < TopicCount; ++type)
+        bt_william_hill_topic_free(event->topics[type]);
     // Free players memory
     bt_player_free(event->players[0]);
     bt_player_free(event->players[1]);
     bt_free(event->date);
-    // Free the event memory
-    bt_free(event);
+    bt_free(event->subscription);
+    // Give the event memory back to the pool
+    bt_slab_release(EventSlab, event);
 }
 
 void
@@ -143,6 +169,8 @@ bt_william_hill_event_list_clear(bt_event_list *list)
     bt_free(list->items);
     // Update the count
     list->count = 0;
+    // There is nothing left to subscribe
+    list->ndirty = 0;
 }
 
 
@@ -153,6 +181,7 @@ bt_william_hill_event_list_free(bt_event_list *list)
         return;
     // Clear the list
     bt_william_hill_event_list_clear(list);
+    bt_free(list->dirty);
     // Free the actual obejct
     bt_free(list);
 }
@@ -243,8 +272,8 @@ bt_william_hill_json_event_get_players(json_object *object, int event, int index
     name = json_object_get_string(item);
     if (name == NULL)
         return NULL;
-    // Allocate space for the new `bt_player' object
-    player = bt_malloc(sizeof(*player));
+    // Take space for the new `bt_player' object from the pool
+    player = bt_slab_alloc(PlayerSlab);
     if (player == NULL)
         return NULL;
     // Initialize everything
@@ -254,8 +283,6 @@ bt_william_hill_json_event_get_players(json_object *object, int event, int index
     player->id = id;
     player->last = 0;
     player->serving = false;
-
-    memset(&player->score, 0, sizeof(player->score));
     return player;
 }
 
@@ -308,12 +335,37 @@ bt_william_hill_get_event_date(json_object *object)
     return bt_strdup(string);
 }
 
+static void
+bt_william_hill_schedule_event_from_json(json_object *object,
+                                  bt_william_hill_schedule *const schedule)
+{
+    json_object *start_time;
+    const char *string;
+    const char *end;
+    struct tm tm;
+    // Running events are already being listened to
+    if (bt_william_hill_check_event_is_running(object) == true)
+        return;
+    if (json_object_object_get_ex(object, "start_time", &start_time) == false)
+        return;
+    string = json_object_get_string(start_time);
+    if (string == NULL)
+        return;
+    // The same text that is saved with the MTOs, taken as UTC
+    memset(&tm, 0, sizeof(tm));
+    end = strptime(string, "%Y-%m-%d%n%H:%M:%S", &tm);
+    if (end == NULL)
+        return;
+    bt_william_hill_schedule_add(schedule, timegm(&tm));
+}
+
 static bt_event *
 bt_william_hill_create_event(json_object *object, long int id)
 {
     bt_event *event;
     bt_player *players[2];
     char *tourname;
+    pthread_once(&SlabsOnce, bt_william_hill_slabs_create);
     // Obtain the internal "oncourt" database ids of these players
     players[0] = bt_william_hill_json_event_get_players(object, id, 0);
     players[1] = bt_william_hill_json_event_get_players(object, id, 1);
@@ -325,8 +377,9 @@ bt_william_hill_create_event(json_object *object, long int id)
     tourname = bt_william_hill_get_tournament_name(object);
     if (tourname == NULL)
         goto error;
-    // All is ok, so allocate memory now
-    event = bt_malloc(sizeof(*event));
+    // All is ok, so take memory from the pool now, it's aligned for the
+    // match state
+    event = bt_slab_alloc(EventSlab);
     // In case memory was allocated, fill the structure
     if (event != NULL) {
         event->subscribed = false;
@@ -335,9 +388,20 @@ bt_william_hill_create_event(json_object *object, long int id)
         event->id = id;
         event->players[0] = players[0];
         event->players[1] = players[1];
-        event->current_set = -1;
+        event->state.version = 0;
+        bt_match_state_reset(&event->state);
         event->category = bt_william_hill_get_category(tourname);
         event->date = bt_william_hill_get_event_date(object);
+        // Topics are created as the websocket announces them
+        for (int type = 0; type < TopicCount; ++type)
+            event->topics[type] = NULL;
+        // Build the subscription request here, in the provider thread, so
+        // the websocket thread only has to copy it into a frame
+        event->subscription = bt_william_hill_topics_event_subscription(id);
+        if (event->subscription == NULL) {
+            bt_william_hill_event_free(event);
+            return NULL;
+        }
         if (event->category == NoCategory) {
             log("warning: cannot determine the category of `%s'\n", tourname);
         }
@@ -345,69 +409,85 @@ bt_william_hill_create_event(json_object *object, long int id)
     return event;
 error:
     // Something bad occurred, this is a long running program so clean up
-    bt_free(players[0]);
-    bt_free(players[1]);
+    bt_player_free(players[0]);
+    bt_player_free(players[1]);
 
     return NULL;
 }
 
-static json_object *
-bt_william_hill_extract_json_from_string(const char *const json, size_t length)
+bt_event *
+bt_william_hill_event_new(int id)
 {
-    json_tokener *tokener;
-    json_object *object;
-    // Create a new Json tokener
-    tokener = json_tokener_new();
-    if (tokener == NULL)
+    bt_event *event;
+    pthread_once(&SlabsOnce, bt_william_hill_slabs_create);
+    event = bt_slab_alloc(EventSlab);
+    if (event == NULL)
         return NULL;
-    // Parse the Json string `json`
-    object = json_tokener_parse_ex(tokener, json, length);
-    if (object == NULL)
-        goto error;
-error:
-    // We should clean up now
-    json_tokener_free(tokener);
-    return object;
+    // Nothing about the match is known, only it's topics are tracked
+    // and there is no subscription to send
+    event->subscribed = true;
+    event->ready4incidents = 2;
+    event->tour = NULL;
+    event->id = id;
+    event->players[0] = NULL;
+    event->players[1] = NULL;
+    event->state.version = 0;
+    bt_match_state_reset(&event->state);
+    event->category = NoCategory;
+    event->date = NULL;
+    event->subscription = NULL;
+    for (int type = 0; type < TopicCount; ++type)
+        event->topics[type] = NULL;
+    return event;
 }
 
-static void
-bt_william_hill_next_json_from_html(const char *const data,
-                                           const char **head, const char **tail)
-{
-    char current;
-    const char *next;
-    size_t count;
-
-    // Initialize the return values to reflect failure
-    *head = NULL;
-    *tail = NULL;
-    // Search for the next '{' character
-    next = strchr(data, '{');
-    if (next == NULL)
-        return;
-    // Point to it with head since this means we migth have Json here
-    *head = next;
-    // Initialize the count to '1' because we already found a '{'
-    count = 1;
-    while ((count != 0) && ((current = *(++next)) != '\0')) {
-        switch (current) {
-        case '{': // Increase the open braces count
-            count += 1;
-            break;
-        case '}': // Decrease the open braces count (we found a close)
-            count -= 1;
-            break;
-        }
+static bt_player *
+bt_william_hill_player_new(const char *const name)
+{
+    bt_player *player;
+    player = bt_slab_alloc(PlayerSlab);
+    if (player == NULL)
+        return NULL;
+    player->name = bt_strdup(name);
+    if (player->name == NULL) {
+        bt_slab_release(PlayerSlab, player);
+        return NULL;
     }
-    // If we're here to things could have happened:
-    //
-    //   1. `count` is 0, so we have a candidate Json object.
-    //   2. We reached the end of the string, so we must make
-    //      `*tail` `NULL`.
-    if (*next == '\0')
-        *tail = NULL;
-    else  // Point to the next element
-        *tail = next + 1;
+    // Not known, like a player without medical timeouts
+    player->t_mto_count = 0;
+    player->c_mto_count = 0;
+    player->id = -1;
+    player->last = 0;
+    player->serving = false;
+    return player;
+}
+
+bool
+bt_william_hill_event_set_competitors(bt_event *const event,
+             const char *const home, const char *const away, const char *const tour)
+{
+    bt_player *players[2];
+    char *tourname;
+    pthread_once(&SlabsOnce, bt_william_hill_slabs_create);
+    players[0] = bt_william_hill_player_new(home);
+    players[1] = bt_william_hill_player_new(away);
+    tourname = bt_strdup(tour);
+    if ((players[0] == NULL) || (players[1] == NULL) || (tourname == NULL))
+        goto error;
+    // Replace whatever the event had
+    bt_player_free(event->players[0]);
+    bt_player_free(event->players[1]);
+    bt_free(event->tour);
+    event->players[0] = players[0];
+    event->players[1] = players[1];
+    event->tour = tourname;
+    event->category = bt_william_hill_get_category(tourname);
+    return true;
+error:
+    bt_player_free(players[0]);
+    bt_player_free(players[1]);
+    bt_free(tourname);
+    return false;
 }
 
 static bt_event *
@@ -443,43 +523,176 @@ bt_william_hill_events_json_handler(json_object *object,
     bt_william_hill_event_list_append(list, event);
 }
 
+// This is a javascript function that creates events on the william hill
+// site, every call to it has a parameter which is a Json object with the
+// information needed to ask the websocket about the event
+#define BT_WILLIAM_HILL_EVENT_MARKER "document.aip_list.create_prebuilt_event"
+
+// Where the scanner is, it keeps it's place between chunks of the HTML
+enum bt_event_scanner_state {
+    ScanMarker, // Looking for the marker
+    ScanOpen, // Looking for the '{' after it
+    ScanObject // Inside the Json object
+};
+
+typedef struct bt_event_scanner {
+    enum bt_event_scanner_state state;
+    // How much of the marker was at the end of the previous chunk
+    size_t matched;
+    // Nesting of the object, and whether we are in one of it's strings
+    size_t depth;
+    bool string;
+    bool escape;
+    // The object is parsed as it's found, so one tokener is enough
+    json_tokener *tokener;
+    bool failed;
+    bt_event_list *list;
+    // Where the start times of the coming events go, it can be `NULL'
+    bt_william_hill_schedule *schedule;
+} bt_event_scanner;
+
+static bool
+bt_event_scanner_init(bt_event_scanner *const scanner, bt_event_list *const list,
+                                       bt_william_hill_schedule *const schedule)
+{
+    scanner->tokener = json_tokener_new();
+    if (scanner->tokener == NULL)
+        return false;
+    scanner->state = ScanMarker;
+    scanner->matched = 0;
+    scanner->list = list;
+    scanner->schedule = schedule;
+    return true;
+}
+
 static void
-bt_william_hill_extract_events_helper(const char *const html,
-                                               bt_event_list *const list)
+bt_event_scanner_finalize(bt_event_scanner *const scanner)
+{
+    json_tokener_free(scanner->tokener);
+}
+
+static const char *
+bt_event_scanner_find_marker(bt_event_scanner *const scanner,
+                                            const char *head, const char *tail)
+{
+    const char *marker;
+    const char *found;
+    size_t length;
+    size_t size;
+    marker = BT_WILLIAM_HILL_EVENT_MARKER;
+    length = sizeof(BT_WILLIAM_HILL_EVENT_MARKER) - 1;
+    size = tail - head;
+    // The previous chunk ended with the start of the marker
+    if (scanner->matched > 0) {
+        size_t rest;
+        rest = length - scanner->matched;
+        if ((size >= rest) && (memcmp(head, marker + scanner->matched, rest) == 0)) {
+            scanner->matched = 0;
+            return head + rest;
+        }
+        if ((size < rest) && (memcmp(head, marker + scanner->matched, size) == 0)) {
+            scanner->matched += size;
+            return NULL;
+        }
+        scanner->matched = 0;
+    }
+    found = memmem(head, size, marker, length);
+    if (found != NULL)
+        return found + length;
+    // Remember if the chunk ends with the start of the marker
+    for (size_t count = (size < length) ? size : length - 1; count > 0; --count) {
+        if (memcmp(tail - count, marker, count) == 0) {
+            scanner->matched = count;
+            break;
+        }
+    }
+    return NULL;
+}
+
+static const char *
+bt_event_scanner_find_end(bt_event_scanner *const scanner,
+                                            const char *head, const char *tail)
+{
+    // Braces inside strings don't count
+    for (; head < tail; ++head) {
+        if (scanner->escape == true) {
+            scanner->escape = false;
+        } else if (scanner->string == true) {
+            if (*head == '\\')
+                scanner->escape = true;
+            else if (*head == '"')
+                scanner->string = false;
+        } else if (*head == '"') {
+            scanner->string = true;
+        } else if (*head == '{') {
+            scanner->depth += 1;
+        } else if ((*head == '}') && (--scanner->depth == 0)) {
+            return head + 1;
+        }
+    }
+    return NULL;
+}
+
+static void
+bt_event_scanner_parse(bt_event_scanner *const scanner,
+                                 const char *const head, const char *const tail)
+{
+    json_object *object;
+    enum json_tokener_error error;
+    if (scanner->failed == true)
+        return;
+    // The tokener keeps the partial object between chunks
+    object = json_tokener_parse_ex(scanner->tokener, head, tail - head);
+    error = json_tokener_get_error(scanner->tokener);
+    if (error == json_tokener_continue)
+        return;
+    if (object == NULL) {
+        scanner->failed = true;
+        return;
+    }
+    // Try to insert this potential event into the list
+    bt_william_hill_events_json_handler(object, scanner->list);
+    // And remember when it starts if it's not running yet
+    if (scanner->schedule != NULL)
+        bt_william_hill_schedule_event_from_json(object, scanner->schedule);
+    // Clean up the temporary Json obejct
+    json_object_put(object);
+}
+
+static void
+bt_event_scanner_feed(bt_event_scanner *const scanner,
+                                          const char *head, const char *const tail)
 {
-    const char *head;
-    const char *tail;
-    const char *magic;
-    // This is a javascript function that creates events on the
-    // william hill site, we scan the HTML and every call to
-    // this function contains a parameter which is a Json object
-    // that has the needed information to ask the websocket about
-    // the event and start "watching" it.
-    magic = "document.aip_list.create_prebuilt_event";
-    // Point to the start of the HTML
-    head = html;
-    // Start searching for occurrences of `magic' in the HTML
-    while ((head != NULL) && ((tail = strstr(head, magic)) != NULL)) {
-        // Try to extract the Json string. If we succeed `tail` will
-        // be NOT-NULL.
-        bt_william_hill_next_json_from_html(tail, &head, &tail);
-        // If tail is `NULL' we got nothing so continue to the next item
-        if (tail != NULL) {
-            json_object *object;
-            // Parse the Json string
-            object = bt_william_hill_extract_json_from_string(head, tail - head);
-            // Check if we obtained a valid Json obejct
-            if (object != NULL) {
-                // Try to insert this potential event into the list
-                bt_william_hill_events_json_handler(object, list);
-                // Clean up the temporary Json obejct
-                json_object_put(object);
-            }
-            // Advance from the next element
-            head = tail + 1;
-        } else {
-            // This will end the loop
-            head = NULL;
+    while (head < tail) {
+        const char *next;
+        switch (scanner->state) {
+        case ScanMarker:
+            head = bt_event_scanner_find_marker(scanner, head, tail);
+            if (head == NULL)
+                return;
+            scanner->state = ScanOpen;
+            break;
+        case ScanOpen:
+            head = memchr(head, '{', tail - head);
+            if (head == NULL)
+                return;
+            json_tokener_reset(scanner->tokener);
+            scanner->state = ScanObject;
+            scanner->depth = 0;
+            scanner->string = false;
+            scanner->escape = false;
+            scanner->failed = false;
+            break;
+        case ScanObject:
+            // Parse what there is of the object so far, it might
+            // continue in the next chunk
+            next = bt_event_scanner_find_end(scanner, head, tail);
+            bt_event_scanner_parse(scanner, head, (next != NULL) ? next : tail);
+            if (next == NULL)
+                return;
+            head = next;
+            scanner->state = ScanMarker;
+            break;
         }
     }
 }
@@ -494,6 +707,9 @@ bt_william_hill_event_list_new()
         return NULL;
     // Initialize and fill the structure
     list->count = 0;
+    list->dirty = NULL;
+    list->ndirty = 0;
+    list->dirtysize = 0;
     // Allocate space for list elements
     list->items = bt_malloc(200 * sizeof(*list->items));
     if (list->items != NULL)
@@ -505,8 +721,10 @@ bt_william_hill_event_list_new()
 }
 
 static bt_event_list *
-bt_william_hill_extract_events(const char *const data)
+bt_william_hill_extract_events(const char *const data, size_t length,
+                                       bt_william_hill_schedule *const schedule)
 {
+    bt_event_scanner scanner;
     bt_event_list *list;
     // Sanity check
     if (data == NULL)
@@ -515,8 +733,17 @@ bt_william_hill_extract_events(const char *const data)
     list = bt_william_hill_event_list_new();
     if (list == NULL)
         return NULL;
-    // Parse the HTML string to extract list elements
-    bt_william_hill_extract_events_helper(data, list);
+    // Scan the HTML once, extracting the events as they are found. The
+    // scanner can also take the HTML in pieces, as it arrives
+    if (bt_event_scanner_init(&scanner, list, schedule) == false) {
+        bt_william_hill_event_list_free(list);
+        return NULL;
+    }
+    // The start times are those of this page only
+    if (schedule != NULL)
+        bt_william_hill_schedule_clear(schedule);
+    bt_event_scanner_feed(&scanner, data, data + length);
+    bt_event_scanner_finalize(&scanner);
     // Return the potential list (it can be empty)
     return list;
 }
@@ -529,6 +756,24 @@ bt_william_hill_event_list_sort(bt_event_list *list)
                              sizeof(*list->items), bt_william_hill_compare_events);
 }
 
+bt_event *
+bt_william_hill_event_list_take(bt_event_list *list, int index)
+{
+    bt_event *event;
+    size_t size;
+    if ((index < 0) || (index >= list->count))
+        return NULL;
+    // Make a pointer to the event before it's overwritten
+    event = list->items[index];
+    // Move all the elements on the right one step to the left
+    size = (list->count - index - 1) * sizeof(*list->items);
+    if (size != 0)
+        memmove(&list->items[index], &list->items[index + 1], size);
+    // Update the count, the event is not in the list anymore
+    list->count -= 1;
+    return event;
+}
+
 void
 bt_william_hill_event_list_merge(bt_event_list *dst,
                                                       bt_event_list *src)
@@ -573,20 +818,30 @@ bt_william_hill_event_list_merge(bt_event_list *dst,
 }
 
 bt_event_list *
-bt_william_hill_events_list_fetch()
+bt_william_hill_events_list_fetch(bt_william_hill_schedule *const schedule)
 {
     bt_event_list *list;
+    enum bt_http_result status;
     char *html;
-    const char *url;
-    url = "http://sports.williamhill.com/bet/es-es/betlive/24";
-    html = bt_http_get(url, bt_william_hill_use_tor(), NULL, NULL);
+    // If the page did not change neither did the events, so there is
+    // nothing to parse or look up in the database
+    html = bt_http_get_cached(EVENTS_URL, bt_william_hill_use_tor(), NULL, NULL, &status);
     if (html == NULL)
         return NULL;
-    list = bt_william_hill_extract_events(html);
+    list = bt_william_hill_extract_events(html, strlen(html), schedule);
     bt_free(html);
+    // Try this same page again next time
+    if (list == NULL)
+        bt_william_hill_events_list_invalidate();
     return list;
 }
 
+void
+bt_william_hill_events_list_invalidate(void)
+{
+    bt_http_cache_invalidate(EVENTS_URL);
+}
+
 size_t
 bt_william_hill_event_list_get_count(const bt_event_list *const list)
 {
@@ -609,13 +864,20 @@ bt_william_hill_event_get_category(const bt_event *const event)
 int
 bt_william_hill_event_get_current_set(const bt_event *const event)
 {
-    return event->current_set;
+    return bt_match_state_get_current_set(&event->state);
 }
 
 void
 bt_william_hill_event_set_current_set(bt_event *const event, int set)
 {
-    event->current_set = set;
+    bt_match_state_set_current_set(&event->state, set);
+}
+
+bt_match_state *
+bt_william_hill_event_get_state(const bt_event *const event)
+{
+    // Only the thread processing the event's frames should write to it
+    return (bt_match_state *) &event->state;
 }
 
 void
@@ -651,31 +913,58 @@ bt_william_hill_event_get_tour(const bt_event *const event)
     return event->tour;
 }
 
+void
+bt_william_hill_event_reset(bt_event *const event)
+{
+    bt_player *player[2];
+    // Forget everything the websocket told us about the match
+    bt_match_state_reset(&event->state);
+    event->ready4incidents = 2;
+    // Make a pointer to the first player
+    player[0] = event->players[0];
+    // Make a pointer to the second player
+    player[1] = event->players[1];
+    // Reset the MTO count value
+    player[0]->c_mto_count = player[0]->t_mto_count;
+    player[1]->c_mto_count = player[1]->t_mto_count;
+}
+
+void
+bt_william_hill_event_list_mark_dirty(bt_event_list *const list,
+                                                   const bt_event *const event)
+{
+    // Make room for it if needed
+    if (list->ndirty == list->dirtysize) {
+        size_t size;
+        int *dirty;
+        size = (list->dirtysize == 0) ? 64 : 2 * list->dirtysize;
+        dirty = bt_realloc(list->dirty, size * sizeof(*dirty));
+        if (dirty == NULL) {
+            log("ERROR: \033[31mcannot mark event\033[0m `%d'\n", event->id);
+            return;
+        }
+        list->dirty = dirty;
+        list->dirtysize = size;
+    }
+    list->dirty[list->ndirty++] = event->id;
+}
+
 void
 bt_william_hill_event_list_unsubscribe_all(bt_event_list *list)
 {
+    // Every event is going to be marked, so forget the previous ones
+    list->ndirty = 0;
     // Iterate through all the elements
     for (size_t idx = 0; idx < list->count; ++idx) {
-        bt_player *player[2];
         bt_event *event;
         // Make a pointer to the event
         event = list->items[idx];
         if (event == NULL)
             continue;
-        // Unsubscribe the event
-        event->current_set = -1;
-        event->ready4incidents = 2;
+        // Unsubscribe the event, the match state is reset by whoever
+        // processes it's frames with `bt_william_hill_event_reset()`
         event->subscribed = false;
-        // Make a pointer to the first player
-        player[0] = event->players[0];
-        // Make a pointer to the second player
-        player[1] = event->players[1];
-        // Reset the MTO count value
-        player[0]->c_mto_count = player[0]->t_mto_count;
-        player[1]->c_mto_count = player[1]->t_mto_count;
-
-        memset(&player[0]->score, 0, sizeof(player[0]->score));
-        memset(&player[1]->score, 0, sizeof(player[0]->score));
+        bt_william_hill_event_list_mark_dirty(list, event);
     }
 }
 
@@ -683,50 +972,44 @@ int
 bt_william_hill_event_list_subscribe_all(
                    const bt_websocket_connection *const ws, bt_event_list *list)
 {
-    size_t count;
-    bool invalid;
-    // Lock the mutex to access the context variables
-    bt_global_lock();
-    // Check if the list is valid, store the number of elements
-    // of the list in `count` and check whether it's `0`.
-    invalid = ((list == NULL) || ((count = list->count) == 0));
-    // Unlock the mutex and let other threads work meanwhile
-    bt_global_unlock();
-    // Check if this is a valid request to subscribe the events
-    if (invalid == true)
+    bt_string_builder *batch;
+    // Check if this is a valid request to subscribe the events, and
+    // if there is anything to do at all
+    if ((list == NULL) || (list->ndirty == 0))
+        return 0;
+    batch = bt_string_builder_new();
+    if (batch == NULL)
         return 0;
-    // Iterata
-    for (size_t i = 0; i < count; ++i) {
+    // Pack the requests of all the pending events in as few frames as
+    // possible, this list is only touched by the listener thread
+    for (size_t idx = 0; idx < list->ndirty; ++idx) {
         bt_event *event;
-        bool subscribed;
-        // Lock the mutex to access shared data
-        bt_global_lock();
-        // Make a pointer to ehe event
-        event = list->items[i];
-        // Check if it's alredy subscribed
-        subscribed = ((event != NULL) && (event->subscribed == true));
-        // Unlock the mutex and let other threads advance
-        bt_global_unlock();
-        // If it's subscribed already, go to the next item
-        if (subscribed == true)
+        // It might have been removed after it was marked
+        event = bt_william_hill_event_list_find(list, list->dirty[idx]);
+        if ((event == NULL) || (event->subscribed == true))
             continue;
-        // Try to subscribe it and store the success result in `subscribed`
-        // in order to update the event in a safe place
-        subscribed = bt_william_hill_topics_subscribe_event(event, ws);
         // Abort this on failure, because it might imply that `websocket'
-        // became a dangling pointer.
-        if (subscribed == false)
-            return  -1;
-        // Lock the mutex to alter the shared data
-        bt_global_lock();
-        // Update the subscription status
+        // became a dangling pointer. The events stay marked, and they will
+        // be marked again anyway after reconnecting
+        if (bt_william_hill_topic_batch_add(batch, ws->ws, event->subscription) == false)
+            goto error;
+    }
+    // Send the last frame
+    if (bt_william_hill_topic_batch_send(batch, ws->ws) == false)
+        goto error;
+    // Update the subscription status now that all the requests were sent
+    for (size_t idx = 0; idx < list->ndirty; ++idx) {
+        bt_event *event;
+        event = bt_william_hill_event_list_find(list, list->dirty[idx]);
         if (event != NULL)
-            event->subscribed = subscribed;
-        // Unlock the mutex so other threads can continue using
-        // the context.
-        bt_global_unlock();
+            event->subscribed = true;
     }
+    list->ndirty = 0;
+    bt_string_builder_free(batch);
     return 0;
+error:
+    bt_string_builder_free(batch);
+    return -1;
 }
 
 bool
@@ -737,6 +1020,24 @@ bt_william_hill_event_is_ready_for_incidents(bt_event *const event)
     return (--event->ready4incidents == 0);
 }
 
+bt_topic *
+bt_william_hill_event_get_topic(const bt_event *const event,
+                                                       enum bt_topic_type type)
+{
+    // Allow `InvalidTopic' so the result of a name lookup can be
+    // passed directly
+    if ((type < 0) || (type >= TopicCount))
+        return NULL;
+    return event->topics[type];
+}
+
+void
+bt_william_hill_event_set_topic(bt_event *const event,
+                                  enum bt_topic_type type, bt_topic *const topic)
+{
+    event->topics[type] = topic;
+}
+
 const char *
 bt_william_hill_event_get_date(const bt_event * const event)
 {
@@ -6,17 +6,57 @@
 #include <bt-channel-settings.h>
 #include <bt-william-hill-events.h>
 #include <bt-william-hill.h>
+#include <bt-william-hill-pipeline.h>
+#include <bt-william-hill-capture.h>
+#include <bt-william-hill-recovery.h>
+#include <bt-william-hill-schedule.h>
 #include <bt-private.h>
 #include <bt-daemon.h>
+#include <bt-memory.h>
 
 #include <pthread.h>
 #include <unistd.h>
+#include <poll.h>
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
 
 #include <bt-debug.h>
 #include <bt-util.h>
 
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
+
+// The connections in the pool, each one runs in it's own thread
+#define BT_WILLIAM_HILL_MAX_CONNECTIONS 8
+// How often the queue depth and latencies are reported
+#define BT_WILLIAM_HILL_REPORT_INTERVAL 60000000000ULL
+// Frames read in a row before checking the other sources again
+#define BT_WILLIAM_HILL_DRAIN_LIMIT 64
+
+// What woke up the connection loop, it's stored in the `epoll' event
+enum bt_william_hill_loop_source {
+    LoopEvents,
+    LoopRequests,
+    LoopTimer,
+    LoopWebsocket
+};
+
+typedef struct bt_william_hill_loop {
+    int epoll;
+    // Liveness and report deadlines, `CLOCK_MONOTONIC'
+    int timer;
+    // The websocket being watched, it changes when reconnecting
+    const struct httpio *link;
+    int socket;
+} bt_william_hill_loop;
+
+typedef struct bt_william_hill_connection {
+    pthread_t thread;
+    bt_context *context;
+    size_t index;
+} bt_william_hill_connection;
 
 static void bt_william_hill_websocket_reconnect(bt_websocket_connection *wsc);
 static int
@@ -52,20 +92,32 @@ static void
 bt_william_hill_websocket_reconnect(bt_websocket_connection *wsc)
 {
     struct httpio *previous;
+    char *greeting;
     // Grab the pointer to the previous socket
     previous = wsc->ws;
-    // Create the WebSocket connection
-    wsc->ws = bt_william_hill_websocket_connect();
-    while ((wsc->ws == NULL) && (bt_isrunning(wsc->context) == true)) {
-        wsc->ws = bt_william_hill_websocket_connect();
-        bt_sleep(5);
+    // Take the standby connection, or wait until there is one
+    wsc->ws = bt_william_hill_recovery_connect(wsc->recovery, wsc->context, &greeting);
+    if (wsc->ws == NULL) {
+        // We are stopping
+        httpio_disconnect(previous);
+        bt_free(greeting);
+        return;
     }
-    // Lock the MUTEX
-    bt_global_lock();
+    // Mark the new connection in the capture, the frames that follow
+    // belong to it and the first one is the server's greeting
+    bt_william_hill_capture_write(wsc->capture,
+                                      bt_william_hill_pipeline_now(), NULL, 0);
+    if (greeting != NULL) {
+        bt_william_hill_capture_write(wsc->capture,
+                        bt_william_hill_pipeline_now(), greeting, strlen(greeting));
+    }
+    bt_free(greeting);
     // Remove the events so they can be re-subscribed
     bt_unsubscribe_events(wsc->context);
-    // Unlock the MUTEX
-    bt_global_unlock();
+    // And let the workers forget what they knew about the matches, this
+    // is queued behind the frames from the previous connection
+    bt_william_hill_pipeline_reset(wsc->pipeline,
+                                        bt_context_get_events(wsc->context));
     // Setup the websocket paramters. This will allow the
     // program to control the connection status and errors
     // that might occur so it can recover.
@@ -76,79 +128,429 @@ bt_william_hill_websocket_reconnect(bt_websocket_connection *wsc)
     httpio_disconnect(previous);
 }
 
-void *
-bt_william_hill_events_listener(void *context)
+static void
+bt_william_hill_pipeline_report(const bt_william_hill_pipeline *const pipeline)
+{
+    bt_william_hill_pipeline_stats stats;
+    const bt_pipeline_stage_stats *stages[3];
+    const char *names[] = {"decode", "wait", "process"};
+    bt_william_hill_pipeline_get_stats(pipeline, &stats);
+    stages[0] = &stats.decode;
+    stages[1] = &stats.wait;
+    stages[2] = &stats.process;
+    log("pipeline: \033[34m%zu\033[0m workers, depth \033[34m%zu\033[0m "
+                         "(max %zu)\n", stats.workers, stats.depth, stats.max_depth);
+    for (size_t idx = 0; idx < countof(stages); ++idx) {
+        const bt_pipeline_stage_stats *stage;
+        stage = stages[idx];
+        if (stage->count == 0)
+            continue;
+        log("\t%-8s avg %.1f us, max %.1f us (%llu frames)\n", names[idx],
+                           1.0E-3 * stage->total / stage->count, 1.0E-3 * stage->max,
+                                               (unsigned long long) stage->count);
+    }
+    // Should be zero once every topic and event is known
+    if (stats.process.count != 0) {
+        log("\tworkers  %.2f allocations per frame\n",
+                     (double) stats.process.allocations / stats.process.count);
+    }
+}
+
+static void
+bt_william_hill_reader_report(size_t index, uint64_t frames, uint64_t allocations)
+{
+    if (frames == 0)
+        return;
+    log("[%zu] reader: \033[34m%llu\033[0m frames, %.2f allocations per frame\n",
+                     index, (unsigned long long) frames, (double) allocations / frames);
+}
+
+static void
+bt_william_hill_recovery_report(bt_william_hill_recovery *const recovery)
+{
+    bt_william_hill_recovery_stats stats;
+    bt_william_hill_recovery_get_stats(recovery, &stats);
+    if (stats.count == 0)
+        return;
+    log("reconnections: \033[34m%llu\033[0m (%llu from standby), "
+             "avg %.1f ms, max %.1f ms, %llu failed attempts\n",
+                  (unsigned long long) stats.count, (unsigned long long) stats.promoted,
+                  1.0E-6 * stats.total / stats.count, 1.0E-6 * stats.max,
+                                          (unsigned long long) stats.failures);
+}
+
+static int
+bt_william_hill_websocket_fd(const struct httpio *const ws)
+{
+#ifdef HAVE_HTTPIO_GET_FD
+    if (ws == NULL)
+        return -1;
+    return httpio_get_fd(ws);
+#else
+    // Without it the websocket is polled in slices
+    (void) ws;
+    return -1;
+#endif
+}
+
+static bool
+bt_william_hill_loop_add(bt_william_hill_loop *const loop, int fd,
+                                        enum bt_william_hill_loop_source source)
+{
+    struct epoll_event event;
+    if (fd == -1)
+        return false;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u32 = source;
+    return (epoll_ctl(loop->epoll, EPOLL_CTL_ADD, fd, &event) == 0);
+}
+
+static void
+bt_william_hill_loop_arm(bt_william_hill_loop *const loop, uint64_t deadline)
+{
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = deadline / 1000000000ULL;
+    spec.it_value.tv_nsec = deadline % 1000000000ULL;
+    timerfd_settime(loop->timer, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+static void
+bt_william_hill_loop_watch(bt_william_hill_loop *const loop,
+                                    const bt_websocket_connection *const wsc)
+{
+    if (loop->link == wsc->ws)
+        return;
+    // The previous socket left the set when it was closed, this
+    // is in case it's still open
+    if (loop->socket != -1)
+        epoll_ctl(loop->epoll, EPOLL_CTL_DEL, loop->socket, NULL);
+    loop->link = wsc->ws;
+    loop->socket = bt_william_hill_websocket_fd(wsc->ws);
+    if (bt_william_hill_loop_add(loop, loop->socket, LoopWebsocket) == false)
+        loop->socket = -1;
+}
+
+static bool
+bt_william_hill_loop_init(bt_william_hill_loop *const loop,
+                                    const bt_websocket_connection *const wsc)
+{
+    loop->link = NULL;
+    loop->socket = -1;
+    loop->timer = -1;
+    loop->epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epoll == -1)
+        return false;
+    loop->timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (loop->timer == -1)
+        return false;
+    // New events from the provider and stop requests, subscriptions
+    // requested by the workers, and the deadlines
+    if (bt_william_hill_loop_add(loop,
+                    bt_context_get_events_fd(wsc->context), LoopEvents) == false)
+        return false;
+    if (bt_william_hill_loop_add(loop,
+         bt_william_hill_pipeline_get_requests_fd(wsc->pipeline), LoopRequests) == false)
+        return false;
+    return bt_william_hill_loop_add(loop, loop->timer, LoopTimer);
+}
+
+static void
+bt_william_hill_loop_finalize(bt_william_hill_loop *const loop)
+{
+    if (loop->timer != -1)
+        close(loop->timer);
+    if (loop->epoll != -1)
+        close(loop->epoll);
+}
+
+static void
+bt_william_hill_connection_loop(bt_websocket_connection *const wsc,
+                                               bt_william_hill_loop *const loop)
+{
+    uint64_t reported;
+    uint64_t seen;
+    uint64_t frames;
+    uint64_t allocations;
+    double slice;
+    bool pending;
+    // When the websocket can't be watched with `epoll', wait for
+    // data in small slices so the other sources are not delayed much
+    slice = 10.0E6;
+    pending = false;
+    frames = 0;
+    allocations = 0;
+    reported = bt_william_hill_pipeline_now();
+    seen = reported;
+    bt_william_hill_loop_arm(loop, seen + BT_WILLIAM_HILL_STALE_TIMEOUT);
+    // Start the main loop for the event listener
+    while (bt_isrunning(wsc->context) == true) {
+        struct epoll_event events[4];
+        uint64_t ticks;
+        bool readable;
+        bool expired;
+        int count;
+        size_t changes;
+        // Watch the new socket, if it was replaced
+        bt_william_hill_loop_watch(loop, wsc);
+        // Don't block if there are frames left from the previous pass,
+        // they might be buffered and the socket would not wake us up
+        count = epoll_wait(loop->epoll, events, countof(events),
+                                   ((loop->socket == -1) || pending) ? 0 : -1);
+        readable = pending;
+        expired = false;
+        for (int idx = 0; idx < count; ++idx) {
+            switch (events[idx].data.u32) {
+            case LoopEvents:
+                // Apply the changes sent by the provider, this also
+                // happens when we are asked to stop
+                if ((changes = bt_context_adopt_events(wsc->context)) != 0)
+                    log("[%zu] adopted \033[34m%zu\033[0m event changes\n", wsc->index, changes);
+                break;
+            case LoopRequests:
+                // Send the subscriptions the workers asked for
+                bt_william_hill_pipeline_flush(wsc->pipeline);
+                break;
+            case LoopTimer:
+                // Reset it, it's armed again below
+                expired = (read(loop->timer, &ticks, sizeof(ticks)) == sizeof(ticks));
+                break;
+            case LoopWebsocket:
+                readable = true;
+                break;
+            }
+        }
+        // Subscribe the events that were added or need it again,
+        // nothing happens if there are none
+        if (bt_william_hill_subscribe_events(wsc, wsc->context) == -1) {
+            bt_william_hill_websocket_reconnect(wsc);
+            seen = bt_william_hill_pipeline_now();
+            pending = false;
+            continue;
+        }
+        if ((readable == false) && (loop->socket == -1))
+            readable = httpio_has_data(wsc->ws, slice);
+        pending = false;
+        // Read what the server sent, but not forever so the other
+        // sources are checked too
+        for (size_t idx = 0; (readable == true) &&
+                                 (idx < BT_WILLIAM_HILL_DRAIN_LIMIT); ++idx) {
+            size_t before;
+            seen = bt_william_hill_pipeline_now();
+            before = bt_memory_thread_allocations();
+            if (bt_william_hill_handle_websocket_frame(wsc) == -1) {
+                // On error reconnect
+                bt_william_hill_websocket_reconnect(wsc);
+                break;
+            }
+            allocations += bt_memory_thread_allocations() - before;
+            frames += 1;
+            readable = httpio_has_data(wsc->ws, 0);
+            pending = readable;
+        }
+        if (expired == false)
+            continue;
+        // A deadline has passed, but the one that was armed might have
+        // been moved since
+        if (bt_william_hill_pipeline_now() - seen >= BT_WILLIAM_HILL_STALE_TIMEOUT) {
+            log("[%zu] WebSocket timed out, reconnecting!!!\n", wsc->index);
+            // The websocket sends the current Unix Time every 15
+            // seconds, if nothing arrived since then we probably
+            // lost the websocket so a reconnection is required.
+            bt_william_hill_websocket_reconnect(wsc);
+            seen = bt_william_hill_pipeline_now();
+            pending = false;
+        }
+        // Show the queue depth and latencies once a minute
+        if (bt_william_hill_pipeline_now() - reported >= BT_WILLIAM_HILL_REPORT_INTERVAL) {
+            bt_william_hill_pipeline_report(wsc->pipeline);
+            bt_william_hill_reader_report(wsc->index, frames, allocations);
+            bt_william_hill_recovery_report(wsc->recovery);
+            bt_william_hill_capture_flush(wsc->capture);
+            reported = bt_william_hill_pipeline_now();
+        }
+        // Wake up again at the nearest deadline
+        if (seen + BT_WILLIAM_HILL_STALE_TIMEOUT < reported + BT_WILLIAM_HILL_REPORT_INTERVAL)
+            bt_william_hill_loop_arm(loop, seen + BT_WILLIAM_HILL_STALE_TIMEOUT);
+        else
+            bt_william_hill_loop_arm(loop, reported + BT_WILLIAM_HILL_REPORT_INTERVAL);
+    }
+}
+
+static void *
+bt_william_hill_connection_main(void *data)
 {
     bt_websocket_connection wsc;
-    double timeout;
-    // This is a good timeout, the websocket sends the current
-    // Unix Time every 15 seconds, if nothing is received within
-    // 20 seconds, it means we probably lost the websocket so
-    // a reconnection is required.
-    timeout = 30.0E9;
-    // Grab a pointer to the context variable
+    bt_william_hill_connection *connection;
+    bt_william_hill_loop loop;
+    bt_context *context;
+    // This connection has it's own context, with only the events
+    // assigned to it
+    connection = data;
+    context = connection->context;
     wsc.context = context;
+    wsc.index = connection->index;
     // Avoid undefined behavior
     wsc.ws = NULL;
-    // Make the connection
-    bt_william_hill_websocket_reconnect(&wsc);
-    // Initialize the database connection for this thread
-    bt_database_initialize();
-    // Start the main loop for the event listener
-    while (bt_isrunning(context) == true) {
-        // Subscribe all the events currently in the queue
-        if (bt_william_hill_subscribe_events(&wsc, context) == -1) {
-            bt_william_hill_websocket_reconnect(&wsc);
-        } else if (httpio_has_data(wsc.ws, timeout) == true) {
-            // Read the data from the server
-            if (bt_william_hill_handle_websocket_frame(wsc.ws, context) == -1)
-            // On error reconnect
-                bt_william_hill_websocket_reconnect(&wsc);
-        } else {
-            log("WebSocket timed out, reconnecting!!!\n");
-            // This means that there was no data in 20 seconds
-            // so as mentioned before, reconnection is needed
-            bt_william_hill_websocket_reconnect(&wsc);
-        }
+    // Record the raw frames, only if `WILLIAM_HILL_CAPTURE' is set
+    wsc.capture = bt_william_hill_capture_open(wsc.index);
+    // This thread only reads and decodes frames, the workers in the
+    // pipeline process them
+    wsc.pipeline = bt_william_hill_pipeline_new(&wsc);
+    if (wsc.pipeline == NULL) {
+        log("ERROR: \033[31mcannot start the frame workers\033[0m\n");
+        bt_william_hill_capture_close(wsc.capture);
+        return NULL;
+    }
+    // Keeps a connection ready to replace this one when it fails
+    wsc.recovery = bt_william_hill_recovery_new(wsc.index);
+    if (wsc.recovery == NULL) {
+        log("ERROR: \033[31mcannot start the standby connection\033[0m\n");
+        bt_william_hill_pipeline_free(wsc.pipeline);
+        bt_william_hill_capture_close(wsc.capture);
+        return NULL;
     }
-    // Release channel settings
-    bt_channel_settings_finalize();
+    // Wait for every source at once
+    if (bt_william_hill_loop_init(&loop, &wsc) == true) {
+        // Removed events might still have frames in the pipeline
+        bt_context_set_event_release(context,
+                                   bt_william_hill_pipeline_release, wsc.pipeline);
+        // Make the connection
+        bt_william_hill_websocket_reconnect(&wsc);
+        bt_william_hill_connection_loop(&wsc, &loop);
+        // From now on removed events are freed directly
+        bt_context_set_event_release(context, NULL, NULL);
+    } else {
+        log("ERROR: \033[31mcannot create the event loop\033[0m\n");
+    }
+    bt_william_hill_loop_finalize(&loop);
+    // Stop the workers
+    bt_william_hill_pipeline_free(wsc.pipeline);
     // Close the connection, if this is reached someone
     // has asked the whole program to stop
     httpio_disconnect(wsc.ws);
-    // Release database resources for this thread
-    bt_database_finalize();
+    bt_william_hill_recovery_free(wsc.recovery);
+    bt_william_hill_capture_close(wsc.capture);
+    return NULL;
+}
+
+static size_t
+bt_william_hill_get_connection_count(void)
+{
+    const char *envvar;
+    long int count;
+    char *endptr;
+    envvar = getenv("WILLIAM_HILL_CONNECTIONS");
+    if (envvar == NULL)
+        return 2;
+    count = strtol(envvar, &endptr, 10);
+    if ((*endptr != '\0') || (count < 1))
+        return 1;
+    if (count > BT_WILLIAM_HILL_MAX_CONNECTIONS)
+        return BT_WILLIAM_HILL_MAX_CONNECTIONS;
+    return count;
+}
+
+void *
+bt_william_hill_events_listener(void *data)
+{
+    bt_william_hill_connection connections[BT_WILLIAM_HILL_MAX_CONNECTIONS];
+    bt_context *contexts[BT_WILLIAM_HILL_MAX_CONNECTIONS];
+    struct pollfd pfd;
+    bt_context *context;
+    size_t count;
+    size_t started;
+    context = data;
+    count = bt_william_hill_get_connection_count();
+    // Each connection gets it's own context, so it owns it's events and
+    // topics (aliases are per websocket session) and can reconnect
+    // without touching the others
+    for (started = 0; started < count; ++started) {
+        bt_william_hill_connection *connection;
+        connection = &connections[started];
+        connection->index = started;
+        connection->context = bt_create_context();
+        if (connection->context == NULL)
+            break;
+        contexts[started] = connection->context;
+        if (pthread_create(&connection->thread, NULL,
+                        bt_william_hill_connection_main, connection) == 0)
+            continue;
+        bt_context_free(connection->context);
+        break;
+    }
+    if (started > 0)
+        log("listening with \033[34m%zu\033[0m websocket connections\n", started);
+    pfd.fd = bt_context_get_events_fd(context);
+    pfd.events = POLLIN;
+    // Route the events from the provider to their connection
+    while ((started > 0) && (bt_isrunning(context) == true)) {
+        bt_context_forward_events(context, contexts, started);
+        // Wake up when the provider publishes, or now and then to
+        // retry changes that did not fit in a connection's queue
+        poll(&pfd, (pfd.fd == -1) ? 0 : 1, 100);
+    }
+    // Stop every connection and wait for them to release their resources
+    for (size_t idx = 0; idx < started; ++idx)
+        bt_context_stop(contexts[idx]);
+    for (size_t idx = 0; idx < started; ++idx) {
+        pthread_join(connections[idx].thread, NULL);
+        bt_context_free(contexts[idx]);
+    }
     bt_notify_thread_end();
     return NULL;
 }
 
+static void
+bt_william_hill_provider_wait(bt_context *const context, unsigned int seconds)
+{
+    size_t dropped;
+    // The wait can be long at night, so don't delay stopping
+    for (unsigned int idx = 0; (idx < seconds) && (bt_isrunning(context) == true); ++idx) {
+        // Take back the events the server removed, every second so
+        // the queue doesn't fill up while waiting
+        if ((dropped = bt_context_collect_dropped_events(context)) != 0)
+            log("\033[34m%zu\033[0m events removed by the server will be published again\n", dropped);
+        bt_sleep(1);
+    }
+}
+
 void *
 bt_william_hill_events_provider(void *data)
 {
+    bt_william_hill_schedule *schedule;
     bt_context *context;
+    unsigned int previous;
     // Initialize database connection for this thread
     bt_database_initialize();
     // Make a pointer with the valid type to the running context
     context = data;
+    // If this fails we just poll every minute, as it was always done
+    schedule = bt_william_hill_schedule_new();
+    previous = 0;
     // Start the main loop of this thread
     while (bt_isrunning(context) == true) {
         bt_event_list *list;
+        unsigned int interval;
         // List available events at the william hill website
-        list = bt_william_hill_events_list_fetch();
+        list = bt_william_hill_events_list_fetch(schedule);
         if (list != NULL) {
-            // Lock the context mutex so it's safe to access the data
-            bt_global_lock();
-            // Move the events from this thread the other,
-            // feed the listener
+            // Hand the new and removed events to the listener, it
+            // takes them without blocking. The context owns the list
+            // after this call
             bt_transfer_new_bt_william_hill_events(context, list);
-            // Free the list
-            bt_william_hill_event_list_free(list);
-            // Release the mutex so the listener can continue
-            bt_global_unlock();
         }
-        // Wait one minute to check the website again
-        bt_sleep(60);
+        // Often when a match is about to start, rarely when nothing is
+        interval = 60;
+        if (schedule != NULL)
+            interval = bt_william_hill_schedule_next(schedule, time(NULL), list != NULL);
+        if (interval != previous)
+            log("checking William Hill events every \033[34m%u\033[0m s\n", interval);
+        previous = interval;
+        bt_william_hill_provider_wait(context, interval);
     }
+    bt_william_hill_schedule_free(schedule);
     // Release resources used by the database connection
     bt_database_finalize();
     bt_notify_thread_end();
@@ -0,0 +1,536 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+
+#include <pthread.h>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <bt-william-hill-pipeline.h>
+#include <bt-william-hill-events.h>
+#include <bt-william-hill.h>
+#include <bt-channel-settings.h>
+#include <bt-spsc-queue.h>
+#include <bt-arena.h>
+#include <bt-string-builder.h>
+#include <bt-database.h>
+#include <bt-context.h>
+#include <bt-private.h>
+#include <bt-memory.h>
+#include <bt-debug.h>
+#include <bt-util.h>
+
+// Frames waiting for each worker, when it fills up the reader waits
+#define BT_PIPELINE_JOBS_CAPACITY 4096
+// Subscriptions requested by each worker, waiting to be sent
+#define BT_PIPELINE_REQUESTS_CAPACITY 256
+#define BT_PIPELINE_MAX_WORKERS 16
+// Processed jobs given back to the reader for reuse, and the smallest
+// value a job can hold so most frames fit in a reused one
+#define BT_PIPELINE_SPARE_CAPACITY 4096
+#define BT_PIPELINE_JOB_MIN_CAPACITY 256
+
+enum bt_pipeline_job_type {
+    JobValue,
+    JobReset,
+    JobRelease
+};
+
+typedef struct bt_pipeline_job {
+    enum bt_pipeline_job_type type;
+    bt_event *event;
+    enum bt_topic_type topic;
+    uint64_t received;
+    uint64_t queued;
+    bt_latency_trace trace;
+    size_t length;
+    size_t capacity;
+    char value[];
+} bt_pipeline_job;
+
+typedef struct bt_pipeline_worker {
+    bt_william_hill_pipeline *pipeline;
+    pthread_t thread;
+    bool started;
+    // The reader produces, the worker consumes. `notify` is an eventfd
+    // signaled after each push
+    bt_spsc_queue *jobs;
+    int notify;
+    // The worker produces, the reader consumes
+    bt_spsc_queue *requests;
+    bt_spsc_queue *spare;
+    // Written only by the reader
+    bt_pipeline_stage_stats decode;
+    size_t max_depth;
+    // Written only by the worker
+    bt_pipeline_stage_stats wait;
+    bt_pipeline_stage_stats process;
+} bt_pipeline_worker;
+
+struct bt_william_hill_pipeline {
+    bt_websocket_connection *wsc;
+    // Only used by the reader, to pack the requests in frames
+    bt_string_builder *batch;
+    // Signaled by the workers when they queue a request
+    int requests;
+    bt_pipeline_worker **workers;
+    size_t count;
+    bool running;
+};
+
+uint64_t
+bt_william_hill_pipeline_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void
+bt_pipeline_backoff(void)
+{
+    struct timespec delay;
+    // A full queue drains quickly, don't burn the CPU meanwhile
+    delay.tv_sec = 0;
+    delay.tv_nsec = 1000000;
+    nanosleep(&delay, NULL);
+}
+
+static bool
+bt_pipeline_isrunning(const bt_william_hill_pipeline *const pipeline)
+{
+    return __atomic_load_n(&pipeline->running, __ATOMIC_ACQUIRE);
+}
+
+static void
+bt_pipeline_stage_add(bt_pipeline_stage_stats *const stage, uint64_t elapsed)
+{
+    // Every stage has a single writer, the atomics are for the readers
+    __atomic_store_n(&stage->count, stage->count + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&stage->total, stage->total + elapsed, __ATOMIC_RELAXED);
+    if (elapsed > stage->max)
+        __atomic_store_n(&stage->max, elapsed, __ATOMIC_RELAXED);
+}
+
+static void
+bt_pipeline_stage_add_allocations(bt_pipeline_stage_stats *const stage,
+                                                            size_t allocations)
+{
+    __atomic_store_n(&stage->allocations,
+                      stage->allocations + allocations, __ATOMIC_RELAXED);
+}
+
+static void
+bt_pipeline_stage_sum(bt_pipeline_stage_stats *const target,
+                                     const bt_pipeline_stage_stats *const stage)
+{
+    uint64_t max;
+    target->count += __atomic_load_n(&stage->count, __ATOMIC_RELAXED);
+    target->total += __atomic_load_n(&stage->total, __ATOMIC_RELAXED);
+    target->allocations += __atomic_load_n(&stage->allocations, __ATOMIC_RELAXED);
+    max = __atomic_load_n(&stage->max, __ATOMIC_RELAXED);
+    if (max > target->max)
+        target->max = max;
+}
+
+static bool
+bt_pipeline_worker_subscribe(const char *const path, void *data)
+{
+    bt_pipeline_worker *worker;
+    char *request;
+    worker = data;
+    // Only the reader writes to the websocket, so hand it the request
+    request = bt_strdup(path);
+    if (request == NULL)
+        return false;
+    while (bt_spsc_queue_push(worker->requests, request) == false) {
+        if (bt_pipeline_isrunning(worker->pipeline) == false) {
+            bt_free(request);
+            return false;
+        }
+        bt_pipeline_backoff();
+    }
+    // Wake the reader up, so it sends it now
+    eventfd_write(worker->pipeline->requests, 1);
+    return true;
+}
+
+static void
+bt_pipeline_worker_handle_job(bt_pipeline_worker *const worker,
+                                                    bt_pipeline_job *const job)
+{
+    switch (job->type) {
+    case JobValue:
+        bt_william_hill_handle_topic_value(job->event, job->topic,
+      job->value, job->length, &job->trace, bt_pipeline_worker_subscribe, worker);
+        break;
+    case JobReset:
+        bt_william_hill_event_reset(job->event);
+        break;
+    case JobRelease:
+        // Every frame for this event that was queued before is done
+        bt_william_hill_event_free(job->event);
+        break;
+    }
+}
+
+static void
+bt_pipeline_worker_recycle(bt_pipeline_worker *const worker,
+                                                    bt_pipeline_job *const job)
+{
+    // Give it back to the reader, unless it already has plenty
+    if (bt_spsc_queue_push(worker->spare, job) == false)
+        bt_free(job);
+}
+
+static void *
+bt_pipeline_worker_main(void *data)
+{
+    bt_pipeline_worker *worker;
+    struct pollfd pfd;
+    bt_arena *arena;
+    worker = data;
+    // MySQL connections and channel settings are per thread
+    bt_database_initialize();
+    // Temporary strings built while handling a frame live here
+    arena = bt_arena_thread();
+    pfd.fd = worker->notify;
+    pfd.events = POLLIN;
+    while (bt_pipeline_isrunning(worker->pipeline) == true) {
+        bt_pipeline_job *job;
+        uint64_t dequeued;
+        size_t allocations;
+        job = bt_spsc_queue_pop(worker->jobs);
+        if (job == NULL) {
+            eventfd_t value;
+            // Wait until the reader pushes something, but check
+            // whether we should stop every now and then
+            if (poll(&pfd, 1, 100) > 0)
+                eventfd_read(worker->notify, &value);
+            continue;
+        }
+        dequeued = bt_william_hill_pipeline_now();
+        bt_pipeline_stage_add(&worker->wait, dequeued - job->queued);
+        allocations = bt_memory_thread_allocations();
+        bt_pipeline_worker_handle_job(worker, job);
+        bt_pipeline_stage_add(&worker->process,
+                                  bt_william_hill_pipeline_now() - dequeued);
+        bt_pipeline_stage_add_allocations(&worker->process,
+                             bt_memory_thread_allocations() - allocations);
+        if (arena != NULL)
+            bt_arena_reset(arena);
+        bt_pipeline_worker_recycle(worker, job);
+    }
+    bt_arena_thread_release();
+    bt_channel_settings_finalize();
+    bt_database_finalize();
+    return NULL;
+}
+
+static bt_pipeline_worker *
+bt_pipeline_get_worker(const bt_william_hill_pipeline *const pipeline,
+                                                   const bt_event *const event)
+{
+    int id;
+    // Shard by match, so the frames of a match are processed in order
+    id = bt_william_hill_event_get_id(event);
+    return pipeline->workers[(unsigned int) id % pipeline->count];
+}
+
+static bool
+bt_pipeline_push(bt_william_hill_pipeline *const pipeline,
+                                     bt_pipeline_job *const job, bool required)
+{
+    bt_pipeline_worker *worker;
+    uint64_t elapsed;
+    bool value;
+    size_t depth;
+    worker = bt_pipeline_get_worker(pipeline, job->event);
+    // The worker owns `job` as soon as it's pushed, don't touch it after
+    value = (job->type == JobValue);
+    for (;;) {
+        job->queued = bt_william_hill_pipeline_now();
+        elapsed = job->queued - job->received;
+        if (bt_spsc_queue_push(worker->jobs, job) == true)
+            break;
+        // Values can be dropped when stopping, but events to be released
+        // or reset must reach the worker
+        if ((required == false) &&
+                     (bt_isrunning(pipeline->wsc->context) == false)) {
+            bt_free(job);
+            return false;
+        }
+        // The worker might be waiting for us to take it's requests
+        bt_william_hill_pipeline_flush(pipeline);
+        bt_pipeline_backoff();
+    }
+    if (value == true)
+        bt_pipeline_stage_add(&worker->decode, elapsed);
+    depth = bt_spsc_queue_get_count(worker->jobs);
+    if (depth > worker->max_depth)
+        __atomic_store_n(&worker->max_depth, depth, __ATOMIC_RELAXED);
+    eventfd_write(worker->notify, 1);
+    return true;
+}
+
+static bt_pipeline_job *
+bt_pipeline_job_new(const bt_william_hill_pipeline *const pipeline,
+           enum bt_pipeline_job_type type, bt_event *const event, size_t length)
+{
+    bt_pipeline_worker *worker;
+    bt_pipeline_job *job;
+    // The worker that will get it has it's processed jobs waiting
+    worker = bt_pipeline_get_worker(pipeline, event);
+    job = bt_spsc_queue_pop(worker->spare);
+    if ((job != NULL) && (job->capacity < length)) {
+        // Rare, frames are small
+        bt_free(job);
+        job = NULL;
+    }
+    if (job == NULL) {
+        size_t capacity;
+        capacity = (length < BT_PIPELINE_JOB_MIN_CAPACITY) ?
+                                         BT_PIPELINE_JOB_MIN_CAPACITY : length;
+        job = bt_malloc(sizeof(*job) + capacity + 1);
+        if (job == NULL)
+            return NULL;
+        job->capacity = capacity;
+    }
+    job->type = type;
+    job->event = event;
+    job->topic = InvalidTopic;
+    job->received = bt_william_hill_pipeline_now();
+    job->length = length;
+    job->value[length] = '\0';
+    return job;
+}
+
+bool
+bt_william_hill_pipeline_submit(bt_william_hill_pipeline *const pipeline,
+           bt_event *const event, enum bt_topic_type type,
+        const char *const value, size_t length, const bt_latency_trace *const trace)
+{
+    bt_pipeline_job *job;
+    // The frame is released after this, so the value is copied
+    job = bt_pipeline_job_new(pipeline, JobValue, event, length);
+    if (job == NULL)
+        return false;
+    memcpy(job->value, value, length);
+    job->topic = type;
+    job->trace = *trace;
+    job->received = trace->marks[LatencyReceived];
+    return bt_pipeline_push(pipeline, job, false);
+}
+
+void
+bt_william_hill_pipeline_reset(bt_william_hill_pipeline *const pipeline,
+                                             const bt_event_list *const list)
+{
+    for (size_t idx = 0; idx < bt_william_hill_event_list_get_count(list); ++idx) {
+        bt_pipeline_job *job;
+        job = bt_pipeline_job_new(pipeline, JobReset,
+                               bt_william_hill_event_list_get_item(list, idx), 0);
+        if (job == NULL)
+            continue;
+        bt_pipeline_push(pipeline, job, true);
+    }
+}
+
+void
+bt_william_hill_pipeline_release(bt_event *event, void *data)
+{
+    bt_pipeline_job *job;
+    job = bt_pipeline_job_new(data, JobRelease, event, 0);
+    if (job == NULL) {
+        // Leaking it is better than freeing it under the worker's feet
+        log("ERROR: \033[31mcannot release event\033[0m `%d'\n",
+                                          bt_william_hill_event_get_id(event));
+        return;
+    }
+    bt_pipeline_push(data, job, true);
+}
+
+size_t
+bt_william_hill_pipeline_flush(bt_william_hill_pipeline *const pipeline)
+{
+    struct httpio *ws;
+    eventfd_t value;
+    size_t count;
+    // Reset the notification, the queues are drained below
+    eventfd_read(pipeline->requests, &value);
+    count = 0;
+    ws = pipeline->wsc->ws;
+    for (size_t idx = 0; idx < pipeline->count; ++idx) {
+        bt_pipeline_worker *worker;
+        char *request;
+        worker = pipeline->workers[idx];
+        while ((request = bt_spsc_queue_pop(worker->requests)) != NULL) {
+            // No websocket when replaying a capture, the requests are dropped
+            if (ws != NULL)
+                bt_william_hill_topic_batch_add(pipeline->batch, ws, request);
+            bt_free(request);
+            count += 1;
+        }
+    }
+    // The requests of all the workers go in the same frames
+    if (ws != NULL)
+        bt_william_hill_topic_batch_send(pipeline->batch, ws);
+    return count;
+}
+
+int
+bt_william_hill_pipeline_get_requests_fd(
+                                const bt_william_hill_pipeline *const pipeline)
+{
+    return pipeline->requests;
+}
+
+void
+bt_william_hill_pipeline_get_stats(
+                           const bt_william_hill_pipeline *const pipeline,
+                                   bt_william_hill_pipeline_stats *const stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->workers = pipeline->count;
+    for (size_t idx = 0; idx < pipeline->count; ++idx) {
+        const bt_pipeline_worker *worker;
+        size_t depth;
+        worker = pipeline->workers[idx];
+        stats->depth += bt_spsc_queue_get_count(worker->jobs);
+        depth = __atomic_load_n(&worker->max_depth, __ATOMIC_RELAXED);
+        if (depth > stats->max_depth)
+            stats->max_depth = depth;
+        bt_pipeline_stage_sum(&stats->decode, &worker->decode);
+        bt_pipeline_stage_sum(&stats->wait, &worker->wait);
+        bt_pipeline_stage_sum(&stats->process, &worker->process);
+    }
+}
+
+static void
+bt_pipeline_worker_free(bt_pipeline_worker *worker)
+{
+    bt_pipeline_job *job;
+    char *request;
+    if (worker == NULL)
+        return;
+    if (worker->started == true)
+        pthread_join(worker->thread, NULL);
+    // Whatever is left was never processed, but the events waiting to be
+    // released are owned by us
+    if (worker->jobs != NULL) {
+        while ((job = bt_spsc_queue_pop(worker->jobs)) != NULL) {
+            if (job->type == JobRelease)
+                bt_william_hill_event_free(job->event);
+            bt_free(job);
+        }
+        bt_spsc_queue_free(worker->jobs);
+    }
+    if (worker->requests != NULL) {
+        while ((request = bt_spsc_queue_pop(worker->requests)) != NULL)
+            bt_free(request);
+        bt_spsc_queue_free(worker->requests);
+    }
+    if (worker->spare != NULL) {
+        while ((job = bt_spsc_queue_pop(worker->spare)) != NULL)
+            bt_free(job);
+        bt_spsc_queue_free(worker->spare);
+    }
+    if (worker->notify != -1)
+        close(worker->notify);
+    bt_free(worker);
+}
+
+static bt_pipeline_worker *
+bt_pipeline_worker_new(bt_william_hill_pipeline *const pipeline)
+{
+    bt_pipeline_worker *worker;
+    worker = bt_malloc(sizeof(*worker));
+    if (worker == NULL)
+        return NULL;
+    memset(worker, 0, sizeof(*worker));
+    worker->pipeline = pipeline;
+    worker->jobs = bt_spsc_queue_new(BT_PIPELINE_JOBS_CAPACITY);
+    worker->requests = bt_spsc_queue_new(BT_PIPELINE_REQUESTS_CAPACITY);
+    worker->spare = bt_spsc_queue_new(BT_PIPELINE_SPARE_CAPACITY);
+    worker->notify = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if ((worker->jobs == NULL) || (worker->requests == NULL) ||
+                             (worker->spare == NULL) || (worker->notify == -1))
+        goto error;
+    if (pthread_create(&worker->thread, NULL, bt_pipeline_worker_main, worker) != 0)
+        goto error;
+    worker->started = true;
+    return worker;
+error:
+    bt_pipeline_worker_free(worker);
+    return NULL;
+}
+
+static size_t
+bt_pipeline_get_worker_count(void)
+{
+    const char *envvar;
+    long int count;
+    char *endptr;
+    envvar = getenv("WILLIAM_HILL_WORKERS");
+    if (envvar == NULL)
+        return 2;
+    count = strtol(envvar, &endptr, 10);
+    if ((*endptr != '\0') || (count < 1))
+        return 1;
+    if (count > BT_PIPELINE_MAX_WORKERS)
+        return BT_PIPELINE_MAX_WORKERS;
+    return count;
+}
+
+bt_william_hill_pipeline *
+bt_william_hill_pipeline_new(bt_websocket_connection *const wsc)
+{
+    bt_william_hill_pipeline *pipeline;
+    size_t count;
+    pipeline = bt_malloc(sizeof(*pipeline));
+    if (pipeline == NULL)
+        return NULL;
+    count = bt_pipeline_get_worker_count();
+    pipeline->wsc = wsc;
+    pipeline->running = true;
+    pipeline->count = 0;
+    pipeline->batch = bt_string_builder_new();
+    pipeline->requests = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    pipeline->workers = bt_malloc(count * sizeof(*pipeline->workers));
+    if ((pipeline->workers == NULL) ||
+                      (pipeline->batch == NULL) || (pipeline->requests == -1))
+        goto error;
+    for (size_t idx = 0; idx < count; ++idx) {
+        bt_pipeline_worker *worker;
+        worker = bt_pipeline_worker_new(pipeline);
+        if (worker == NULL)
+            goto error;
+        pipeline->workers[pipeline->count++] = worker;
+    }
+    log("processing frames with \033[34m%zu\033[0m workers\n", count);
+    return pipeline;
+error:
+    bt_william_hill_pipeline_free(pipeline);
+    return NULL;
+}
+
+void
+bt_william_hill_pipeline_free(bt_william_hill_pipeline *pipeline)
+{
+    if (pipeline == NULL)
+        return;
+    // Tell the workers to stop and wake them up
+    __atomic_store_n(&pipeline->running, false, __ATOMIC_RELEASE);
+    for (size_t idx = 0; idx < pipeline->count; ++idx)
+        eventfd_write(pipeline->workers[idx]->notify, 1);
+    for (size_t idx = 0; idx < pipeline->count; ++idx)
+        bt_pipeline_worker_free(pipeline->workers[idx]);
+    bt_string_builder_free(pipeline->batch);
+    if (pipeline->requests != -1)
+        close(pipeline->requests);
+    bt_free(pipeline->workers);
+    bt_free(pipeline);
+}
@@ -0,0 +1,251 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <pthread.h>
+
+#include <http-connection.h>
+#include <http-websockets.h>
+
+#include <bt-william-hill-recovery.h>
+#include <bt-william-hill-pipeline.h>
+#include <bt-william-hill.h>
+#include <bt-context.h>
+#include <bt-memory.h>
+#include <bt-debug.h>
+
+// Delay before retrying a failed connection, it doubles on each failure
+#define BT_RECOVERY_BACKOFF_BASE 250000000ULL
+#define BT_RECOVERY_BACKOFF_MAX 30000000000ULL
+// How often the standby link is checked for pings
+#define BT_RECOVERY_TEND_INTERVAL 500000000ULL
+// How often a waiting reader checks if it must stop
+#define BT_RECOVERY_WAIT_INTERVAL 100000000ULL
+
+struct bt_william_hill_recovery {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+    bool running;
+    size_t index;
+    // The standby link, and the last time something arrived through it
+    struct httpio *standby;
+    uint64_t seen;
+    // What the server said when the standby link was opened, it goes
+    // to the capture with the link
+    char *greeting;
+    // Consecutive failed attempts, for the backoff
+    unsigned int attempts;
+    unsigned int seed;
+    bt_william_hill_recovery_stats stats;
+};
+
+static void
+bt_recovery_wait(bt_william_hill_recovery *const recovery, uint64_t delay)
+{
+    struct timespec deadline;
+    uint64_t when;
+    // The condition uses `CLOCK_MONOTONIC', like the pipeline clock
+    when = bt_william_hill_pipeline_now() + delay;
+    deadline.tv_sec = when / 1000000000ULL;
+    deadline.tv_nsec = when % 1000000000ULL;
+    pthread_cond_timedwait(&recovery->condition, &recovery->mutex, &deadline);
+}
+
+static uint64_t
+bt_recovery_backoff(bt_william_hill_recovery *const recovery)
+{
+    uint64_t delay;
+    delay = BT_RECOVERY_BACKOFF_BASE;
+    for (unsigned int idx = 0; (idx < recovery->attempts) &&
+                                     (delay < BT_RECOVERY_BACKOFF_MAX); ++idx)
+        delay *= 2;
+    if (delay > BT_RECOVERY_BACKOFF_MAX)
+        delay = BT_RECOVERY_BACKOFF_MAX;
+    // Wait between half and all of it, so the connections of the pool
+    // don't all retry at the same time. The delay is in nanoseconds,
+    // far more than `RAND_MAX', so scale the random value to it
+    return delay / 2 + (uint64_t) ((double) rand_r(&recovery->seed) /
+                                                    RAND_MAX * (delay / 2));
+}
+
+static void
+bt_recovery_discard(bt_william_hill_recovery *const recovery)
+{
+    httpio_disconnect(recovery->standby);
+    recovery->standby = NULL;
+    bt_free(recovery->greeting);
+    recovery->greeting = NULL;
+}
+
+static void
+bt_recovery_tend(bt_william_hill_recovery *const recovery)
+{
+    struct httpio *link;
+    uint64_t seen;
+    uint64_t now;
+    bool alive;
+    // Answering a ping blocks, so take the link out and don't keep
+    // the readers waiting for the lock meanwhile. A reader that wants
+    // it now waits until it's back
+    link = recovery->standby;
+    seen = recovery->seen;
+    recovery->standby = NULL;
+    pthread_mutex_unlock(&recovery->mutex);
+    now = bt_william_hill_pipeline_now();
+    alive = true;
+    // The server pings the standby link too, it must answer or it will
+    // be dropped
+    if (httpio_has_data(link, 0) == true) {
+        if (bt_william_hill_websocket_keepalive(link) == 0) {
+            seen = now;
+        } else {
+            log("[%zu] standby websocket failed\n", recovery->index);
+            alive = false;
+        }
+    } else if (now - seen >= BT_WILLIAM_HILL_STALE_TIMEOUT) {
+        log("[%zu] standby websocket timed out\n", recovery->index);
+        alive = false;
+    }
+    if (alive == false)
+        httpio_disconnect(link);
+    pthread_mutex_lock(&recovery->mutex);
+    if (alive == false) {
+        bt_free(recovery->greeting);
+        recovery->greeting = NULL;
+        return;
+    }
+    recovery->standby = link;
+    recovery->seen = seen;
+    // Someone might be waiting for it
+    pthread_cond_broadcast(&recovery->condition);
+}
+
+static void *
+bt_recovery_main(void *data)
+{
+    bt_william_hill_recovery *recovery;
+    recovery = data;
+    pthread_mutex_lock(&recovery->mutex);
+    while (recovery->running == true) {
+        struct httpio *link;
+        char *greeting;
+        if (recovery->standby != NULL) {
+            bt_recovery_tend(recovery);
+            // A reader taking the link wakes us up before the timeout
+            if (recovery->standby != NULL)
+                bt_recovery_wait(recovery, BT_RECOVERY_TEND_INTERVAL);
+            continue;
+        }
+        // Connecting takes a while, specially through Tor, so don't
+        // keep the readers waiting for the lock meanwhile
+        pthread_mutex_unlock(&recovery->mutex);
+        link = bt_william_hill_websocket_connect(&greeting);
+        pthread_mutex_lock(&recovery->mutex);
+        if (link == NULL) {
+            recovery->stats.failures += 1;
+            bt_recovery_wait(recovery, bt_recovery_backoff(recovery));
+            recovery->attempts += 1;
+            continue;
+        }
+        recovery->attempts = 0;
+        recovery->standby = link;
+        recovery->greeting = greeting;
+        recovery->seen = bt_william_hill_pipeline_now();
+        // Someone might be waiting for it
+        pthread_cond_broadcast(&recovery->condition);
+    }
+    // Nobody is going to take it
+    if (recovery->standby != NULL)
+        bt_recovery_discard(recovery);
+    pthread_mutex_unlock(&recovery->mutex);
+    return NULL;
+}
+
+struct httpio *
+bt_william_hill_recovery_connect(bt_william_hill_recovery *const recovery,
+                              const bt_context *const context, char **greeting)
+{
+    struct httpio *link;
+    uint64_t start;
+    uint64_t elapsed;
+    start = bt_william_hill_pipeline_now();
+    pthread_mutex_lock(&recovery->mutex);
+    // If there is no standby link yet, wait until the thread makes one
+    while ((recovery->standby == NULL) && (bt_isrunning(context) == true))
+        bt_recovery_wait(recovery, BT_RECOVERY_WAIT_INTERVAL);
+    link = recovery->standby;
+    recovery->standby = NULL;
+    *greeting = recovery->greeting;
+    recovery->greeting = NULL;
+    if (link != NULL) {
+        elapsed = bt_william_hill_pipeline_now() - start;
+        // It was ready already, unless we had to wait for it
+        if (elapsed < BT_RECOVERY_WAIT_INTERVAL)
+            recovery->stats.promoted += 1;
+        recovery->stats.count += 1;
+        recovery->stats.total += elapsed;
+        if (elapsed > recovery->stats.max)
+            recovery->stats.max = elapsed;
+        log("[%zu] websocket ready in \033[34m%.1f\033[0m ms\n",
+                                            recovery->index, 1.0E-6 * elapsed);
+    }
+    // Start making the next standby link
+    pthread_cond_broadcast(&recovery->condition);
+    pthread_mutex_unlock(&recovery->mutex);
+    return link;
+}
+
+void
+bt_william_hill_recovery_get_stats(bt_william_hill_recovery *const recovery,
+                                   bt_william_hill_recovery_stats *const stats)
+{
+    pthread_mutex_lock(&recovery->mutex);
+    memcpy(stats, &recovery->stats, sizeof(*stats));
+    pthread_mutex_unlock(&recovery->mutex);
+}
+
+bt_william_hill_recovery *
+bt_william_hill_recovery_new(size_t index)
+{
+    bt_william_hill_recovery *recovery;
+    pthread_condattr_t attributes;
+    recovery = bt_malloc(sizeof(*recovery));
+    if (recovery == NULL)
+        return NULL;
+    memset(recovery, 0, sizeof(*recovery));
+    recovery->index = index;
+    recovery->running = true;
+    recovery->seed = (unsigned int) bt_william_hill_pipeline_now() ^ index;
+    // Timeouts are measured with the monotonic clock
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&recovery->condition, &attributes);
+    pthread_condattr_destroy(&attributes);
+    pthread_mutex_init(&recovery->mutex, NULL);
+    if (pthread_create(&recovery->thread, NULL, bt_recovery_main, recovery) != 0) {
+        pthread_cond_destroy(&recovery->condition);
+        pthread_mutex_destroy(&recovery->mutex);
+        bt_free(recovery);
+        return NULL;
+    }
+    return recovery;
+}
+
+void
+bt_william_hill_recovery_free(bt_william_hill_recovery *recovery)
+{
+    if (recovery == NULL)
+        return;
+    // Wake the thread up and wait for it, if it's connecting it will
+    // notice when it's done
+    pthread_mutex_lock(&recovery->mutex);
+    recovery->running = false;
+    pthread_cond_broadcast(&recovery->condition);
+    pthread_mutex_unlock(&recovery->mutex);
+    pthread_join(recovery->thread, NULL);
+    pthread_cond_destroy(&recovery->condition);
+    pthread_mutex_destroy(&recovery->mutex);
+    bt_free(recovery);
+}
@@ -0,0 +1,404 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <bt-william-hill-replay.h>
+#include <bt-william-hill-capture.h>
+#include <bt-william-hill-events.h>
+#include <bt-william-hill-pipeline.h>
+#include <bt-william-hill.h>
+#include <bt-telegram-channel.h>
+#include <bt-channel-settings.h>
+#include <bt-database.h>
+#include <bt-context.h>
+#include <bt-latency.h>
+#include <bt-private.h>
+#include <bt-memory.h>
+#include <bt-debug.h>
+
+// Version 1 captures don't have the server's greeting, every connection
+// in them is greeted with this one: protocol 4, connection accepted
+#define BT_REPLAY_HANDSHAKE "4\x02" "100\x02" "replay"
+// The reader flushes the subscriptions when the workers ask for them, the
+// replay does it every so many frames instead of polling for it
+#define BT_REPLAY_FLUSH_FRAMES 64
+// The captures don't have the tournament, a category is needed to decide
+// which channels get the notifications
+#define BT_REPLAY_DEFAULT_TOUR "ATP"
+
+typedef struct bt_replay_frame {
+    uint64_t received;
+    // `NULL' marks a new connection
+    char *data;
+} bt_replay_frame;
+
+typedef struct bt_replay {
+    bt_replay_frame *frames;
+    size_t count;
+    size_t size;
+    uint32_t version;
+} bt_replay;
+
+// What a control frame says about a match, to create it's event
+typedef struct bt_replay_topic {
+    int match;
+    enum bt_topic_type type;
+    const char *value;
+} bt_replay_topic;
+
+// Fake message ids, so the edits of a notification look like the live ones
+static int LastMessageId;
+
+static void
+bt_replay_release(bt_replay *const replay)
+{
+    for (size_t idx = 0; idx < replay->count; ++idx)
+        bt_free(replay->frames[idx].data);
+    bt_free(replay->frames);
+}
+
+static bool
+bt_replay_append(bt_replay *const replay, uint64_t received, char *data)
+{
+    if (replay->count == replay->size) {
+        bt_replay_frame *frames;
+        size_t size;
+        size = (replay->size == 0) ? 1024 : 2 * replay->size;
+        frames = bt_realloc(replay->frames, size * sizeof(*frames));
+        if (frames == NULL)
+            return false;
+        replay->frames = frames;
+        replay->size = size;
+    }
+    replay->frames[replay->count].received = received;
+    replay->frames[replay->count].data = data;
+    replay->count += 1;
+    return true;
+}
+
+static bool
+bt_replay_load(bt_replay *const replay, const char *const path)
+{
+    char signature[4];
+    FILE *file;
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        log("error: cannot read `%s': %s\n", path, strerror(errno));
+        return false;
+    }
+    // The header, the signature and the format version
+    if ((fread(signature, 1, sizeof(signature), file) != sizeof(signature)) ||
+                             (memcmp(signature, "BTWH", sizeof(signature)) != 0) ||
+                    (fread(&replay->version, sizeof(replay->version), 1, file) != 1) ||
+                   (replay->version == 0) ||
+                            (replay->version > BT_WILLIAM_HILL_CAPTURE_VERSION)) {
+        log("error: `%s' is not a websocket capture\n", path);
+        goto error;
+    }
+    // Load it all, so reading the file is not measured
+    for (;;) {
+        uint64_t received;
+        uint32_t length;
+        char *data;
+        if (fread(&received, sizeof(received), 1, file) != 1)
+            break;
+        if (fread(&length, sizeof(length), 1, file) != 1)
+            goto truncated;
+        data = NULL;
+        if (length != 0) {
+            data = bt_malloc(length + 1);
+            if (data == NULL)
+                goto error;
+            if (fread(data, 1, length, file) != length) {
+                bt_free(data);
+                goto truncated;
+            }
+            // The frames are text, the decoder wants it `null' terminated
+            data[length] = '\0';
+        }
+        if (bt_replay_append(replay, received, data) == false) {
+            bt_free(data);
+            goto error;
+        }
+    }
+    fclose(file);
+    return true;
+truncated:
+    // The program may have stopped in the middle of a frame, the
+    // complete ones are still good
+    log("warning: `%s' is truncated\n", path);
+    fclose(file);
+    return true;
+error:
+    fclose(file);
+    return false;
+}
+
+static int
+bt_replay_compare_topics(const void *const lhs, const void *const rhs)
+{
+    const bt_replay_topic *left;
+    const bt_replay_topic *right;
+    left = lhs;
+    right = rhs;
+    return (left->match > right->match) - (left->match < right->match);
+}
+
+static bt_event *
+bt_replay_event_new(const bt_replay_topic *const topics,
+                                     size_t count, const char *const tour)
+{
+    const char *names[2];
+    bt_event *event;
+    // The players are only known if their names were captured
+    names[0] = "Home";
+    names[1] = "Away";
+    for (size_t idx = 0; idx < count; ++idx) {
+        if (topics[idx].type == TeamANameTopic)
+            names[0] = topics[idx].value;
+        else if (topics[idx].type == TeamBNameTopic)
+            names[1] = topics[idx].value;
+    }
+    event = bt_william_hill_event_new(topics[0].match);
+    if (event == NULL)
+        return NULL;
+    // Without them the workers cannot process the values
+    if (bt_william_hill_event_set_competitors(event, names[0], names[1], tour) == false) {
+        bt_william_hill_event_free(event);
+        return NULL;
+    }
+    return event;
+}
+
+static size_t
+bt_replay_add_events(const bt_replay *const replay, bt_context *const context)
+{
+    bt_replay_topic *topics;
+    bt_event_list *list;
+    const char *tour;
+    size_t count;
+    size_t added;
+    if (replay->count == 0)
+        return 0;
+    topics = bt_malloc(replay->count * sizeof(*topics));
+    if (topics == NULL)
+        return 0;
+    // The control frames tell which matches were subscribed, and the
+    // names of the players
+    count = 0;
+    for (size_t idx = 0; idx < replay->count; ++idx) {
+        bt_replay_topic *topic;
+        topic = &topics[count];
+        topic->match = bt_william_hill_control_frame_get_match(
+                                 replay->frames[idx].data, &topic->type, &topic->value);
+        if (topic->match != -1)
+            count += 1;
+    }
+    qsort(topics, count, sizeof(*topics), bt_replay_compare_topics);
+    tour = getenv("WILLIAM_HILL_REPLAY_TOUR");
+    if (tour == NULL)
+        tour = BT_REPLAY_DEFAULT_TOUR;
+    // Appended in order and without repetitions, so the list is
+    // sorted as the lookups expect
+    list = bt_context_get_events(context);
+    added = 0;
+    for (size_t head = 0; head < count;) {
+        bt_event *event;
+        size_t tail;
+        for (tail = head + 1; tail < count; ++tail) {
+            if (topics[tail].match != topics[head].match)
+                break;
+        }
+        event = bt_replay_event_new(&topics[head], tail - head, tour);
+        if (event != NULL) {
+            bt_william_hill_event_list_append(list, event);
+            added += 1;
+        }
+        head = tail;
+    }
+    bt_free(topics);
+    return added;
+}
+
+static int
+bt_replay_send_message(const char *const channel, int id, const char *const message)
+{
+    // Accepted at once, an edit keeps it's message id
+    if (id != -1)
+        return id;
+    return __atomic_add_fetch(&LastMessageId, 1, __ATOMIC_RELAXED);
+}
+
+static void
+bt_replay_wait(uint64_t when)
+{
+    struct timespec deadline;
+    // The same clock the capture used, `CLOCK_MONOTONIC'
+    deadline.tv_sec = when / 1000000000ULL;
+    deadline.tv_nsec = when % 1000000000ULL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+        ;
+}
+
+static void
+bt_replay_drain(bt_william_hill_pipeline *const pipeline)
+{
+    bt_william_hill_pipeline_stats stats;
+    struct timespec pause;
+    pause.tv_sec = 0;
+    pause.tv_nsec = 100000;
+    // The workers may still be processing the last frames, and asking
+    // for subscriptions while they do. Every job taken from a queue has
+    // finished when both stages saw the same number of them
+    for (;;) {
+        bt_william_hill_pipeline_flush(pipeline);
+        bt_william_hill_pipeline_get_stats(pipeline, &stats);
+        if ((stats.depth == 0) && (stats.wait.count == stats.process.count))
+            break;
+        nanosleep(&pause, NULL);
+    }
+    bt_william_hill_pipeline_flush(pipeline);
+}
+
+static void
+bt_replay_report_pipeline(const bt_william_hill_pipeline *const pipeline)
+{
+    bt_william_hill_pipeline_stats stats;
+    const bt_pipeline_stage_stats *stages[3];
+    const char *names[] = {"decode", "wait", "process"};
+    bt_william_hill_pipeline_get_stats(pipeline, &stats);
+    stages[0] = &stats.decode;
+    stages[1] = &stats.wait;
+    stages[2] = &stats.process;
+    printf("%zu workers, max depth %zu\n", stats.workers, stats.max_depth);
+    for (size_t idx = 0; idx < countof(stages); ++idx) {
+        const bt_pipeline_stage_stats *stage;
+        stage = stages[idx];
+        if (stage->count == 0)
+            continue;
+        printf("%-8s avg %.1f us, max %.1f us, %.2f allocations per frame "
+              "(%llu frames)\n", names[idx], 1.0E-3 * stage->total / stage->count,
+                  1.0E-3 * stage->max, (double) stage->allocations / stage->count,
+                                               (unsigned long long) stage->count);
+    }
+    printf("\n");
+}
+
+static bool
+bt_replay_greet(const bt_replay *const replay, size_t *const index)
+{
+    const char *greeting;
+    greeting = BT_REPLAY_HANDSHAKE;
+    // Since version 2 the server's greeting follows the marker
+    if ((replay->version >= 2) && (*index + 1 < replay->count) &&
+                                     (replay->frames[*index + 1].data != NULL)) {
+        *index += 1;
+        greeting = replay->frames[*index].data;
+    }
+    return bt_william_hill_websocket_check_handshake(greeting);
+}
+
+int
+bt_william_hill_replay(const char *const path, bool realtime)
+{
+    bt_websocket_connection wsc;
+    bt_event_list *list;
+    bt_replay replay;
+    size_t connections;
+    size_t events;
+    size_t frames;
+    size_t failed;
+    bool connected;
+    uint64_t start;
+    uint64_t first;
+    double elapsed;
+    char *report;
+    memset(&replay, 0, sizeof(replay));
+    if (bt_replay_load(&replay, path) == false) {
+        bt_replay_release(&replay);
+        return -1;
+    }
+    // Everything runs as in the live program except for the side effects,
+    // the queries fail as if the server was down, Telegram accepts every
+    // message at once and there is no socket to send the subscriptions to
+    bt_database_disable();
+    bt_telegram_set_transport(bt_replay_send_message);
+    if (bt_channel_settings_count() == 0)
+        log("warning: no channels configured, no notification will be measured\n");
+    memset(&wsc, 0, sizeof(wsc));
+    wsc.context = bt_create_context();
+    if (wsc.context == NULL) {
+        bt_replay_release(&replay);
+        return -1;
+    }
+    events = bt_replay_add_events(&replay, wsc.context);
+    wsc.pipeline = bt_william_hill_pipeline_new(&wsc);
+    if (wsc.pipeline == NULL) {
+        log("error: cannot start the frame workers\n");
+        bt_context_free(wsc.context);
+        bt_replay_release(&replay);
+        return -1;
+    }
+    if (bt_telegram_dispatcher_start() == false)
+        log("warning: sending telegram notifications synchronously\n");
+    bt_context_set_event_release(wsc.context,
+                                   bt_william_hill_pipeline_release, wsc.pipeline);
+    list = bt_context_get_events(wsc.context);
+    connections = 0;
+    frames = 0;
+    failed = 0;
+    connected = false;
+    first = (replay.count == 0) ? 0 : replay.frames[0].received;
+    start = bt_william_hill_pipeline_now();
+    for (size_t idx = 0; idx < replay.count; ++idx) {
+        const bt_replay_frame *frame;
+        frame = &replay.frames[idx];
+        if ((realtime == true) && (frame->received > first))
+            bt_replay_wait(start + (frame->received - first));
+        if (frame->data == NULL) {
+            // The frames that follow belong to a new connection, the
+            // workers forget the topics of the old one
+            if (bt_replay_greet(&replay, &idx) == false)
+                break;
+            bt_william_hill_pipeline_reset(wsc.pipeline, list);
+            connections += 1;
+            connected = true;
+            continue;
+        }
+        if (connected == false) {
+            // A capture from before the markers were written
+            if (bt_william_hill_websocket_check_handshake(BT_REPLAY_HANDSHAKE) == false)
+                break;
+            connections += 1;
+            connected = true;
+        }
+        if (bt_william_hill_handle_frame_text(&wsc,
+                                 frame->data, bt_william_hill_pipeline_now()) != 0)
+            failed += 1;
+        frames += 1;
+        if ((frames % BT_REPLAY_FLUSH_FRAMES) == 0)
+            bt_william_hill_pipeline_flush(wsc.pipeline);
+    }
+    bt_replay_drain(wsc.pipeline);
+    elapsed = 1.0E-9 * (bt_william_hill_pipeline_now() - start);
+    // The notifications still in the senders are measured too
+    bt_telegram_dispatcher_stop();
+    bt_context_set_event_release(wsc.context, NULL, NULL);
+    printf("%zu frames (%zu failed), %zu connections, %zu events\n",
+                                            frames, failed, connections, events);
+    printf("%.3f s, %.0f frames/s\n\n", elapsed,
+                                    (elapsed > 0.0) ? frames / elapsed : 0.0);
+    bt_replay_report_pipeline(wsc.pipeline);
+    report = bt_latency_report();
+    if (report != NULL)
+        fputs(report, stdout);
+    fflush(stdout);
+    bt_free(report);
+    bt_william_hill_pipeline_free(wsc.pipeline);
+    bt_telegram_set_transport(NULL);
+    bt_context_free(wsc.context);
+    bt_replay_release(&replay);
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <bt-william-hill-schedule.h>
+#include <bt-memory.h>
+
+// The interval when nothing is about to start, and the limits
+#define BT_SCHEDULE_BASE 60
+#define BT_SCHEDULE_MINIMUM 5
+#define BT_SCHEDULE_MAXIMUM 900
+// Poll fast from a bit before a match starts, and for a while after
+// because they often start late
+#define BT_SCHEDULE_LEAD 120
+#define BT_SCHEDULE_GRACE 1800
+
+struct bt_william_hill_schedule {
+    time_t *starts;
+    size_t count;
+    size_t size;
+    unsigned int minimum;
+    unsigned int maximum;
+    // The next interval if nothing is pending, it doubles each time
+    unsigned int idle;
+};
+
+// The last interval chosen, for the control socket
+static unsigned int CurrentInterval;
+
+static unsigned int
+bt_william_hill_schedule_get_env(const char *const name, unsigned int fallback)
+{
+    const char *envvar;
+    long int value;
+    char *endptr;
+    envvar = getenv(name);
+    if (envvar == NULL)
+        return fallback;
+    value = strtol(envvar, &endptr, 10);
+    if ((*endptr != '\0') || (value < 1))
+        return fallback;
+    return value;
+}
+
+bt_william_hill_schedule *
+bt_william_hill_schedule_new(void)
+{
+    bt_william_hill_schedule *schedule;
+    schedule = bt_malloc(sizeof(*schedule));
+    if (schedule == NULL)
+        return NULL;
+    memset(schedule, 0, sizeof(*schedule));
+    schedule->minimum = bt_william_hill_schedule_get_env("WILLIAM_HILL_POLL_MIN",
+                                                             BT_SCHEDULE_MINIMUM);
+    schedule->maximum = bt_william_hill_schedule_get_env("WILLIAM_HILL_POLL_MAX",
+                                                             BT_SCHEDULE_MAXIMUM);
+    if (schedule->maximum < schedule->minimum)
+        schedule->maximum = schedule->minimum;
+    schedule->idle = BT_SCHEDULE_BASE;
+    return schedule;
+}
+
+void
+bt_william_hill_schedule_free(bt_william_hill_schedule *schedule)
+{
+    if (schedule == NULL)
+        return;
+    bt_free(schedule->starts);
+    bt_free(schedule);
+}
+
+void
+bt_william_hill_schedule_clear(bt_william_hill_schedule *const schedule)
+{
+    schedule->count = 0;
+}
+
+void
+bt_william_hill_schedule_add(bt_william_hill_schedule *const schedule, time_t start)
+{
+    if (schedule->count == schedule->size) {
+        time_t *starts;
+        size_t size;
+        size = (schedule->size == 0) ? 64 : 2 * schedule->size;
+        starts = bt_realloc(schedule->starts, size * sizeof(*starts));
+        // Losing one start only makes polling slower around it
+        if (starts == NULL)
+            return;
+        schedule->starts = starts;
+        schedule->size = size;
+    }
+    schedule->starts[schedule->count++] = start;
+}
+
+static unsigned int
+bt_william_hill_schedule_clamp(const bt_william_hill_schedule *const schedule,
+                                                               unsigned int interval)
+{
+    if (interval < schedule->minimum)
+        return schedule->minimum;
+    if (interval > schedule->maximum)
+        return schedule->maximum;
+    return interval;
+}
+
+unsigned int
+bt_william_hill_schedule_next(bt_william_hill_schedule *const schedule,
+                                                         time_t now, bool changed)
+{
+    unsigned int interval;
+    time_t wait;
+    bool pending;
+    if (changed == true)
+        schedule->idle = BT_SCHEDULE_BASE;
+    pending = false;
+    wait = BT_SCHEDULE_BASE;
+    for (size_t idx = 0; idx < schedule->count; ++idx) {
+        time_t start;
+        start = schedule->starts[idx];
+        if (now > start + BT_SCHEDULE_GRACE)
+            continue;
+        pending = true;
+        // About to start, or it should have started already
+        if (now >= start - BT_SCHEDULE_LEAD) {
+            wait = 0;
+            break;
+        }
+        // Wake up right before the first one
+        if (start - BT_SCHEDULE_LEAD - now < wait)
+            wait = start - BT_SCHEDULE_LEAD - now;
+    }
+    if (pending == true) {
+        // Keep checking at least every minute for new matches
+        interval = bt_william_hill_schedule_clamp(schedule, wait);
+        schedule->idle = BT_SCHEDULE_BASE;
+    } else {
+        // Nothing to wait for, so back off
+        interval = bt_william_hill_schedule_clamp(schedule, schedule->idle);
+        if (schedule->idle < schedule->maximum)
+            schedule->idle *= 2;
+    }
+    __atomic_store_n(&CurrentInterval, interval, __ATOMIC_RELAXED);
+    return interval;
+}
+
+unsigned int
+bt_william_hill_schedule_get_interval(void)
+{
+    return __atomic_load_n(&CurrentInterval, __ATOMIC_RELAXED);
+}
@@ -1,9 +1,16 @@
 #include <stdio.h>
+#include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
+
+#include <pthread.h>
 
 #include <bt-william-hill-topics.h>
 #include <bt-william-hill-events.h>
+#include <bt-string-builder.h>
+#include <bt-arena.h>
+#include <bt-slab.h>
 #include <bt-private.h>
 #include <bt-memory.h>
 #include <bt-context.h>
@@ -52,40 +59,147 @@ static const bt_topic_descriptor AllTopics[] = {
     , {"totalSets", TotalSetsTopic, NoCategory}
 };
 
+// Perfect hash of the names in `AllTopics`, built once when it's first
+// needed. Each slot has the index of the descriptor plus one, `0` means
+// that no name hashes there.
+#define BT_TOPIC_NAMES_SLOTS 256
+#define BT_TOPIC_NAMES_MAX_SEEDS 0x10000
+// Lookups of each name for `bt_william_hill_topic_benchmark()'
+#define BT_TOPIC_BENCHMARK_ROUNDS 100000
+
+typedef struct bt_topic_names {
+    uint8_t slots[BT_TOPIC_NAMES_SLOTS];
+    size_t lengths[sizeof(AllTopics) / sizeof(*AllTopics)];
+    uint64_t seed;
+    bool ready;
+} bt_topic_names;
+
+static bt_topic_names TopicNames;
+static pthread_once_t TopicNamesOnce = PTHREAD_ONCE_INIT;
+// Topics come and go with their events, they all share this pool
+static bt_slab *TopicSlab;
+static pthread_once_t TopicSlabOnce = PTHREAD_ONCE_INIT;
+
 typedef struct bt_topic {
     char *alias;
+    size_t length;
+    size_t hash;
     bt_event *event;
     enum bt_topic_type type;
 } bt_topic;
 
-typedef struct bt_topic_list {
-    bt_topic **items;
+// Open addressing (linear probing) table, it's size is always a power of 2
+// and it's at most half full, so probe sequences are short and removal can
+// be done by shifting back the following items instead of leaving tombstones
+// behind. The topics themselves are owned by their events, which keep them
+// in a slot per `enum bt_topic_type`.
+typedef struct bt_topic_registry {
+    bt_topic **aliases;
     size_t size;
     size_t count;
-} bt_topic_list;
+} bt_topic_registry;
+
+typedef struct bt_topic_name {
+    const char *name;
+    size_t length;
+} bt_topic_name;
 
 static int
 bt_william_hill_compare_topics_descriptions_by_name(const void *const _A, const void *const _B)
 {
-    const bt_topic_descriptor *A_;
+    const bt_topic_name *A_;
     const bt_topic_descriptor *B_;
+    int result;
     A_ = _A;
     B_ = _B;
-    return strcmp(A_->name, B_->name);
+    // The key is not `null' terminated, so compare up to it's length and
+    // then check that the name ends there too
+    result = strncmp(A_->name, B_->name, A_->length);
+    if (result != 0)
+        return result;
+    return (B_->name[A_->length] == '\0') ? 0 : -1;
 }
 
-static int
-bt_william_hill_topics_compare_by_alias(const void *const _a, const void *const _b)
+static uint64_t
+bt_william_hill_topic_hash(const char *const string, size_t length, uint64_t seed)
+{
+    uint64_t hash;
+    // FNV-1a, names and aliases are short strings so this is more than enough
+    hash = UINT64_C(0xcbf29ce484222325) ^ seed;
+    for (size_t index = 0; index < length; ++index) {
+        hash ^= (uint8_t) string[index];
+        hash *= UINT64_C(0x100000001b3);
+    }
+    return hash;
+}
+
+static size_t
+bt_william_hill_topic_hash_alias(const char *const alias, size_t length)
+{
+    return (size_t) bt_william_hill_topic_hash(alias, length, 0);
+}
+
+static size_t
+bt_william_hill_topic_names_slot(const char *const name, size_t length, uint64_t seed)
+{
+    uint64_t hash;
+    hash = bt_william_hill_topic_hash(name, length, seed);
+    // Many names only differ in the last character, and FNV-1a does not
+    // spread that to all the bits, so mix them before taking a few
+    hash ^= hash >> 33;
+    hash *= UINT64_C(0xff51afd7ed558ccd);
+    hash ^= hash >> 33;
+    return (size_t) hash & (BT_TOPIC_NAMES_SLOTS - 1);
+}
+
+static bool
+bt_william_hill_topic_names_try(bt_topic_names *const names, uint64_t seed)
+{
+    memset(names->slots, 0, sizeof(names->slots));
+    for (size_t idx = 0; idx < countof(AllTopics); ++idx) {
+        size_t slot;
+        slot = bt_william_hill_topic_names_slot(AllTopics[idx].name,
+                                                     names->lengths[idx], seed);
+        // Collision, try another seed
+        if (names->slots[slot] != 0)
+            return false;
+        names->slots[slot] = idx + 1;
+    }
+    names->seed = seed;
+    return true;
+}
+
+static bool
+bt_william_hill_topic_names_fill(bt_topic_names *const names)
+{
+    for (size_t idx = 0; idx < countof(AllTopics); ++idx)
+        names->lengths[idx] = strlen(AllTopics[idx].name);
+    // The names are fixed, so a seed that spreads them without
+    // collisions is found in a few attempts
+    for (uint64_t seed = 0; seed < BT_TOPIC_NAMES_MAX_SEEDS; ++seed) {
+        if (bt_william_hill_topic_names_try(names, seed) == false)
+            continue;
+        names->ready = true;
+        return true;
+    }
+    names->ready = false;
+    return false;
+}
+
+static void
+bt_william_hill_topic_names_build(void)
+{
+    // Never fails with the current names, but the binary search
+    // still works if it does
+    if (bt_william_hill_topic_names_fill(&TopicNames) == false)
+        log("warning: cannot build the topic names hash table\n");
+}
+
+static void
+bt_william_hill_topic_slab_create(void)
 {
-    const bt_topic *a;
-    const bt_topic *b;
-    a = *((const bt_topic **) _a);
-    b = *((const bt_topic **) _b);
-    if ((a == NULL) || (b == NULL))
-        return (a == NULL) ? -1 : 1;
-    if ((a->alias == NULL) || (b->alias == NULL))
-        return (a->alias == NULL) ? -1 : 1;
-    return strcmp(a->alias, b->alias);
+    // It lives as long as the program, like the topic names
+    TopicSlab = bt_slab_new(sizeof(bt_topic), __alignof__(bt_topic));
 }
 
 bt_topic *
@@ -94,12 +208,15 @@ bt_william_hill_topic_new(char *alias, bt_event *event, enum bt_topic_type type)
     bt_topic *topic;
     if (event == NULL)
         return NULL;
-    // Allocate space for the new topic
-    topic = bt_malloc(sizeof(*topic));
+    // Take space for the new topic from the pool
+    pthread_once(&TopicSlabOnce, bt_william_hill_topic_slab_create);
+    topic = bt_slab_alloc(TopicSlab);
     if (topic ==  NULL)
         return NULL;
     // Fill the structure with initial values
     topic->alias = alias;
+    topic->length = strlen(alias);
+    topic->hash = bt_william_hill_topic_hash_alias(alias, topic->length);
     topic->event = event;
     topic->type = type;
     // Return the new topic object
@@ -113,35 +230,50 @@ bt_william_hill_topic_free(bt_topic *const topic)
         return;
     // Free the alias, which is allocated dynamically
     bt_free(topic->alias);
-    // Free the topic object
-    bt_free(topic);
+    // Give the topic object back, a topic exists so the pool does too
+    bt_slab_release(TopicSlab, topic);
 }
 
 void
-bt_william_hill_topic_list_free(bt_topic_list *const list)
+bt_william_hill_topic_registry_free(bt_topic_registry *const registry)
 {
     // Behave correctly
-    if (list == NULL)
+    if (registry == NULL)
         return;
-    // Iterate through each item in the list and free it
-    for (size_t index = 0; index < list->count; ++index)
-        bt_william_hill_topic_free(list->items[index]);
-    // Free the items container
-    bt_free(list->items);
-    // Free the list
-    bt_free(list);
+    // Free the table, the topics belong to the events
+    bt_free(registry->aliases);
+    // Free the registry
+    bt_free(registry);
 }
 
-enum bt_topic_type
-bt_william_hill_topic_get_type_from_description_name(const char *const name)
+static enum bt_topic_type
+bt_william_hill_topic_names_lookup(const bt_topic_names *const names,
+                                       const char *const name, size_t length)
+{
+    size_t slot;
+    size_t idx;
+    // One hash and one comparison
+    slot = bt_william_hill_topic_names_slot(name, length, names->seed);
+    if (names->slots[slot] == 0)
+        return InvalidTopic;
+    idx = names->slots[slot] - 1;
+    if ((names->lengths[idx] != length) ||
+                           (memcmp(AllTopics[idx].name, name, length) != 0))
+        return InvalidTopic;
+    return AllTopics[idx].type;
+}
+
+static enum bt_topic_type
+bt_william_hill_topic_names_search(const char *const name, size_t length)
 {
     const bt_topic_descriptor *found;
-    bt_topic_descriptor needle;
+    bt_topic_name needle;
     // Generate the key object to search for the `topic` named `name`
     needle.name = name;
+    needle.length = length;
     // Do a binary search
     found = bsearch(&needle, AllTopics, sizeof(AllTopics) / sizeof(*AllTopics),
-           sizeof(needle), bt_william_hill_compare_topics_descriptions_by_name);
+        sizeof(*AllTopics), bt_william_hill_compare_topics_descriptions_by_name);
     // Check we found one before dereferencing
     if (found != NULL)
         return found->type;
@@ -149,219 +281,405 @@ bt_william_hill_topic_get_type_from_description_name(const char *const name)
     return InvalidTopic;
 }
 
-const bt_topic *
-bt_william_hill_topic_list_find(const bt_topic_list *const list,
-                                                        const char *const alias)
-{
-    bt_topic **found;
-    bt_topic pattern;
-    bt_topic *pointer;
-    // Make a pointer to the "key" object
-    pointer = &pattern;
-    // Fill the "key" object with the interesting data
-    pattern.alias = (char *) alias;
-    // Perform a binary search
-    found = bsearch(&pointer, list->items, list->count,
-                      sizeof(pointer), bt_william_hill_topics_compare_by_alias);
-    // Check this to avoid dereferencing `NULL`
-    if (found == NULL)
-        return NULL;
-    return *found;
+enum bt_topic_type
+bt_william_hill_topic_get_type_from_description_name(const char *const name,
+                                                                  size_t length)
+{
+    // This is called for every control frame, so use the perfect hash
+    pthread_once(&TopicNamesOnce, bt_william_hill_topic_names_build);
+    if (TopicNames.ready == true)
+        return bt_william_hill_topic_names_lookup(&TopicNames, name, length);
+    return bt_william_hill_topic_names_search(name, length);
 }
 
-bt_topic_list *
-bt_william_hill_topics_list_create(void)
+static double
+bt_william_hill_topic_benchmark_now(void)
 {
-    bt_topic_list *list;
-    // Allocate space for the new list
-    list = bt_malloc(sizeof(*list));
-    if (list == NULL)
-        return NULL;
-    // Fill the structure with default values
-    list->count = 0;
-    // Allocate space for list items
-    list->items = bt_malloc(100 * sizeof(*list->items));
-    if (list->items != NULL) {
-        list->size = 100;
-    } else {
-        list->size = 0;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + 1.0E-9 * now.tv_nsec;
+}
+
+int
+bt_william_hill_topic_benchmark(void)
+{
+    bt_topic_name keys[2 * countof(AllTopics)];
+    char misses[countof(AllTopics)][64];
+    bt_topic_names names;
+    size_t mismatches;
+    size_t count;
+    // So the lookups are not optimized away
+    volatile unsigned int sink;
+    double start;
+    double build;
+    double hash;
+    double search;
+    // Every name, and every name with the last character changed, a
+    // miss that is only found in the final comparison
+    count = 0;
+    for (size_t idx = 0; idx < countof(AllTopics); ++idx) {
+        size_t length;
+        length = strlen(AllTopics[idx].name);
+        keys[count].name = AllTopics[idx].name;
+        keys[count++].length = length;
+        if (length >= sizeof(misses[idx]))
+            continue;
+        memcpy(misses[idx], AllTopics[idx].name, length + 1);
+        misses[idx][length - 1] = '#';
+        keys[count].name = misses[idx];
+        keys[count++].length = length;
+    }
+    // The table is built when the program starts using it, this is
+    // the same work
+    start = bt_william_hill_topic_benchmark_now();
+    if (bt_william_hill_topic_names_fill(&names) == false) {
+        log("error: cannot build the topic names hash table\n");
+        return -1;
+    }
+    build = bt_william_hill_topic_benchmark_now() - start;
+    // Both must agree before comparing their speed
+    mismatches = 0;
+    for (size_t idx = 0; idx < count; ++idx) {
+        if (bt_william_hill_topic_names_lookup(&names, keys[idx].name, keys[idx].length) !=
+                       bt_william_hill_topic_names_search(keys[idx].name, keys[idx].length))
+            mismatches += 1;
+    }
+    sink = 0;
+    start = bt_william_hill_topic_benchmark_now();
+    for (size_t round = 0; round < BT_TOPIC_BENCHMARK_ROUNDS; ++round) {
+        for (size_t idx = 0; idx < count; ++idx)
+            sink += bt_william_hill_topic_names_lookup(&names, keys[idx].name, keys[idx].length);
+    }
+    hash = bt_william_hill_topic_benchmark_now() - start;
+    start = bt_william_hill_topic_benchmark_now();
+    for (size_t round = 0; round < BT_TOPIC_BENCHMARK_ROUNDS; ++round) {
+        for (size_t idx = 0; idx < count; ++idx)
+            sink += bt_william_hill_topic_names_search(keys[idx].name, keys[idx].length);
+    }
+    search = bt_william_hill_topic_benchmark_now() - start;
+    printf("%-14s %12s %8s\n", "lookup", "ns/lookup", "keys");
+    printf("%-14s %12.2f %8zu\n", "perfect hash",
+                           1.0E9 * hash / (BT_TOPIC_BENCHMARK_ROUNDS * count), count);
+    printf("%-14s %12.2f %8zu\n", "bsearch",
+                         1.0E9 * search / (BT_TOPIC_BENCHMARK_ROUNDS * count), count);
+    printf("table built in %.3f ms, seed %llu, %zu mismatches\n", 1.0E3 * build,
+                                     (unsigned long long) names.seed, mismatches);
+    fflush(stdout);
+    return (mismatches == 0) ? 0 : -1;
+}
+
+static size_t
+bt_william_hill_topic_registry_probe_alias(const bt_topic_registry *const registry,
+                          const char *const alias, size_t length, size_t hash)
+{
+    size_t mask;
+    size_t index;
+    mask = registry->size - 1;
+    // Walk the cluster until we find the alias or an empty slot
+    for (index = hash & mask; registry->aliases[index] != NULL; index = (index + 1) & mask) {
+        const bt_topic *topic;
+        topic = registry->aliases[index];
+        if ((topic->hash == hash) && (topic->length == length) &&
+                                    (memcmp(topic->alias, alias, length) == 0))
+            break;
+    }
+    return index;
+}
+
+static void
+bt_william_hill_topic_registry_erase(bt_topic_registry *const registry,
+                                                                    size_t hole)
+{
+    bt_topic **table;
+    size_t mask;
+    size_t next;
+    table = registry->aliases;
+    mask = registry->size - 1;
+    // Shift back every item of the cluster that would not be reachable
+    // anymore from it's home slot once `hole` is empty
+    for (next = (hole + 1) & mask; table[next] != NULL; next = (next + 1) & mask) {
+        size_t home;
+        home = table[next]->hash & mask;
+        // The item can only move if `hole` is between it's home slot and
+        // the slot where it's currently stored
+        if (((next - home) & mask) < ((next - hole) & mask))
+            continue;
+        table[hole] = table[next];
+        hole = next;
     }
-    // Return the newly allocated list
-    return list;
+    table[hole] = NULL;
+}
+
+static void
+bt_william_hill_topic_registry_put(bt_topic_registry *const registry,
+                                                         bt_topic *const topic)
+{
+    size_t index;
+    // Find the slot for the alias, it can only be taken if another topic
+    // was given this alias after this one, and that one wins
+    index = bt_william_hill_topic_registry_probe_alias(registry,
+                                   topic->alias, topic->length, topic->hash);
+    if (registry->aliases[index] == NULL)
+        registry->aliases[index] = topic;
 }
 
 static int
-bt_william_hill_topic_list_resize(bt_topic_list *list)
+bt_william_hill_topic_registry_allocate(bt_topic_registry *const registry,
+                                                                    size_t size)
 {
-    bt_topic **items;
-    // Check if resize is required
-    if (list->count + 1 < list->size)
+    registry->aliases = bt_calloc(size, sizeof(*registry->aliases));
+    if (registry->aliases == NULL)
+        return -1;
+    registry->size = size;
+    return 0;
+}
+
+static int
+bt_william_hill_topic_registry_resize(bt_topic_registry *const registry)
+{
+    bt_topic_registry resized;
+    // Keep the load factor at 1/2 at most
+    if (2 * (registry->count + 1) <= registry->size)
         return 0;
-    // Allocate space for the new size
-    items = bt_realloc(list->items, 2 * list->size * sizeof(*items));
-    if (items == NULL)
+    // Allocate twice as much space
+    if (bt_william_hill_topic_registry_allocate(&resized, 2 * registry->size) == -1)
         return -1;
-    // Reassign the items pointer
-    list->items = items;
-    // Update the size member
-    list->size *= 2;
-    // Return success
+    // Re-insert all the items in the new table
+    for (size_t index = 0; index < registry->size; ++index) {
+        if (registry->aliases[index] == NULL)
+            continue;
+        bt_william_hill_topic_registry_put(&resized, registry->aliases[index]);
+    }
+    // Release the old table
+    bt_free(registry->aliases);
+    // Replace it with the new one
+    registry->aliases = resized.aliases;
+    registry->size = resized.size;
     return 0;
 }
 
-void
-bt_william_hill_topic_list_sort(bt_topic_list *list)
+bt_topic *
+bt_william_hill_topic_registry_find(const bt_topic_registry *const registry,
+                                        const char *const alias, size_t length)
 {
-    // Simple qsort call wrapper
-    qsort(list->items, list->count,
-                    sizeof(*list->items), bt_william_hill_topics_compare_by_alias);
+    size_t index;
+    size_t hash;
+    // Find the slot for this alias
+    hash = bt_william_hill_topic_hash_alias(alias, length);
+    index = bt_william_hill_topic_registry_probe_alias(registry,
+                                                          alias, length, hash);
+    // It's `NULL` if the alias is not in the registry
+    return registry->aliases[index];
+}
+
+bt_topic_registry *
+bt_william_hill_topic_registry_new(void)
+{
+    bt_topic_registry *registry;
+    // Allocate space for the new registry
+    registry = bt_malloc(sizeof(*registry));
+    if (registry == NULL)
+        return NULL;
+    // Fill the structure with default values
+    registry->count = 0;
+    // Allocate space for the table, enough for a few events
+    if (bt_william_hill_topic_registry_allocate(registry, 256) == -1) {
+        bt_free(registry);
+        return NULL;
+    }
+    // Return the newly allocated registry
+    return registry;
 }
 
 bool
-bt_william_hill_topic_list_append(bt_topic_list *list,
-                                                   bt_topic *const topic)
+bt_william_hill_topic_registry_insert(bt_topic_registry *const registry,
+                                                         bt_topic *const topic)
 {
-    const bt_topic *found;
-    // Check if this item is already in the list
-    found = bt_william_hill_topic_list_find(list, topic->alias);
-    if (found != NULL)
+    // Check if this alias is already in the registry
+    if (bt_william_hill_topic_registry_find(registry,
+                                           topic->alias, topic->length) != NULL)
         return false;
-    // It's not in the list, so try to append it
-    if (bt_william_hill_topic_list_resize(list) != 0)
+    // Check if this event has this topic already
+    if (bt_william_hill_event_get_topic(topic->event, topic->type) != NULL)
         return false;
-    // Set the approprpiate element and increase `count`
-    list->items[list->count++] = topic;
+    // It's not there, so make room for it
+    if (bt_william_hill_topic_registry_resize(registry) != 0)
+        return false;
+    // Store the topic in the table and in the event slot, the
+    // event owns it from now on
+    bt_william_hill_topic_registry_put(registry, topic);
+    bt_william_hill_event_set_topic(topic->event, topic->type, topic);
+    registry->count += 1;
     return true;
 }
 
 void
-bt_william_hill_topic_list_remove(bt_topic_list *const list,
-                                         const bt_event *const to_remove)
+bt_william_hill_topic_registry_remove(bt_topic_registry *const registry,
+                                                const bt_event *const event)
 {
-    size_t count;
-    int id;
-    // Get the id of the interesting event
-    id = bt_william_hill_event_get_id(to_remove);
-    // Store the list count to update it without affecting the "real" count
-    count = list->count;
-    // Iterate through every element
-    for (int index = 0; index < count; ++index) {
+    // An event can only have one topic of each type
+    for (int type = 0; type < TopicCount; ++type) {
         bt_topic *topic;
-        bt_event *event;
-        size_t size;
-        // Make a pointer to current item
-        topic = list->items[index];
-        // Make a pointer to the associated event
-        event = topic->event;
-        // Compare the event id with the pattern
-        if (bt_william_hill_event_get_id(event) != id)
+        size_t index;
+        // Take the topic from the event slot
+        topic = bt_william_hill_event_get_topic(event, type);
+        if (topic == NULL)
             continue;
         log("removing topic: \033[33m%s\033[0m\n", topic->alias);
-        // It's one of them, so remove the item.
-        //
-        // First we compute the size of the items to the
-        // "right" of the current one, to be able to move
-        // all of them one step to the left using
-        // `memmove()`.
-        size = (count - index - 1) * sizeof(*list->items);
-        // Now we move the items one item to the left. Note that
-        // `size` can be `0` here and the behavior is perfectly
-        // defined
-        memmove(&list->items[index], &list->items[index + 1], size);
-        // Decrease count, and reset index to search from the new
-        // "current" item and forward
-        count -= 1;
-        index -= 1;
+        // Remove it from the alias table, unless the alias was taken over
+        index = bt_william_hill_topic_registry_probe_alias(registry,
+                                   topic->alias, topic->length, topic->hash);
+        if (registry->aliases[index] == topic)
+            bt_william_hill_topic_registry_erase(registry, index);
+        bt_william_hill_event_set_topic(topic->event, type, NULL);
+        registry->count -= 1;
         // Free the extracted item
         bt_william_hill_topic_free(topic);
     }
-    // Update the list count to reflect the changes
-    list->count = count;
 }
 
 void
-bt_william_hill_topic_reset_alias(bt_topic *topic, char *alias)
+bt_william_hill_topic_registry_reset_alias(bt_topic_registry *const registry,
+                                               bt_topic *const topic, char *alias)
 {
+    size_t index;
+    // Remove the topic from the alias table, it's slot depends on the alias
+    index = bt_william_hill_topic_registry_probe_alias(registry,
+                                   topic->alias, topic->length, topic->hash);
+    if (registry->aliases[index] == topic)
+        bt_william_hill_topic_registry_erase(registry, index);
     // Free the old alias
     bt_free(topic->alias);
     // Set the new one, taking charge of the allocated memory for it
     topic->alias = alias;
+    topic->length = strlen(alias);
+    topic->hash = bt_william_hill_topic_hash_alias(alias, topic->length);
+    // Put it back in the alias table, if another topic had this alias it's
+    // stale now so this one replaces it
+    index = bt_william_hill_topic_registry_probe_alias(registry,
+                                        alias, topic->length, topic->hash);
+    registry->aliases[index] = topic;
 }
 
-static bool
-bt_william_hill_subscribe_single_topic(struct httpio *const ws, const bt_event *const event, const char *const name)
+bool
+bt_william_hill_topic_batch_send(bt_string_builder *const batch,
+                                                          struct httpio *ws)
 {
     bool result;
-    int id;
+    // Nothing to send, that's not a failure
+    if (bt_string_builder_length(batch) == 0)
+        return true;
+    // Send all the topics in a single frame
+    result = httpio_websocket_send_string(ws,
+                                    (char *) bt_string_builder_string(batch));
+    // Start a new frame, what was not sent is lost anyway
+    bt_string_builder_reset(batch);
+    return result;
+}
+
+bool
+bt_william_hill_topic_batch_add(bt_string_builder *const batch,
+                                    struct httpio *ws, const char *const topics)
+{
+    size_t length;
+    length = strlen(topics);
+    // If this does not fit in the frame, send what we have first
+    if ((bt_string_builder_length(batch) > 0) &&
+           (bt_string_builder_length(batch) + length + 1 > BT_TOPIC_BATCH_SIZE)) {
+        if (bt_william_hill_topic_batch_send(batch, ws) == false)
+            return false;
+    }
+    // The frame starts with the subscribe type, the rest is a list of
+    // topics separated by `,'
+    if (bt_string_builder_length(batch) == 0)
+        bt_string_builder_append(batch, "\x16", 1);
+    else
+        bt_string_builder_append(batch, ",", 1);
+    bt_string_builder_append(batch, topics, length);
+    return true;
+}
+
+static bool
+bt_william_hill_subscribe_single_topic(bt_topic_subscriber subscriber,
+                  void *data, const bt_event *const event, const char *const name)
+{
+    bt_arena *arena;
     char *path;
+    int id;
     id = bt_william_hill_event_get_id(event);
     if (id == -1)
         return false;
-    path = bt_strdup_printf("\x16tennis/matches/%d/%s", id, name);
+    // This runs while handling a frame, the arena is reset after it
+    arena = bt_arena_thread();
+    if (arena == NULL)
+        return false;
+    path = bt_arena_printf(arena, "tennis/matches/%d/%s", id, name);
     if (path == NULL)
         return false;
-    result = httpio_websocket_send_string(ws, path);
-    bt_free(path);
-
-    return result;
+    return subscriber(path, data);
 }
 
 void
-bt_william_hill_topic_subscribe_incidents(struct httpio *const ws, bt_event *const event)
+bt_william_hill_topic_subscribe_incidents(bt_topic_subscriber subscriber,
+                                        void *data, const bt_event *const event)
 {
-    bt_william_hill_subscribe_single_topic(ws, event, "incidents");
+    bt_william_hill_subscribe_single_topic(subscriber, data, event, "incidents");
 }
 
 void
-bt_william_hill_topic_subscribe_previous_set(struct httpio *const ws, const bt_event *const event, int set, enum bt_player_idx idx)
+bt_william_hill_topic_subscribe_previous_set(bt_topic_subscriber subscriber,
+     void *data, const bt_event *const event, int set, enum bt_player_idx idx)
 {
+    bt_arena *arena;
     char *path;
     const char *names[] = {
         "previousSets/%d/gamesWon/A",
         "previousSets/%d/gamesWon/B"
     };
-    path = bt_strdup_printf(names[idx], set);
+    arena = bt_arena_thread();
+    if (arena == NULL)
+        return;
+    path = bt_arena_printf(arena, names[idx], set);
     if (path == NULL)
         return;
-    bt_william_hill_subscribe_single_topic(ws, event, path);
-    bt_free(path);
+    bt_william_hill_subscribe_single_topic(subscriber, data, event, path);
 }
 
 void
-bt_william_hill_topic_subscribe_current_set_gameswon(struct httpio *const ws, const bt_event *const event, enum bt_player_idx idx)
+bt_william_hill_topic_subscribe_current_set_gameswon(
+                bt_topic_subscriber subscriber, void *data,
+                            const bt_event *const event, enum bt_player_idx idx)
 {
     const char *names[] = {
         "currentSet/gamesWon/A",
         "currentSet/gamesWon/B"
     };
-    bt_william_hill_subscribe_single_topic(ws, event, names[idx]);
+    bt_william_hill_subscribe_single_topic(subscriber, data, event, names[idx]);
 }
 
-bool
-bt_william_hill_topics_subscribe_event(const bt_event *const event,
-                                 const bt_websocket_connection *const wsc)
+char *
+bt_william_hill_topics_event_subscription(int id)
 {
+    bt_string_builder *builder;
+    char *subscription;
     const char *names[] = {
         "competitors/A/teamName",
         "competitors/B/teamName",
         "currentSet"
     };
 
+    builder = bt_string_builder_new();
+    if (builder == NULL)
+        return NULL;
+    // Build the list of topics once, it's sent as is on every (re)connection
     for (size_t idx = 0; idx < countof(names); ++idx) {
-        struct httpio *ws;
-        const char *name;
-        // Pointer to the websocket object
-        ws = wsc->ws;
-        // Name of the topic to subscribe;
-        name = names[idx];
-        // Try subscribing it
-        if (bt_william_hill_subscribe_single_topic(ws, event, name) == true)
-            continue;
-        // This means, we failed so get out of here to give
-        // a chance in the next scan.
-        return false;
+        if (idx > 0)
+            bt_string_builder_append(builder, ",", 1);
+        bt_string_builder_printf(builder, "tennis/matches/%d/%s", id, names[idx]);
     }
-    return true;
+    subscription = bt_string_builder_take_string(builder);
+    bt_string_builder_free(builder);
+    return subscription;
 }
 
 // These are simple "accessor" functions
@@ -372,7 +690,7 @@ bt_william_hill_topic_get_event(const bt_topic *const topic)
 }
 
 size_t
-bt_william_hill_topic_list_get_count(const bt_topic_list *const topics)
+bt_william_hill_topic_registry_get_count(const bt_topic_registry *const topics)
 {
     return topics->count;
 }
@@ -383,13 +701,6 @@ bt_william_hill_topic_get_type(const bt_topic *const topic)
     return topic->type;
 }
 
-bt_topic *
-bt_william_hill_topic_list_get_item(const bt_topic_list *const topics,
-                                                                   size_t index)
-{
-    return topics->items[index];
-}
-
 const char *
 bt_william_hill_topic_get_alias(const bt_topic *const topic)
 {
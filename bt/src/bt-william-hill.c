@@ -1,4 +1,6 @@
+#include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 #include <ctype.h>
 
 #include <mysql.h>
@@ -18,17 +20,54 @@
 #include <bt-telegram-channel.h>
 #include <bt-william-hill-topics.h>
 #include <bt-players.h>
+#include <bt-match-state.h>
 #include <bt-channel-settings.h>
+#include <bt-william-hill-pipeline.h>
+#include <bt-william-hill-capture.h>
+#include <bt-latency.h>
+#include <bt-private.h>
+
+// A piece of a frame, it points directly into the frame buffer so
+// it's not `null' terminated and it's only valid while the frame is
+typedef struct bt_frame_token {
+    const char *data;
+    size_t length;
+} bt_frame_token;
 
 typedef struct bt_topic_data {
-    char *alias;
-    char *name;
+    bt_frame_token alias;
+    bt_frame_token name;
     int match;
 } bt_topic_data;
 
+typedef struct bt_message_data {
+    bt_frame_token alias;
+    bt_frame_token value;
+} bt_message_data;
+
+// Frames for `bt_william_hill_tokenizer_benchmark()', all for the same
+// match. The first control frame creates the topic, the second one is a
+// repetition and the third one changes it's alias
+#define BT_TOKENIZER_MATCH 1000
+#define BT_TOKENIZER_ROUNDS 100000
+
+typedef struct bt_tokenizer_frame {
+    const char *name;
+    const char *data;
+} bt_tokenizer_frame;
+
+static const bt_tokenizer_frame TokenizerFrames[] = {
+    {"control, new topic", "\x14" "tennis/matches/1000/teamServing!1a\x01" "A"},
+    {"control, same alias", "\x14" "tennis/matches/1000/teamServing!1a\x01" "A"},
+    {"control, new alias", "\x14" "tennis/matches/1000/teamServing!1b\x01" "B"},
+    {"data", "\x15" "!1b\x01" "A"},
+    {"control, unknown name", "\x14" "tennis/matches/1000/unknown!1c\x01" "A"}
+};
+
 typedef struct bt_mto {
     bt_player *victim;
     bt_player *oponent;
+    size_t victim_idx;
     const char *tour;
     const char *category;
 } bt_mto;
@@ -186,17 +225,36 @@ bt_william_hill_get_player(bt_event *const event, json_object *incident)
     name = json_object_get_string(competitor);
     if (name == NULL)
         return NULL;
+    // Events from a capture may have no players
     player = bt_william_hill_event_get_player(event, 0);
-    if (strcmp(player->name, name) == 0)
+    if ((player != NULL) && (strcmp(player->name, name) == 0))
         return player;
     player = bt_william_hill_event_get_player(event, 1);
-    if (strcmp(player->name, name) == 0)
+    if ((player != NULL) && (strcmp(player->name, name) == 0))
         return player;
     return NULL;
 }
 
 static int
-bt_william_hill_send_mto(const bt_event *const event, const bt_mto *const mto)
+bt_william_hill_mto_message_id(const char *const channel, void *data)
+{
+    // The event id travels in the pointer
+    return bt_database_mto_message_id((int) (intptr_t) data, channel);
+}
+
+static void
+bt_william_hill_mto_sent(const char *const channel,
+                                             int previous, int id, void *data)
+{
+    // If msgid == -1, we don't need to save anything
+    if (id == -1)
+        return;
+    bt_database_save_mto_message_id(id, (int) (intptr_t) data, channel);
+}
+
+static int
+bt_william_hill_send_mto(const bt_event *const event,
+                      const bt_mto *const mto, bt_latency_trace *const trace)
 {
     const char *message;
     const char *link;
@@ -206,7 +264,8 @@ bt_william_hill_send_mto(const bt_event *const event, const bt_mto *const mto)
     bt_player *victim;
     int event_id;
     int result;
-    char *score;
+    bt_match_state state;
+    char score[64];
     victim = mto->victim;
     oponent = mto->oponent;
     result = -1;
@@ -219,6 +278,7 @@ bt_william_hill_send_mto(const bt_event *const event, const bt_mto *const mto)
     category = bt_william_hill_event_get_category(event);
     // Get the MTO count
     victim->t_mto_count = bt_database_count_mto(event_id, victim->name);
+    bt_latency_trace_mark(trace, LatencyLookedUp);
     // Creat a string builder
     sb[0] = bt_string_builder_new();
     if (sb[0] == NULL)
@@ -239,8 +299,9 @@ bt_william_hill_send_mto(const bt_event *const event, const bt_mto *const mto)
         bt_string_builder_printf(sb[1], MEDICAL_TIMEOUT_MULTI_NO_PLAYER,
                    victim->t_mto_count, victim->name, oponent->name, mto->tour);
     }
-    // Get the match score
-    score = bt_william_hill_score_to_str(event, victim, oponent);
+    // Get the match score, as the victim sees it
+    bt_match_state_snapshot(bt_william_hill_event_get_state(event), &state);
+    bt_match_state_render(&state, mto->victim_idx, score, sizeof(score));
     // Marathon bet link
     bt_string_builder_printf(sb[0], "%s", link);
     bt_string_builder_printf(sb[1], "%s", link);
@@ -249,9 +310,9 @@ bt_william_hill_send_mto(const bt_event *const event, const bt_mto *const mto)
     log("%s", sb[1]);
 
     for (size_t idx = 0; idx < bt_channel_settings_count(); ++idx) {
+        bt_telegram_notification *notification;
         int status;
         char channel[32];
-        int id;
         if (bt_channel_settings_mto_show_player(category, idx) == true) {
             message = bt_string_builder_string(sb[0]);
         } else {
@@ -261,8 +322,6 @@ bt_william_hill_send_mto(const bt_event *const event, const bt_mto *const mto)
             continue;
         // Get the channel id
         bt_channel_settings_get_id(channel, sizeof(channel), idx);
-        // Get the message id (if -1, send a new message else edit)
-        id = bt_database_mto_message_id(event_id, channel);
         // Make the default status (-1) i.e. do not send anything
         // -1. Ignore (do not send anything)
         //  0. Send the message
@@ -279,40 +338,49 @@ bt_william_hill_send_mto(const bt_event *const event, const bt_mto *const mto)
             // Increment because we have to show the score
             status += 1;
         }
-        if (((score == NULL) || (score[0] == '\0')) && (status == 1))
+        if ((score[0] == '\0') && (status == 1))
             status = 0;
         // Check what to do with this
         switch (status) {
         case 0:
-            // Send the message
-            id = bt_telegram_edit_message(id, channel, "%s", message);
+            notification = bt_telegram_notification_new("%s", message);
             break;
         case 1:
-            // Send the message
-            id = bt_telegram_edit_message(id, channel,
-                                    "%s\n\n<b>Marcador</b> %s", message, score);
+            notification = bt_telegram_notification_new(
+                                 "%s\n\n<b>Marcador</b> %s", message, score);
             break;
         default:
-            id = -1;
+            notification = NULL;
             break;
         }
-        // If msgid == -1, we don't need to save anything
-        if (id == -1)
+        if (notification == NULL)
             continue;
-        // Save the message id
+        // The message id (if -1, send a new message else edit) is
+        // looked up by the sender, and the new one is saved there too
         //
         // Note: By design if the channel has a given ID
         //       then this will always be the same id.
         //
         //       Thus, every message for this channel is coalesced
         //       into a signle message.
-        bt_database_save_mto_message_id(id, event_id, channel);
+        bt_telegram_notification_set_callbacks(notification,
+                   bt_william_hill_mto_message_id, bt_william_hill_mto_sent,
+                                                   (void *) (intptr_t) event_id);
+        // The senders add the HTTP marks and record it
+        if (trace != NULL) {
+            trace->event = event_id;
+            bt_telegram_notification_set_trace(notification, trace);
+        }
+        if (bt_telegram_notification_add_channel(notification, channel, -1) == true) {
+            bt_telegram_notification_post(notification);
+        } else {
+            bt_telegram_notification_free(notification);
+        }
     }
     result = 0;
 error:
     bt_string_builder_free(sb[0]);
     bt_string_builder_free(sb[1]);
-    bt_free(score);
 
     return result;
 }
@@ -328,16 +396,20 @@ bt_william_hill_parse_mto(bt_mto *const mto,
         return -1;
     // The other player
     mto->victim = victim;
+    mto->victim_idx = 1;
     mto->oponent = bt_william_hill_event_get_player(event, 0);
-    if (mto->oponent == mto->victim)
+    if (mto->oponent == mto->victim) {
+        mto->victim_idx = 0;
         mto->oponent = bt_william_hill_event_get_player(event, 1);
+    }
     // Tournament category
     mto->category = bt_get_category_name(category);
     return 0;
 }
 
 static void
-bt_william_hill_handle_mto(bt_player *victim, bt_event *const event)
+bt_william_hill_handle_mto(bt_player *victim,
+                          bt_event *const event, bt_latency_trace *const trace)
 {
     bt_player *oponent;
     struct bt_mto mto;
@@ -352,7 +424,7 @@ bt_william_hill_handle_mto(bt_player *victim, bt_event *const event)
         const char *date;
         int id;
         char *query;
-        if (bt_william_hill_send_mto(event, &mto) == -1)
+        if (bt_william_hill_send_mto(event, &mto, trace) == -1)
             return;
         // Find the SQL query
         query = bt_load_query("save mto", "%category%", mto.category, NULL);
@@ -379,28 +451,43 @@ bt_william_hill_handle_mto(bt_player *victim, bt_event *const event)
 
 static void
 bt_william_hill_handle_incidents(bt_event *const event,
-                                                      const char *const message)
+           const bt_frame_token *const message, bt_latency_trace *const trace)
 {
+    json_tokener *tokener;
     bt_player *player;
-    char **jsons;
-    // Split at the character 0x02 (STX start of text)
-    jsons = bt_string_splitchr(message, 0x02);
-    for (int index = 0; jsons[index] != NULL; ++index) {
+    const char *head;
+    const char *end;
+    // One tokener for all the incidents in this message
+    tokener = json_tokener_new();
+    if (tokener == NULL)
+        return;
+    end = message->data + message->length;
+    // Every incident is separated by 0x02 (STX start of text)
+    for (head = message->data; head < end; ++head) {
         json_object *incident;
         enum Incidents type;
+        const char *tail;
+        // Find the end of this incident
+        tail = memchr(head, 0x02, end - head);
+        if (tail == NULL)
+            tail = end;
         // This is surprising, it means that we have an empty object?
-        if (jsons[index][0] == '\0')
+        if (tail == head)
             continue;
         // Parse the corresponding Json
-        incident = json_tokener_parse(jsons[index]);
+        json_tokener_reset(tokener);
+        incident = json_tokener_parse_ex(tokener, head, tail - head);
+        // Point to the delimiter, the loop skips it
+        head = tail;
         if (incident == NULL)
             continue;
         // Obtain the type
         type = bt_william_hill_incident_get_type(incident);
         switch (type) {
         case MedicalBreak: // It's a medical break, save and notify
+            bt_latency_trace_mark(trace, LatencyClassified);
             player = bt_william_hill_get_player(event, incident);
-            bt_william_hill_handle_mto(player, event);
+            bt_william_hill_handle_mto(player, event, trace);
             break;
         default:
             break;
@@ -408,8 +495,7 @@ bt_william_hill_handle_incidents(bt_event *const event,
         // Clean up the temporary object
         json_object_put(incident);
     }
-    // Free the list of strings
-    bt_string_list_free(jsons);
+    json_tokener_free(tokener);
 }
 
 static void
@@ -417,92 +503,60 @@ bt_william_hill_update_set_score(bt_event *const event,
                     enum bt_player_idx idx, int setidx, const char *const value)
 {
     bt_player *player;
-    bt_score *score;
-    bt_score_set *set;
     bt_mto mto;
 
     player = bt_william_hill_event_get_player(event, idx);
     if (player == NULL)
         return;
-    score = &player->score;
-    set = &score->sets[setidx];
-    set->games = atoi(value);
+    // The score is kept by team, in place
+    bt_match_state_set_games(bt_william_hill_event_get_state(event),
+                                                     idx, setidx, atoi(value));
 
     if ((player->t_mto_count > 0) &&
                          (bt_william_hill_parse_mto(&mto, event, player) == 0)) {
-        bt_william_hill_send_mto(event, &mto);
+        bt_william_hill_send_mto(event, &mto, NULL);
     }
 }
 
-char *
-bt_william_hill_score_to_str(const bt_event *const event,
-                              bt_player *const victim, bt_player *const oponent)
-{
-    int current_set;
-    char *string;
-    current_set = bt_william_hill_event_get_current_set(event);
-    if (current_set == -1)
-        return bt_strdup("");
-    string = bt_malloc(4 * current_set);
-    for (size_t setidx = 0; setidx < current_set; ++setidx) {
-        bt_score_set *set;
-        bt_score *score;
-
-        score = &victim->score;
-        set = &score->sets[setidx];
-        string[4 * setidx] = set->games + '0';
-        string[4 * setidx + 1] = '-';
-
-        score = &oponent->score;
-        set = &score->sets[setidx];
-        string[4 * setidx + 2] = set->games + '0';
-        string[4 * setidx + 3] = ' ';
-    }
-    string[4 * current_set - 1] = '\0';
-    return string;
-}
-
 static int
 bt_william_hill_previous_set_from_type(enum bt_topic_type type)
 {
-    switch (type) {
-    case PreviousSet1GamesWonA:
-    case PreviousSet1GamesWonB:
-        return 0;
-    case PreviousSet2GamesWonA:
-    case PreviousSet2GamesWonB:
-        return 1;
-    case PreviousSet3GamesWonA:
-    case PreviousSet3GamesWonB:
-        return 2;
-    case PreviousSet4GamesWonA:
-    case PreviousSet4GamesWonB:
-        return 3;
-    case PreviousSet5GamesWonA:
-    case PreviousSet5GamesWonB:
-        return 4;
-    default:
-        return -1;
-    }
+    // The enumerators for each team are contiguous, so the set index
+    // is just the distance to the first set
+    if ((type >= PreviousSet1GamesWonA) && (type <= PreviousSet5GamesWonA))
+        return type - PreviousSet1GamesWonA;
+    if ((type >= PreviousSet1GamesWonB) && (type <= PreviousSet5GamesWonB))
+        return type - PreviousSet1GamesWonB;
     return -1;
 }
 
-static void
-bt_william_hill_dispatch_message_final(struct httpio *const ws, const bt_topic *const topic, char **parts)
+static bool
+bt_william_hill_token_equals(const bt_frame_token *const token,
+                                                       const char *const string)
+{
+    return (strncmp(string, token->data, token->length) == 0) &&
+                                             (string[token->length] == '\0');
+}
+
+void
+bt_william_hill_handle_topic_value(bt_event *const evt, enum bt_topic_type type,
+                       const char *const data, size_t length,
+              bt_latency_trace *const trace, bt_topic_subscriber subscriber, void *ws)
 {
-    enum bt_topic_type type;
     enum bt_player_idx pidx;
+    bt_frame_token token;
+    const bt_frame_token *value;
     int currset;
     int prevset;
     bt_player *player;
-    bt_event *evt;
     int event_id;
-    // Get the event associated with this topic
-    evt = bt_william_hill_topic_get_event(topic);
     if (evt == NULL)
         return;
+    // The value is `null' terminated, so `atoi()` can read it
+    token.data = data;
+    token.length = length;
+    value = &token;
     prevset = bt_william_hill_event_get_current_set(evt) - 1;
-    type = bt_william_hill_topic_get_type(topic);
     event_id = bt_william_hill_event_get_id(evt);
     pidx = Home;
     // Check what type of topic in order to decide what to do
@@ -510,12 +564,12 @@ bt_william_hill_dispatch_message_final(struct httpio *const ws, const bt_topic *
     case IncidentsTopic: // It's an incident, check whether we are interested
                          // in it or not
         log("incident: \033[34m%d\033[0m\n", event_id);
-        bt_william_hill_handle_incidents(evt, parts[1]);
+        bt_william_hill_handle_incidents(evt, value, trace);
         break;
     case TeamANameTopic:
     case TeamBNameTopic:
         player = bt_william_hill_event_get_player(evt, type - TeamANameTopic);
-        if ((player != NULL) && (strcmp(player->name, parts[1]) == 0))
+        if ((player != NULL) && (bt_william_hill_token_equals(value, player->name) == true))
             return;
         bt_william_hill_event_swap_players(evt);
         break;
@@ -526,7 +580,7 @@ bt_william_hill_dispatch_message_final(struct httpio *const ws, const bt_topic *
         // then `current_set' will be -1
         prevset = bt_william_hill_event_get_current_set(evt);
         // Convert the value to int
-        currset = atoi(parts[1]);
+        currset = atoi(value->data);
         // Update the `current_set' value in the event
         bt_william_hill_event_set_current_set(evt, currset);
         // If this is not the first set, we're done here.
@@ -534,19 +588,30 @@ bt_william_hill_dispatch_message_final(struct httpio *const ws, const bt_topic *
         // subscribe the current set games_win
         if (currset > 1) {
             // Subscribe previous set to get the complete score
-            bt_william_hill_topic_subscribe_previous_set(ws, evt, currset, Home);
-            bt_william_hill_topic_subscribe_previous_set(ws, evt, currset, Away);
+            bt_william_hill_topic_subscribe_previous_set(subscriber, ws, evt, currset, Home);
+            bt_william_hill_topic_subscribe_previous_set(subscriber, ws, evt, currset, Away);
         } else {
             // If this is not the first time we should not subscribe
             // other events now
             if (prevset != -1)
                 return;
             // Subscribe the games won in current set topic
-            bt_william_hill_topic_subscribe_current_set_gameswon(ws, evt, Home);
-            bt_william_hill_topic_subscribe_current_set_gameswon(ws, evt, Away);
+            bt_william_hill_topic_subscribe_current_set_gameswon(subscriber, ws, evt, Home);
+            bt_william_hill_topic_subscribe_current_set_gameswon(subscriber, ws, evt, Away);
         }
         break;
     case TeamServingTopic:
+        // It's the team, `A' or `B'
+        if (value->length == 1) {
+            bt_match_state_set_serving(bt_william_hill_event_get_state(evt),
+                                                          value->data[0] - 'A');
+        }
+        break;
+    case CurrentGamePointsWonB:
+        pidx = Away;
+    case CurrentGamePointsWonA:
+        bt_match_state_set_points(bt_william_hill_event_get_state(evt),
+                                                      pidx, atoi(value->data));
         break;
     case AnimationTopic:
         break;
@@ -564,11 +629,11 @@ bt_william_hill_dispatch_message_final(struct httpio *const ws, const bt_topic *
         // Determine which set to update
         currset = bt_william_hill_previous_set_from_type(type);
         // Get current set value
-        bt_william_hill_update_set_score(evt, pidx, currset, parts[1]);
+        bt_william_hill_update_set_score(evt, pidx, currset, value->data);
         if (currset == 0) {
-            bt_william_hill_topic_subscribe_current_set_gameswon(ws, evt, pidx);
+            bt_william_hill_topic_subscribe_current_set_gameswon(subscriber, ws, evt, pidx);
         } else {
-            bt_william_hill_topic_subscribe_previous_set(ws, evt, currset, pidx);
+            bt_william_hill_topic_subscribe_previous_set(subscriber, ws, evt, currset, pidx);
         }
         break;
     case CurrentSetGamesWonB:
@@ -576,10 +641,10 @@ bt_william_hill_dispatch_message_final(struct httpio *const ws, const bt_topic *
     case CurrentSetGamesWonA:
         if (prevset == -1)
             prevset = 0;
-        bt_william_hill_update_set_score(evt, pidx, prevset, parts[1]);
+        bt_william_hill_update_set_score(evt, pidx, prevset, value->data);
         if (bt_william_hill_event_is_ready_for_incidents(evt) == false)
             return;
-        bt_william_hill_topic_subscribe_incidents(ws, evt);
+        bt_william_hill_topic_subscribe_incidents(subscriber, ws, evt);
         break;
     default:
         break;
@@ -588,95 +653,139 @@ bt_william_hill_dispatch_message_final(struct httpio *const ws, const bt_topic *
     return;
 }
 
-static void
-bt_william_hill_dispatch_message_ecs(struct httpio *const ws, struct httpio_websocket_frame *frame, const bt_topic *const topic)
+static bt_frame_token
+bt_william_hill_token_strip(const char *head, const char *tail)
 {
-    const char *data;
-    char **header;
-    // Obtain the frame text
-    data = (const char *) httpio_websocket_frame_data(frame);
-    if (data == NULL)
-        return;
-    // Make a list by splitting this string at 0x01 (SOH start of heading)
-    header = bt_string_splitchr(&data[1], 0x01);
-    if (header == NULL)
-        return;
-    // Check if the list has the necessary 2 elements, in that case
-    // call the final function, that will ulitmately do something
-    // with this frame.
-    if ((header[0] != NULL) && (header[1] != NULL))
-        bt_william_hill_dispatch_message_final(ws, topic, header);
-    // Clean up the list and release resources
-    bt_string_list_free(header);
-    // Return the result with the meaning explained
-    // (rules are the same as in `bt_william_hill_dispatch_message_final`)
-    return;
+    bt_frame_token token;
+    // Strip all leading white spaces
+    while ((head < tail) && (isspace((unsigned char) *head) != 0))
+        head++;
+    // Strip all the trailing white spaces
+    while ((tail > head) && (isspace((unsigned char) tail[-1]) != 0))
+        tail--;
+    token.data = head;
+    token.length = tail - head;
+    return token;
 }
 
-static char *
-bt_william_hill_get_topic_alias_from_message(
-                                 const struct httpio_websocket_frame *const frame)
+static const char *
+bt_william_hill_token_rfind(const char *head, const char *tail, char character)
 {
-    char **parts;
-    const char *data;
-    char *alias;
-    size_t length;
+    // Like `strrchr()` but in the `[head, tail)` range
+    while (tail > head) {
+        if (*(--tail) == character)
+            return tail;
+    }
+    return NULL;
+}
 
-    alias = NULL;
-    if (frame == NULL)
-        return NULL;
-    // Obtain the frame text
-    data = (char *) httpio_websocket_frame_data(frame);
-    if (data == NULL)
-        return NULL;
-    // Make a list by splitting this string at 0x01 (SOH start of heading)
-    parts = bt_string_splitchr(&data[1], 0x01);
-    if (parts == NULL)
-        return NULL;
-    // Check the list has at least 2 elements. It will have
-    // exactly 2 elements if this is valid data. But this test
-    // is sufficient rather than necessary.
-    if ((parts[0] != NULL) && (parts[1] != NULL)) {
-        const char *tail;
-        // Find this character to split the object and obtain the id
-        tail = strchr(parts[0], '!');
-        if (tail != NULL) {
-            // It was found, so copy the string to the right of
-            // it
-            alias = bt_stripdup(tail + 1, &length);
-        }
+static bool
+bt_william_hill_parse_message(const char *data, bt_message_data *const message)
+{
+    const char *head;
+    const char *tail;
+    const char *end;
+    // Skip the type character, and find the end of the frame
+    data = &data[1];
+    end = strchr(data, '\0');
+    // The header ends at 0x01 (SOH start of heading), it has to be there
+    // or this is not valid data
+    tail = memchr(data, 0x01, end - data);
+    if (tail == NULL)
+        return false;
+    // The value is whatever follows, up to the next 0x01
+    message->value.data = tail + 1;
+    head = memchr(message->value.data, 0x01, end - message->value.data);
+    if (head == NULL)
+        head = end;
+    message->value.length = head - message->value.data;
+    // The alias is to the right of the '!' in the header
+    head = memchr(data, '!', tail - data);
+    if (head == NULL)
+        return false;
+    message->alias = bt_william_hill_token_strip(head + 1, tail);
+    return true;
+}
+
+static bool
+bt_william_hill_parse_topic(const char *const data, bt_topic_data *topic)
+{
+    const char *head;
+    const char *tail;
+    const char *end;
+    // Find the last SOH characeter, the topic path is the text before it
+    end = strrchr(data, 0x01);
+    if (end == NULL)
+        return false;
+    // Find the last '!' character in the path
+    tail = bt_william_hill_token_rfind(data, end, '!');
+    if (tail == NULL)
+        return false;
+    // This is the alias
+    topic->alias = bt_william_hill_token_strip(tail + 1, end);
+    // Now walk the path `tennis/matches/<match>/<name>`, ignore the
+    // first two parts
+    head = data;
+    for (int index = 0; index < 2; ++index) {
+        head = memchr(head, '/', tail - head);
+        if (head == NULL)
+            return false;
+        head += 1;
     }
-    // As always, release resources
-    httpio_string_list_free(parts);
-    // Return the `alias' to the caller
-    return alias;
+    // This one contains the `id` of the event
+    topic->match = 0;
+    for (end = head; (end < tail) && (*end != '/'); ++end) {
+        if (isdigit((unsigned char) *end) == 0)
+            return false;
+        topic->match = 10 * topic->match + (*end - '0');
+    }
+    if ((end == head) || (end == tail))
+        return false;
+    // And the rest, the name of the topic
+    topic->name.data = end + 1;
+    topic->name.length = tail - topic->name.data;
+    return true;
+}
+
+int
+bt_william_hill_control_frame_get_match(const char *const data,
+                                enum bt_topic_type *type, const char **value)
+{
+    bt_topic_data topic;
+    // Only control frames have the topic path
+    if ((data == NULL) || ((uint8_t) data[0] != 20))
+        return -1;
+    if (bt_william_hill_parse_topic(&data[1], &topic) == false)
+        return -1;
+    *type = bt_william_hill_topic_get_type_from_description_name(
+                                           topic.name.data, topic.name.length);
+    // The value follows the last SOH, the frame ends with it
+    *value = strrchr(data, 0x01) + 1;
+    return topic.match;
 }
 
 static void
-bt_william_hill_topic_status_changed(struct httpio_websocket_frame *frame,
-                                                     bt_context *context)
+bt_william_hill_topic_status_changed(const char *const data, bt_context *context)
 {
     const bt_topic *topic;
-    char *alias;
-    char *command;
-    char *tail;
+    bt_message_data message;
+    const char *command;
+    size_t length;
     // Obtain the message topic alias
-    alias = bt_william_hill_get_topic_alias_from_message(frame);
-    if (alias == NULL)
+    if (bt_william_hill_parse_message(data, &message) == false)
         return;
-    // Find the delimiter
-    if ((command = strchr(alias, 0x02)) != NULL)
-        *(command++) = '\0'; // Make alias `null' terminated (correctly)
-    else // An error occurred
-        goto error;
-    // Find the end of command
-    if ((tail = strchr(alias, 0x01)) != NULL)
-        *tail = '\0'; // `null' terminate the command string
+    // Find the delimiter, the command follows it
+    command = memchr(message.alias.data, 0x02, message.alias.length);
+    if (command == NULL) // An error occurred
+        return;
+    // The alias ends at the delimiter
+    length = command - message.alias.data;
+    command += 1;
     // Check if this is the `R' command
     // (currently the only command supported)
-    if (strcmp(command, "R") == 0) {
+    if ((message.alias.data + message.alias.length - command == 1) && (*command == 'R')) {
         // Find the corresponding `topic` obejct
-        topic = bt_william_hill_find_topic(context, alias);
+        topic = bt_william_hill_find_topic(context, message.alias.data, length);
         if (topic != NULL) {
             // Remove the `topic' from the list
             // this will also remove the associated
@@ -688,226 +797,138 @@ bt_william_hill_topic_status_changed(struct httpio_websocket_frame *frame,
             bt_context_remove_bt_william_hill_topic(context, topic);
         }
     } else {
-        log("command `\033[31m%s\033[0m' for "
-                           "`\033[34m%s\033[0m' not handled\n", command, alias);
+        log("command `\033[31m%.*s\033[0m' for `\033[34m%.*s\033[0m' not handled\n",
+                   (int) (message.alias.data + message.alias.length - command),
+                                   command, (int) length, message.alias.data);
     }
-
-error:
-    // Free temporary storage
-    bt_free(alias);
 }
 
 static void
-bt_william_hill_dispatch_message(struct httpio *const ws, struct httpio_websocket_frame *frame, bt_context *context)
+bt_william_hill_dispatch_message(const bt_websocket_connection *const wsc,
+                                      const char *const data, uint64_t received)
 {
     const bt_topic *topic;
-    char *alias;
-    // Obtain the message topic alias
-    alias = bt_william_hill_get_topic_alias_from_message(frame);
-    if (alias == NULL)
+    bt_message_data message;
+    bt_latency_trace trace;
+    bt_latency_trace_start(&trace, received);
+    // Obtain the message topic alias and value
+    if (bt_william_hill_parse_message(data, &message) == false)
         return;
+    bt_latency_trace_mark(&trace, LatencyParsed);
     // Find the corresponding `topic` obejct
-    topic = bt_william_hill_find_topic(context, alias);
+    topic = bt_william_hill_find_topic(wsc->context,
+                                      message.alias.data, message.alias.length);
     if (topic != NULL) {
-        // If it was found, process the fram with that topic
-        // and in case it's returned back we need to remove
-        // it from the topic list, and clean it up.
-        bt_william_hill_dispatch_message_ecs(ws, frame, topic);
-    } else {      
-        log("ERROR: did not find topic `\033[33m%s\033[0m\n", alias);
+        bt_latency_trace_mark(&trace, LatencyResolved);
+        // Without workers, when the frames come from a file, only the
+        // decoding is done and measured
+        if (wsc->pipeline == NULL) {
+            bt_latency_trace_finish_partial(&trace, LatencyResolved);
+            return;
+        }
+        // If it was found, hand the value to the worker for it's event
+        bt_william_hill_pipeline_submit(wsc->pipeline,
+               bt_william_hill_topic_get_event(topic),
+                       bt_william_hill_topic_get_type(topic),
+                            message.value.data, message.value.length, &trace);
+    } else {
+        log("ERROR: did not find topic `\033[33m%.*s\033[0m\n",
+                             (int) message.alias.length, message.alias.data);
     }
-    // Release resources
-    bt_free(alias);
 }
 
 static char *
-bt_william_hill_parse_topic_glue(char **parts, char glue)
+bt_william_hill_token_dup(const bt_frame_token *const token)
 {
-    bt_string_builder *sb;
     char *string;
-    // Create a string builder
-    sb = bt_string_builder_new();
-    for (size_t index = 0; parts[index] != NULL; ++index) {
-        size_t length;
-        char *part;
-        // Make a pointer to the part
-        part = parts[index];
-        // Get the length of this particular part
-        length = strlen((char *) part);
-        // Append it to the string builder
-        bt_string_builder_append(sb, part, length);
-        // Is it the last one?
-        if (parts[index + 1] == NULL)
-            continue;
-        // It's not so insert a "glue" character
-        bt_string_builder_append(sb, &glue, 1);
-    }
-    // Extract the interesting string
-    string = bt_string_builder_take_string(sb);
-    // Release resources
-    bt_string_builder_free(sb);
-    // Return it to the caller
+    // Only data that outlives the frame is copied
+    string = bt_malloc(token->length + 1);
+    if (string == NULL)
+        return NULL;
+    memcpy(string, token->data, token->length);
+    string[token->length] = '\0';
     return string;
 }
 
-static bool
-bt_william_hill_parse_topic(char *const data, bt_topic_data *topic)
-{
-    size_t length;
-    char *head;
-    char *tail;
-    char *endptr;
-    char **parts;
-    // This has to be wrong, there is no apparent need for it
-    memset(topic, 0, sizeof(*topic));
-    // Make this `NULL`
-    parts = NULL;
-    // Find the next SOH characeter
-    tail = strrchr(data, 0x01);
-    if (tail == NULL)
-        goto error;
-    // Make the bytes bofore the SOH character a string
-    *tail = '\0';
-    // Find the '!' character in the new "string"
-    head = strrchr(data, '!');
-    if (head == NULL)
-        goto error;
-    // This is the alias, copy it
-    topic->alias = bt_stripdup(head + 1, &length);
-    // Mark this as the new end of the string
-    *head = '\0';
-    // Now split it as the parts in a path string
-    parts = bt_string_splitchr(data, '/');
-    if (parts == NULL)
-        goto error;
-    // Iterate through all the parts
-    for (size_t index = 0; parts[index] != NULL; ++index) {
-        switch (index) {
-        case 0:
-        case 1:
-            // Ignore the first two
-            break;
-        case 2:
-            // This one contains the `id` of the event
-            topic->match = strtol(parts[index], &endptr, 10);
-            if (*endptr != '\0')
-                goto error;
-            break;
-        case 3:
-            // And this one, the name of the topic
-            topic->name = bt_william_hill_parse_topic_glue(&parts[index], '/');
-            break;
-        }
-    }
-    // Release resources
-    httpio_string_list_free(parts);
-    // Inform success
-    return true;
-error:
-    // Release resources
-    httpio_string_list_free(parts);
-    bt_free(topic->name);
-    bt_free(topic->alias);
-    // Reset the freed poitners to avoid dangling pointers
-    topic->alias = NULL;
-    topic->name = NULL;
-    // Inform failure
-    return false;
-}
-
 static void
-bt_william_hill_set_topic_alias(const struct httpio_websocket_frame *const frame,
-                                                            bt_context *context)
+bt_william_hill_set_topic_alias(const char *const pointer, bt_context *context)
 {
-    const uint8_t *pointer;
     bt_topic_data data;
-    size_t length;
-    char *source;
+    bt_event *event;
     bt_topic *topic;
+    char *alias;
     enum bt_topic_type type;
     // Sanity check
-    if ((context == NULL) || (frame == NULL))
-        return;
-    // Make a pointer to the frame text
-    pointer = (uint8_t *) httpio_websocket_frame_data(frame);
-    if (pointer == NULL)
+    if (context == NULL)
         return;
-    // Copy the data after the first character (which is text)
-    source = bt_stripdup((const char *) &pointer[1], &length);
-    if (source == NULL)
+    // Parse the data after the first character (which is the type), and
+    // store the pieces in `data`
+    if (bt_william_hill_parse_topic(&pointer[1], &data) == false)
         return;
-    // Parse the string and store the data in `data`
-    if (bt_william_hill_parse_topic(source, &data) == false)
-        goto error;
     // Check the type of this topic
-    type = bt_william_hill_topic_get_type_from_description_name(data.name);
-    // Find the corresponding topic in this context, and for this match
-    topic = bt_find_topic_for_event(context, data.match, type);
-    // If found check it's alias and reset it if necessary
+    type = bt_william_hill_topic_get_type_from_description_name(data.name.data,
+                                                               data.name.length);
+    // Find the corresponding event with id `data.match`
+    event = bt_find_bt_william_hill_event(context, data.match);
+    if ((event == NULL) || (type == InvalidTopic))
+        return;
+    // The event has a slot for each type of topic
+    topic = bt_william_hill_event_get_topic(event, type);
+    // If found check whether it's alias changed, otherwise there is
+    // nothing to do
+    if ((topic != NULL) && (bt_william_hill_token_equals(&data.alias,
+                               bt_william_hill_topic_get_alias(topic)) == true)) {
+        return;
+    }
+    // From here on the alias outlives the frame, so copy it
+    alias = bt_william_hill_token_dup(&data.alias);
+    if (alias == NULL)
+        return;
     if (topic != NULL) {
-        const char *alias;
-        // Obtain the original alias
-        alias = bt_william_hill_topic_get_alias(topic);
-        // Check whether it changed
-        if (strcmp(alias, data.alias) != 0) {
-            // Reset it in this case
-            bt_william_hill_topic_reset_alias(topic, data.alias);
-        } else {
-            // We are not interested, so release memory
-            bt_free(data.alias);
-        }
+        // Reset it, the context takes charge of `alias`
+        bt_context_reset_topic_alias(context, topic, alias);
     } else {
-        bt_event *event;
-        // Find the corresponding event with id `data.match`
-        event = bt_find_bt_william_hill_event(context, data.match);
-        // Find the appropriate topic
-        topic = bt_william_hill_topic_new(data.alias, event, type);
+        // Create the appropriate topic
+        topic = bt_william_hill_topic_new(alias, event, type);
+        if (topic == NULL) {
+            bt_free(alias);
+            return;
+        }
         // Try to append it to the topics in the context
         if (bt_context_append_topic(context, topic) == false) {
             // On failure, release resources
             bt_william_hill_topic_free(topic);
         }
     }
-    // Sort the topics in the context in order to find them with binary search
-    bt_context_sort_topics(context);
-    // Release resources
-    bt_free(data.name);
-error:
-    bt_free(source);
 }
 
-static int
-bt_william_hill_handle_message(struct httpio *link,
-                  bt_context *const context, struct httpio_websocket_frame *frame)
+int
+bt_william_hill_handle_frame_text(const bt_websocket_connection *const wsc,
+                                      const char *const data, uint64_t received)
 {
-    const uint8_t *data;
     uint8_t type;
-    // Get the frame data as text
-    data = httpio_websocket_frame_data(frame);
     if (data == NULL)
         return -1;
     // Check the frame type (this is William Hill specific)
-    type = data[0];
+    type = (uint8_t) data[0];
     if ((type & 0x40) == 0x40)
         return -1;
     // Obtain the "pure" type?
     type &= ~0x40;
     switch (type) {
     case 20: // Control message
-        bt_global_lock();
-        bt_william_hill_set_topic_alias(frame, context);
-        bt_global_unlock();
+        bt_william_hill_set_topic_alias(data, wsc->context);
     case 21: // Message
-        bt_global_lock();
-        bt_william_hill_dispatch_message(link, frame, context);
-        bt_global_unlock();
+        bt_william_hill_dispatch_message(wsc, data, received);
         break;
     case 24: // On ping?
         log("websocket sent a \033[33mon-ping\033[0m message\n");
         break;
     case 25: // Ping message
         log("websocket \033[31mping\033[0m\n");
-        httpio_websocket_send_string(link, (char *) data);
+        // There is nobody to answer when replaying a capture
+        if (wsc->ws != NULL)
+            httpio_websocket_send_string(wsc->ws, (char *) data);
         break;
     case 27: // Server rejected
         break;
@@ -916,9 +937,7 @@ bt_william_hill_handle_message(struct httpio *link,
     case 29: // Connection Lost
         break;
     case 35: // What the hell?
-        bt_global_lock();
-        bt_william_hill_topic_status_changed(frame, context);
-        bt_global_unlock();
+        bt_william_hill_topic_status_changed(data, wsc->context);
         break;
     default:
         log("\033[31mmensaje desconocido\033[0m `%d'\n", type);
@@ -929,9 +948,8 @@ bt_william_hill_handle_message(struct httpio *link,
 }
 
 bool
-bt_william_hill_websocket_handshake(struct httpio *link)
+bt_william_hill_websocket_check_handshake(const char *const data)
 {
-    struct httpio_websocket_frame *frame;
     int version;
     int status;
     char *authtoken;
@@ -942,18 +960,14 @@ bt_william_hill_websocket_handshake(struct httpio *link)
 
     list = NULL;
     authtoken = NULL;
-    // Get the websocket frame
-    frame = httpio_websocket_get_frame(link);
-    if (frame == NULL)
-        return false;
     // Ensure this has a value in case something goes wrong
     index = -1;
-    if (httpio_websocket_frame_type(frame) != 1)
+    if (data == NULL)
         goto error;
     // Split the string at 0x02 (STX start of text) each
     // item in the least has a meaning as interpreted below
     // in the switch statement
-    list = bt_string_splitchr((char *) httpio_websocket_frame_data(frame), 0x02);
+    list = bt_string_splitchr(data, 0x02);
     if (list == NULL)
         goto error;
     // Iterate through all the items in the list
@@ -980,8 +994,6 @@ bt_william_hill_websocket_handshake(struct httpio *link)
     // This means that not all the elements where parsed
     if (index < 2)
         goto error;
-    // Release frame resources
-    httpio_websocket_frame_free(frame);
     // Release list resources
     bt_string_list_free(list);
     // Release the authtoken? Then what is it for?
@@ -1002,14 +1014,39 @@ error:
         break;
     }
     // Release all resources
-    httpio_websocket_frame_free(frame);
     bt_string_list_free(list);
     bt_free(authtoken);
     return false;
 }
 
+bool
+bt_william_hill_websocket_handshake(struct httpio *link, char **greeting)
+{
+    struct httpio_websocket_frame *frame;
+    const char *data;
+    bool result;
+    *greeting = NULL;
+    // Get the websocket frame
+    frame = httpio_websocket_get_frame(link);
+    if (frame == NULL)
+        return false;
+    result = false;
+    if (httpio_websocket_frame_type(frame) == 1) {
+        data = (const char *) httpio_websocket_frame_data(frame);
+        result = bt_william_hill_websocket_check_handshake(data);
+        // Keep it for the capture, it's part of the connection
+        if (result == true)
+            *greeting = bt_strdup(data);
+    } else {
+        log("error: problema interno.\n");
+    }
+    // Release frame resources
+    httpio_websocket_frame_free(frame);
+    return result;
+}
+
 struct httpio *
-bt_william_hill_websocket_connect(void)
+bt_william_hill_websocket_connect(char **greeting)
 {
     const char *host;
     struct httpio *link;
@@ -1024,6 +1061,7 @@ bt_william_hill_websocket_connect(void)
     host = "scoreboards.williamhill.com";
     response = NULL;
     secret = NULL;
+    *greeting = NULL;
     // Show message
     log("connecting to the `scoreboards.williamhill.com' websocket\n");
     if (bt_william_hill_use_tor() == true) {
@@ -1074,7 +1112,7 @@ bt_william_hill_websocket_connect(void)
     if (httpio_websocket_check_key(key, secret) == 0)
         goto error;
     // Make the initial setup with the connected websocket
-    if (bt_william_hill_websocket_handshake(link) == false)
+    if (bt_william_hill_websocket_handshake(link, greeting) == false)
         goto error;
     // Release resources
     httpio_response_free(response);
@@ -1090,33 +1128,65 @@ error:
 }
 
 int
-bt_william_hill_handle_websocket_frame(struct httpio *websocket, bt_context *const context)
+bt_william_hill_handle_websocket_frame(const bt_websocket_connection *const wsc)
 {
     struct httpio_websocket_frame *frame;
+    uint64_t received;
     // Extract the websocket frame
-    frame = httpio_websocket_get_frame(websocket);
+    frame = httpio_websocket_get_frame(wsc->ws);
     if (frame == NULL)
         return -1;
+    // The pipeline latency is measured from here
+    received = bt_william_hill_pipeline_now();
+    // Keep a copy of the raw frame, if capturing
+    if (wsc->capture != NULL) {
+        const char *data;
+        data = (const char *) httpio_websocket_frame_data(frame);
+        if (data != NULL)
+            bt_william_hill_capture_write(wsc->capture, received, data, strlen(data));
+    }
     // Send it to the system of functions that will validate
     // and react to the frame
-    if (bt_william_hill_handle_message(websocket, context, frame) != 0)
+    if (bt_william_hill_handle_frame_text(wsc,
+                    (const char *) httpio_websocket_frame_data(frame), received) != 0) {
+        httpio_websocket_frame_free(frame);
         return -1;
+    }
     // Release resources
     httpio_websocket_frame_free(frame);
     // Return success
     return 0;
 }
 
+int
+bt_william_hill_websocket_keepalive(struct httpio *link)
+{
+    struct httpio_websocket_frame *frame;
+    const uint8_t *data;
+    int result;
+    frame = httpio_websocket_get_frame(link);
+    if (frame == NULL)
+        return -1;
+    result = 0;
+    data = httpio_websocket_frame_data(frame);
+    if (data == NULL) {
+        result = -1;
+    } else if ((data[0] & ~0x40) == 25) {
+        // Answer the ping, everything else is ignored
+        if (httpio_websocket_send_string(link, (char *) data) == false)
+            result = -1;
+    }
+    httpio_websocket_frame_free(frame);
+    return result;
+}
+
 int
 bt_william_hill_subscribe_events(
     const bt_websocket_connection *const wsc, bt_context *const context)
 {
     bt_event_list *list;
-    list = NULL;
-    // Extract the events list (thread safe)
-    bt_global_lock();
+    // The listener thread owns the events list
     list = bt_context_get_events(context);
-    bt_global_unlock();
     // Subscribe all the events here
     return bt_william_hill_event_list_subscribe_all(wsc, list);
 }
@@ -1131,3 +1201,172 @@ bt_william_hill_use_tor()
         return false;
     return (strcmp(envvar, "tor") == 0);
 }
+
+// How the frames were decoded before they were tokenized in place, it's
+// only kept to compare allocations in the benchmark
+static char *
+bt_william_hill_legacy_glue(char **parts, char glue)
+{
+    bt_string_builder *sb;
+    char *string;
+    sb = bt_string_builder_new();
+    for (size_t index = 0; parts[index] != NULL; ++index) {
+        bt_string_builder_append(sb, parts[index], strlen(parts[index]));
+        if (parts[index + 1] == NULL)
+            continue;
+        bt_string_builder_append(sb, &glue, 1);
+    }
+    string = bt_string_builder_take_string(sb);
+    bt_string_builder_free(sb);
+    return string;
+}
+
+static void
+bt_william_hill_legacy_parse_topic(char *const data)
+{
+    size_t length;
+    char **parts;
+    char *alias;
+    char *name;
+    char *head;
+    char *tail;
+    // The alias was copied and the path split at '/', then the name
+    // glued back together
+    tail = strrchr(data, 0x01);
+    if (tail == NULL)
+        return;
+    *tail = '\0';
+    head = strrchr(data, '!');
+    if (head == NULL)
+        return;
+    alias = bt_stripdup(head + 1, &length);
+    *head = '\0';
+    name = NULL;
+    parts = bt_string_splitchr(data, '/');
+    for (size_t index = 0; (parts != NULL) && (parts[index] != NULL); ++index) {
+        if (index == 3) {
+            name = bt_william_hill_legacy_glue(&parts[index], '/');
+            break;
+        }
+    }
+    bt_string_list_free(parts);
+    bt_free(name);
+    bt_free(alias);
+}
+
+static void
+bt_william_hill_legacy_decode(const char *const data, bool found)
+{
+    size_t length;
+    char **parts;
+    char *source;
+    char *alias;
+    char *tail;
+    // A control frame was copied to parse the topic path, and then it
+    // went through the data frame path too
+    if ((uint8_t) data[0] == 20) {
+        source = bt_stripdup(&data[1], &length);
+        if (source != NULL)
+            bt_william_hill_legacy_parse_topic(source);
+        bt_free(source);
+    }
+    // The alias came from splitting the frame at 0x01
+    alias = NULL;
+    parts = bt_string_splitchr(&data[1], 0x01);
+    if ((parts != NULL) && (parts[0] != NULL) && (parts[1] != NULL)) {
+        tail = strchr(parts[0], '!');
+        if (tail != NULL)
+            alias = bt_stripdup(tail + 1, &length);
+    }
+    bt_string_list_free(parts);
+    // And the value from splitting it again, if the topic was found
+    if ((alias != NULL) && (found == true))
+        bt_string_list_free(bt_string_splitchr(&data[1], 0x01));
+    bt_free(alias);
+}
+
+static void
+bt_william_hill_decode(const char *const data)
+{
+    bt_message_data message;
+    bt_topic_data topic;
+    // What the handler parses now, in place
+    if ((uint8_t) data[0] == 20)
+        bt_william_hill_parse_topic(&data[1], &topic);
+    bt_william_hill_parse_message(data, &message);
+}
+
+static bool
+bt_william_hill_tokenizer_found(const bt_context *const context, const char *const data)
+{
+    bt_message_data message;
+    if (bt_william_hill_parse_message(data, &message) == false)
+        return false;
+    return bt_william_hill_find_topic(context,
+                                 message.alias.data, message.alias.length) != NULL;
+}
+
+int
+bt_william_hill_tokenizer_benchmark(void)
+{
+    bt_websocket_connection wsc;
+    const char *data;
+    bt_event *event;
+    size_t handler;
+    size_t before;
+    size_t legacy;
+    size_t parse;
+    bool found;
+    // No pipeline, so the values are decoded but not processed
+    memset(&wsc, 0, sizeof(wsc));
+    wsc.context = bt_create_context();
+    if (wsc.context == NULL)
+        return -1;
+    event = bt_william_hill_event_new(BT_TOKENIZER_MATCH);
+    if (event == NULL) {
+        bt_context_free(wsc.context);
+        return -1;
+    }
+    bt_william_hill_event_list_append(bt_context_get_events(wsc.context), event);
+    // Allocations to decode each frame the old way and the new one, and
+    // in the whole handler which also creates topics and copies aliases
+    printf("%-22s %10s %10s %10s\n", "frame", "old", "new", "handler");
+    for (size_t idx = 0; idx < countof(TokenizerFrames); ++idx) {
+        data = TokenizerFrames[idx].data;
+        before = bt_memory_thread_allocations();
+        bt_william_hill_handle_frame_text(&wsc, data, bt_william_hill_pipeline_now());
+        handler = bt_memory_thread_allocations() - before;
+        // The old handler created the topic before looking it up too,
+        // so whether it's found now is what it saw
+        found = bt_william_hill_tokenizer_found(wsc.context, data);
+        before = bt_memory_thread_allocations();
+        bt_william_hill_legacy_decode(data, found);
+        legacy = bt_memory_thread_allocations() - before;
+        before = bt_memory_thread_allocations();
+        bt_william_hill_decode(data);
+        parse = bt_memory_thread_allocations() - before;
+        printf("%-22s %10zu %10zu %10zu\n",
+                              TokenizerFrames[idx].name, legacy, parse, handler);
+    }
+    // And the steady state, the data frames are most of the traffic
+    data = TokenizerFrames[3].data;
+    before = bt_memory_thread_allocations();
+    for (size_t round = 0; round < BT_TOKENIZER_ROUNDS; ++round)
+        bt_william_hill_legacy_decode(data, true);
+    legacy = bt_memory_thread_allocations() - before;
+    before = bt_memory_thread_allocations();
+    for (size_t round = 0; round < BT_TOKENIZER_ROUNDS; ++round)
+        bt_william_hill_decode(data);
+    parse = bt_memory_thread_allocations() - before;
+    before = bt_memory_thread_allocations();
+    for (size_t round = 0; round < BT_TOKENIZER_ROUNDS; ++round)
+        bt_william_hill_handle_frame_text(&wsc, data, bt_william_hill_pipeline_now());
+    handler = bt_memory_thread_allocations() - before;
+    printf("%-22s %10.3f %10.3f %10.3f per frame\n", "data, repeated",
+                                    (double) legacy / BT_TOKENIZER_ROUNDS,
+                                    (double) parse / BT_TOKENIZER_ROUNDS,
+                                    (double) handler / BT_TOKENIZER_ROUNDS);
+    fflush(stdout);
+    bt_context_free(wsc.context);
+    return 0;
+}